@@ -0,0 +1,81 @@
+/*
+Buffer allocation benchmark, pooled vs plain malloc.
+
+	g++ -O2 -std=c++11 -I../include buffer_pool_bench.cpp \
+		../include/buffer_pool.cpp ../include/ssdb_bytes.cpp ../include/buffer_policy.cpp -lpthread -o buffer_pool_bench
+	./buffer_pool_bench [threads]
+
+churn: every iteration creates the input/output Buffers of a short-lived
+Link, grows the input once for a reply and destroys both.
+burst: a Buffer grows to a large reply through grow(), then is released.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "ssdb_bytes.h"
+#include "buffer_pool.h"
+
+static void churn(int loops){
+	char data[4096];
+	memset(data, 'x', sizeof(data));
+	for(int i=0; i<loops; i++){
+		Buffer *input = new Buffer(1024);
+		Buffer *output = new Buffer(1024);
+		output->append(data, 64);
+		input->append(data, sizeof(data));
+		delete input;
+		delete output;
+	}
+}
+
+static void burst(int loops){
+	char data[64 * 1024];
+	memset(data, 'x', sizeof(data));
+	for(int i=0; i<loops; i++){
+		// replies from 256KB up to 4MB
+		int reply = (256 * 1024) << (i % 5);
+		Buffer *input = new Buffer(1024);
+		while(input->size() < reply){
+			if(input->space() < (int)sizeof(data) && input->grow() == -1){
+				abort();
+			}
+			input->append(data, sizeof(data));
+		}
+		delete input;
+	}
+}
+
+static double run(void (*func)(int), int loops, int threads){
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for(int i=0; i<threads; i++){
+		workers.push_back(std::thread(func, loops));
+	}
+	for(int i=0; i<threads; i++){
+		workers[i].join();
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+int main(int argc, char **argv){
+	int threads = argc > 1? atoi(argv[1]) : 4;
+	const int churn_loops = 200000;
+	const int burst_loops = 500;
+
+	for(int pooled=0; pooled<2; pooled++){
+		BufferPool::enable(pooled == 1);
+		const char *name = pooled? "pool  " : "malloc";
+
+		double t = run(churn, churn_loops, threads);
+		printf("%s churn: %d threads, %.0f links/s\n", name, threads, churn_loops * threads / t);
+		t = run(burst, burst_loops, threads);
+		printf("%s burst: %d threads, %.0f replies/s\n", name, threads, burst_loops * threads / t);
+		printf("%s %s\n", name, BufferPool::stats().c_str());
+		BufferPool::trim();
+	}
+	return 0;
+}
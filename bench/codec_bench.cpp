@@ -0,0 +1,116 @@
+/*
+Response parsing microbenchmark, the same hgetall reply of many small
+fields copied into a Buffer and decoded by SsdbCodec and by RespCodec,
+the two protocols a Client can speak, see Client::connect(ip, port,
+protocol).
+
+	g++ -O2 -std=c++11 -I../include codec_bench.cpp \
+		../include/link.cpp ../include/ssdb_bytes.cpp ../include/buffer_pool.cpp ../include/buffer_policy.cpp -o codec_bench
+	./codec_bench [fields] [field_size]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "link.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Ctx{
+	LinkCodec *codec;
+	std::string wire;
+	Buffer *input;
+	std::vector<Bytes> packet;
+	int64_t fields;
+};
+
+static void decode_one(Ctx *ctx){
+	ctx->input->append(ctx->wire.data(), (int)ctx->wire.size());
+	if(ctx->codec->decode(ctx->input, &ctx->packet) != 1){
+		printf("error: %s decode failed\n", ctx->codec->name());
+		exit(1);
+	}
+	ctx->fields += ctx->packet.size();
+	ctx->input->nice();
+}
+
+static double run(Ctx *ctx, int rounds){
+	Clock::time_point start = Clock::now();
+	for(int i=0; i<rounds; i++){
+		decode_one(ctx);
+	}
+	double us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+	printf("%-6s %8d bytes %8.1f us/reply %8.0f MB/s\n", ctx->codec->name(),
+		(int)ctx->wire.size(), us / rounds, (double)ctx->wire.size() * rounds / us);
+	return us;
+}
+
+int main(int argc, char **argv){
+	int num = argc > 1? atoi(argv[1]) : 10000;
+	int size = argc > 2? atoi(argv[2]) : 16;
+
+	std::vector<std::string> resp;
+	resp.push_back("ok");
+	for(int i=0; i<num; i++){
+		resp.push_back(std::string(size, 'a' + i % 26));
+	}
+	std::vector<Bytes> fields;
+	for(int i=0; i<(int)resp.size(); i++){
+		fields.push_back(Bytes(resp[i]));
+	}
+
+	// the reply as each server would write it
+	Ctx ssdb;
+	ssdb.codec = new SsdbCodec();
+	Buffer out(8 * 1024);
+	ssdb.codec->encode(&out, &fields[0], (int)fields.size());
+	ssdb.wire.assign(out.data(), out.size());
+	out.decr(out.size());
+
+	Ctx resp2;
+	resp2.codec = new RespCodec();
+	RespWriter writer;
+	int len = RespWriter::header_size(num);
+	for(int i=1; i<(int)fields.size(); i++){
+		len += RespWriter::bulk_size(fields[i].size());
+	}
+	writer.reserve(&out, len);
+	writer.put_header('*', num);
+	for(int i=1; i<(int)fields.size(); i++){
+		writer.put_bulk(fields[i].data(), fields[i].size());
+	}
+	writer.done();
+	resp2.wire.assign(out.data(), out.size());
+
+	Ctx *ctxs[] = {&ssdb, &resp2};
+	for(int i=0; i<2; i++){
+		Ctx *ctx = ctxs[i];
+		ctx->input = new Buffer(8 * 1024);
+		ctx->fields = 0;
+		// warm up the buffer to its final size, and check both agree
+		while(ctx->input->space() < (int)ctx->wire.size()){
+			ctx->input->grow();
+		}
+		decode_one(ctx);
+		if(ctx->packet != fields){
+			printf("error: %s packet differs\n", ctx->codec->name());
+			return 1;
+		}
+	}
+
+	int rounds = (int)(200 * 1000 * 1000LL / ssdb.wire.size());
+	if(rounds < 10){
+		rounds = 10;
+	}
+	printf("%d fields of %d bytes, %d rounds\n", num, size, rounds);
+	double t1 = run(&ssdb, rounds);
+	double t2 = run(&resp2, rounds);
+	printf("resp/ssdb: %.2fx\n", t2 / t1);
+
+	for(int i=0; i<2; i++){
+		delete ctxs[i]->input;
+		delete ctxs[i]->codec;
+	}
+	return 0;
+}
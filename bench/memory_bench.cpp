@@ -0,0 +1,118 @@
+/*
+InMemoryClient throughput, through the same Client methods a test or a
+benchmark calls on a server, and zrank/zrange cost as a zset grows.
+
+	g++ -O2 -std=c++11 -I../include memory_bench.cpp \
+		../include/SSDB_memory.cpp ../include/memory_store.cpp ../include/bloom_filter.cpp \
+		../include/SSDB_impl.cpp ../include/link.cpp ../include/ssdb_bytes.cpp \
+		../include/buffer_pool.cpp ../include/buffer_policy.cpp -o memory_bench -lpthread
+	./memory_bench [keys]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "SSDB_memory.h"
+
+using namespace ssdb;
+
+typedef std::chrono::steady_clock Clock;
+
+static std::string key_of(int i){
+	char buf[32];
+	snprintf(buf, sizeof(buf), "key:%08d", i);
+	return buf;
+}
+
+static void report(const char *name, int ops, Clock::time_point start){
+	double us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+	printf("%-8s %10.0f ops/s %8.3f us/op\n", name, ops / us * 1000000, us / ops);
+}
+
+int main(int argc, char **argv){
+	int num = argc > 1? atoi(argv[1]) : 200000;
+	Client *client = InMemoryClient::create();
+	std::vector<std::string> keys;
+	for(int i=0; i<num; i++){
+		keys.push_back(key_of(i));
+	}
+	std::string val(32, 'v');
+	std::string out;
+	int64_t ret;
+
+	Clock::time_point start = Clock::now();
+	for(int i=0; i<num; i++){
+		client->set(keys[i], val);
+	}
+	report("set", num, start);
+
+	start = Clock::now();
+	for(int i=0; i<num; i++){
+		client->get(keys[(int)(i * 7919LL % num)], &out);
+	}
+	report("get", num, start);
+
+	start = Clock::now();
+	for(int i=0; i<num; i++){
+		client->hset("h", keys[i], val);
+	}
+	report("hset", num, start);
+
+	start = Clock::now();
+	for(int i=0; i<num; i++){
+		client->zset("z", keys[i], (int)(i * 7919LL % num));
+	}
+	report("zset", num, start);
+
+	start = Clock::now();
+	for(int i=0; i<num; i++){
+		client->zrank("z", keys[i], &ret);
+	}
+	report("zrank", num, start);
+
+	std::vector<std::string> list;
+	start = Clock::now();
+	for(int i=0; i<num; i++){
+		list.clear();
+		client->zrange("z", (int)(i * 7919LL % num), 10, &list);
+	}
+	report("zrange", num, start);
+
+	start = Clock::now();
+	for(int i=0; i<num; i++){
+		client->qpush("q", val);
+	}
+	report("qpush", num, start);
+
+	start = Clock::now();
+	for(int i=0; i<num; i++){
+		client->qpop("q", &out);
+	}
+	report("qpop", num, start);
+
+	// rank and offset lookups should grow with log n
+	printf("\nzset size  zrank us/op  zrange us/op\n");
+	for(int size=1000; size<=num; size*=10){
+		client->zclear("zs");
+		for(int i=0; i<size; i++){
+			client->zset("zs", keys[i], (int)(i * 7919LL % size));
+		}
+		int ops = 100000;
+		Clock::time_point t0 = Clock::now();
+		for(int i=0; i<ops; i++){
+			client->zrank("zs", keys[(int)(i * 7919LL % size)], &ret);
+		}
+		double rank_us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count();
+		t0 = Clock::now();
+		for(int i=0; i<ops; i++){
+			list.clear();
+			client->zrange("zs", (int)(i * 7919LL % size), 1, &list);
+		}
+		double range_us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count();
+		printf("%9d  %11.3f  %12.3f\n", size, rank_us / ops, range_us / ops);
+	}
+
+	delete client;
+	return 0;
+}
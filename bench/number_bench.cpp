@@ -0,0 +1,93 @@
+/*
+Integer encode/decode microbenchmark, snprintf() and a std::string copy
+plus strtoll() (what str() and str_to_int64() did) against the
+int64_to_str() and parse_int64() kernels of ssdb_strings.h.
+
+	g++ -O2 -std=c++11 -I../include number_bench.cpp -o number_bench
+	g++ -O2 -std=c++17 -I../include number_bench.cpp -o number_bench_to_chars
+	./number_bench [count]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "ssdb_strings.h"
+
+// what str_to_int64(const char *, int) did
+static int64_t old_str_to_int64(const char *p, int size){
+	std::string s(p, size);
+	return (int64_t)strtoll(s.c_str(), NULL, 10);
+}
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start, int count){
+	std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+	return d.count() * 1e9 / count;
+}
+
+static void run(const char *name, const std::vector<int64_t> &nums){
+	const int count = (int)nums.size();
+	std::vector<char> text(count * 24);
+	std::vector<int> lens(count);
+	char buf[24];
+	int64_t sum = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int i=0; i<count; i++){
+		sum += snprintf(buf, sizeof(buf), "%" PRId64, nums[i]);
+	}
+	double fmt_old = elapsed_ns(start, count);
+
+	start = std::chrono::steady_clock::now();
+	for(int i=0; i<count; i++){
+		lens[i] = int64_to_str(&text[i * 24], nums[i]);
+		sum += lens[i];
+	}
+	double fmt_new = elapsed_ns(start, count);
+
+	start = std::chrono::steady_clock::now();
+	for(int i=0; i<count; i++){
+		sum += old_str_to_int64(&text[i * 24], lens[i]);
+	}
+	double parse_old = elapsed_ns(start, count);
+
+	start = std::chrono::steady_clock::now();
+	for(int i=0; i<count; i++){
+		int64_t v;
+		parse_int64(&text[i * 24], lens[i], &v);
+		if(v != nums[i]){
+			printf("%s: mismatch at %d\n", name, i);
+			exit(1);
+		}
+		sum += v;
+	}
+	double parse_new = elapsed_ns(start, count);
+
+	printf("%-10s format %5.1f -> %5.1f ns, parse %5.1f -> %5.1f ns (%d)\n",
+		name, fmt_old, fmt_new, parse_old, parse_new, (int)(sum & 1));
+}
+
+int main(int argc, char **argv){
+	int count = argc > 1? atoi(argv[1]) : 1000000;
+	std::mt19937_64 rng(1);
+	std::vector<int64_t> lengths, counters, stamps, wide;
+	for(int i=0; i<count; i++){
+		// record lengths: mostly short keys and values, a few large blobs
+		lengths.push_back((int64_t)(rng() % ((i % 16 == 0)? 1024 * 1024 : 128)));
+		counters.push_back((int64_t)(rng() % 100000) - 50000);
+		// millisecond timestamps, the typical zset score
+		stamps.push_back(1700000000000LL + (int64_t)(rng() % 100000000000LL));
+		wide.push_back((int64_t)rng());
+	}
+#if defined(SSDB_HAVE_TO_CHARS)
+	printf("formatter: std::to_chars\n");
+#else
+	printf("formatter: digit pairs\n");
+#endif
+	run("lengths", lengths);
+	run("counters", counters);
+	run("timestamps", stamps);
+	run("int64", wide);
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+RESP encoding microbenchmark, an hgetall reply of many small fields
+written the way RedisLink::send_resp() did (snprintf of every "$len"
+header plus three Buffer::append() calls per field), against the sized
+once RespWriter path of send_resp(), from std::string fields and from
+the Bytes of a response still in a Link's buffer.
+
+	g++ -O2 -std=c++11 -I../include resp_bench.cpp \
+		../include/ssdb_bytes.cpp ../include/buffer_pool.cpp ../include/buffer_policy.cpp -o resp_bench
+	./resp_bench [fields] [field_size]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "link_redis.h"
+#include "link_redis.cpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// the multi-bulk loop of the former send_resp()
+static void encode_snprintf(Buffer *output, const std::vector<std::string> &resp){
+	char buf[32];
+	snprintf(buf, sizeof(buf), "*%d\r\n", (int)resp.size() - 1);
+	output->append(buf);
+	for(int i=1; i<(int)resp.size(); i++){
+		const std::string &val = resp[i];
+		snprintf(buf, sizeof(buf), "$%d\r\n", (int)val.size());
+		output->append(buf);
+		output->append(val.data(), val.size());
+		output->append("\r\n");
+	}
+}
+
+static double run(const char *name, int rounds, int bytes, void (*fn)(void *), void *arg){
+	Clock::time_point start = Clock::now();
+	for(int i=0; i<rounds; i++){
+		fn(arg);
+	}
+	double us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+	printf("%-10s %8.1f us/reply %8.0f MB/s\n", name, us / rounds, (double)bytes * rounds / us);
+	return us;
+}
+
+struct Ctx{
+	RedisLink redis;
+	Buffer *output;
+	std::vector<std::string> resp;
+	std::vector<Bytes> fields;
+};
+
+static void do_snprintf(void *arg){
+	Ctx *ctx = (Ctx *)arg;
+	encode_snprintf(ctx->output, ctx->resp);
+	ctx->output->decr(ctx->output->size());
+	ctx->output->nice();
+}
+
+static void do_string(void *arg){
+	Ctx *ctx = (Ctx *)arg;
+	ctx->redis.send_resp(ctx->output, ctx->resp);
+	ctx->output->decr(ctx->output->size());
+	ctx->output->nice();
+}
+
+static void do_bytes(void *arg){
+	Ctx *ctx = (Ctx *)arg;
+	ctx->redis.send_resp(ctx->output, ctx->fields);
+	ctx->output->decr(ctx->output->size());
+	ctx->output->nice();
+}
+
+int main(int argc, char **argv){
+	int num = argc > 1? atoi(argv[1]) : 10000;
+	int size = argc > 2? atoi(argv[2]) : 16;
+
+	Ctx ctx;
+	ctx.output = new Buffer(8 * 1024);
+	Buffer input(1024);
+	input.append("*2\r\n$7\r\nhgetall\r\n$1\r\nh\r\n");
+	ctx.redis.recv_req(&input);
+
+	ctx.resp.push_back("ok");
+	for(int i=0; i<num; i++){
+		ctx.resp.push_back(std::string(size, 'a' + i % 26));
+	}
+	for(int i=0; i<(int)ctx.resp.size(); i++){
+		ctx.fields.push_back(Bytes(ctx.resp[i]));
+	}
+
+	// warm up the buffer to its final size, and check all agree
+	encode_snprintf(ctx.output, ctx.resp);
+	std::string expect(ctx.output->data(), ctx.output->size());
+	ctx.output->decr(ctx.output->size());
+	ctx.redis.send_resp(ctx.output, ctx.fields);
+	if(expect != std::string(ctx.output->data(), ctx.output->size())){
+		printf("error: encoders differ\n");
+		return 1;
+	}
+	ctx.output->decr(ctx.output->size());
+
+	int rounds = (int)(200 * 1000 * 1000LL / expect.size());
+	if(rounds < 10){
+		rounds = 10;
+	}
+	printf("%d fields of %d bytes, reply %d bytes, %d rounds\n", num, size, (int)expect.size(), rounds);
+	double base = run("snprintf", rounds, (int)expect.size(), do_snprintf, &ctx);
+	double t1 = run("string", rounds, (int)expect.size(), do_string, &ctx);
+	double t2 = run("bytes", rounds, (int)expect.size(), do_bytes, &ctx);
+	printf("speedup: string %.2fx, bytes %.2fx\n", base / t1, base / t2);
+	delete ctx.output;
+	return 0;
+}
@@ -0,0 +1,185 @@
+/*
+Framing microbenchmark, a reply with many small fields parsed
+the way Link::recv() did (memchr, memcpy into head_str, atoi) against
+the ssdb_scan.h helpers.
+
+	g++ -O2 -std=c++11 -I../include scan_bench.cpp -o scan_bench
+	g++ -O2 -mavx2 -std=c++11 -I../include scan_bench.cpp -o scan_bench_avx2
+	./scan_bench [fields] [field_size]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include "ssdb_scan.h"
+
+struct Field{
+	const char *data;
+	int size;
+};
+
+// memchr + copy + atoi, as in Link::recv()
+static int parse_memchr(const char *head, int size, Field *out){
+	int num = 0;
+	while(size > 0){
+		const char *body = (const char *)memchr(head, '\n', size);
+		if(body == NULL){
+			break;
+		}
+		body ++;
+		int head_len = body - head;
+		if(head_len == 1){
+			break;
+		}
+		char head_str[20];
+		if(head_len > (int)sizeof(head_str) - 1){
+			return -1;
+		}
+		memcpy(head_str, head, head_len - 1);
+		head_str[head_len - 1] = '\0';
+		int body_len = atoi(head_str);
+		size -= head_len + body_len + 1;
+		if(size < 0){
+			break;
+		}
+		out[num].data = body;
+		out[num].size = body_len;
+		num ++;
+		head += head_len + body_len + 1;
+	}
+	return num;
+}
+
+// in place length parse
+static int parse_inplace(const char *head, int size, Field *out){
+	int num = 0;
+	while(size > 0){
+		if(head[0] == '\n'){
+			break;
+		}
+		int body_len;
+		int head_len = parse_header(head, size, &body_len);
+		if(head_len <= 0){
+			return head_len;
+		}
+		size -= head_len + body_len + 1;
+		if(size < 0){
+			break;
+		}
+		out[num].data = head + head_len;
+		out[num].size = body_len;
+		num ++;
+		head += head_len + body_len + 1;
+	}
+	return num;
+}
+
+// SIMD newline search, then in place length parse
+static int parse_simd(const char *head, int size, Field *out){
+	int num = 0;
+	while(size > 0){
+		int lf = find_newline(head, size);
+		if(lf <= 0){
+			break;
+		}
+		int body_len;
+		int head_len = parse_header(head, lf + 1, &body_len);
+		if(head_len <= 0){
+			return -1;
+		}
+		size -= head_len + body_len + 1;
+		if(size < 0){
+			break;
+		}
+		out[num].data = head + head_len;
+		out[num].size = body_len;
+		num ++;
+		head += head_len + body_len + 1;
+	}
+	return num;
+}
+
+// index every newline of the block first, then walk the index
+static int parse_index(const char *head, int size, Field *out, int *pos, int max_pos){
+	int num_pos = scan_newlines(head, size, pos, max_pos);
+	int num = 0;
+	int off = 0;
+	int k = 0;
+	while(off < size){
+		while(k < num_pos && pos[k] < off){
+			k ++;
+		}
+		if(k == num_pos){
+			break;
+		}
+		if(pos[k] == off){
+			break;
+		}
+		int body_len;
+		int head_len = parse_header(head + off, pos[k] - off + 1, &body_len);
+		if(head_len <= 0){
+			return -1;
+		}
+		if(off + head_len + body_len + 1 > size){
+			break;
+		}
+		out[num].data = head + off + head_len;
+		out[num].size = body_len;
+		num ++;
+		off += head_len + body_len + 1;
+	}
+	return num;
+}
+
+int main(int argc, char **argv){
+	int fields = argc > 1? atoi(argv[1]) : 100000;
+	int field_size = argc > 2? atoi(argv[2]) : 10;
+
+	std::string packet;
+	std::string val(field_size, 'k');
+	for(int i=0; i<fields; i++){
+		char len[16];
+		snprintf(len, sizeof(len), "%d\n", field_size);
+		packet.append(len);
+		packet.append(val);
+		packet.push_back('\n');
+	}
+	packet.push_back('\n');
+
+	Field *out = new Field[fields];
+	int max_pos = (int)packet.size();
+	int *pos = new int[max_pos];
+	const int rounds = 50;
+	const char *names[] = {"memchr+atoi", "in place", "simd+in place", "newline index"};
+#if defined(SSDB_SCAN_AVX2)
+	printf("kernel: avx2\n");
+#elif defined(SSDB_SCAN_SSE2)
+	printf("kernel: sse2\n");
+#else
+	printf("kernel: scalar\n");
+#endif
+	for(int m=0; m<4; m++){
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int num = 0;
+		for(int r=0; r<rounds; r++){
+			const char *p = packet.data();
+			int size = (int)packet.size();
+			switch(m){
+			case 0: num = parse_memchr(p, size, out); break;
+			case 1: num = parse_inplace(p, size, out); break;
+			case 2: num = parse_simd(p, size, out); break;
+			case 3: num = parse_index(p, size, out, pos, max_pos); break;
+			}
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if(num != fields){
+			printf("%s: parsed %d of %d fields\n", names[m], num, fields);
+			return 1;
+		}
+		printf("%-14s %6.1f ns/field\n", names[m], elapsed.count() * 1e9 / ((double)fields * rounds));
+	}
+	delete[] out;
+	delete[] pos;
+	return 0;
+}
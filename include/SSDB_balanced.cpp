@@ -0,0 +1,240 @@
+#include "SSDB_balanced.h"
+#include "SSDB_reply.h"
+#include "ssdb_strings.h"
+#include <chrono>
+#if !defined(_WIN32)
+	#include <signal.h>
+#endif
+
+namespace ssdb{
+
+typedef std::chrono::steady_clock Clock;
+
+static int64_t elapsed_us(Clock::time_point since){
+	return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - since).count();
+}
+
+// ip and port never change, connecting and fresh are guarded by mutex_
+struct BalancedClient::Replica{
+	ClientImpl *client;
+	std::string ip;
+	int port;
+	// when the connection failed, or the last attempt to reconnect
+	Clock::time_point failed_at;
+	// queued for, or being connected by, the reconnect thread
+	bool connecting;
+	// the connection it made, not in use yet
+	ClientImpl *fresh;
+
+	Replica(ClientImpl *client, const std::string &ip, int port){
+		this->client = client;
+		this->ip = ip;
+		this->port = port;
+		this->connecting = false;
+		this->fresh = NULL;
+	}
+	~Replica(){
+		delete client;
+		delete fresh;
+	}
+};
+
+BalancedClient::BalancedClient(){
+	balancer_ = new P2CBalancer();
+	retry_interval_ = 5;
+	master_reads_ = 0;
+	stop_ = false;
+}
+
+BalancedClient::~BalancedClient(){
+	if(thread_.joinable()){
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		cond_.notify_one();
+		thread_.join();
+	}
+	for(int i=0; i<(int)replicas_.size(); i++){
+		delete replicas_[i];
+	}
+	delete balancer_;
+}
+
+BalancedClient* BalancedClient::connect(const char *ip, int port){
+	return BalancedClient::connect(std::string(ip), port);
+}
+
+BalancedClient* BalancedClient::connect(const std::string &ip, int port){
+#if !defined(_WIN32)
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	Link *link = Link::connect(ip.c_str(), port);
+	if(link == NULL){
+		return NULL;
+	}
+	BalancedClient *client = new BalancedClient();
+	client->link = link;
+	return client;
+}
+
+bool BalancedClient::add_replica(const std::string &ip, int port){
+	// Client::connect() always makes a ClientImpl
+	ClientImpl *client = static_cast<ClientImpl *>(Client::connect(ip, port));
+	if(client == NULL){
+		return false;
+	}
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		replicas_.push_back(new Replica(client, ip, port));
+	}
+	balancer_->resize((int)replicas_.size());
+	return true;
+}
+
+void BalancedClient::balancer(const Balancer &balancer){
+	delete balancer_;
+	balancer_ = balancer.clone();
+	balancer_->resize((int)replicas_.size());
+}
+
+// revive the replicas the reconnect thread connected, and queue the ones
+// which failed more than retry_interval_ ago
+void BalancedClient::reconnect(){
+	Clock::time_point now = Clock::now();
+	std::unique_lock<std::mutex> lock(mutex_);
+	for(int i=0; i<(int)replicas_.size(); i++){
+		Replica *replica = replicas_[i];
+		if(!balancer_->is_down(i)){
+			continue;
+		}
+		if(replica->fresh){
+			delete replica->client;
+			replica->client = replica->fresh;
+			replica->fresh = NULL;
+			balancer_->revive(i);
+			continue;
+		}
+		if(replica->connecting || now - replica->failed_at < std::chrono::seconds(retry_interval_)){
+			continue;
+		}
+		replica->failed_at = now;
+		replica->connecting = true;
+		queue_.push_back(i);
+		if(!thread_.joinable()){
+			thread_ = std::thread(&BalancedClient::run, this);
+		}
+		cond_.notify_one();
+	}
+}
+
+// connects the replicas reconnect() queues, one at a time
+void BalancedClient::run(){
+	std::unique_lock<std::mutex> lock(mutex_);
+	while(1){
+		while(queue_.empty() && !stop_){
+			cond_.wait(lock);
+		}
+		if(stop_){
+			break;
+		}
+		Replica *replica = replicas_[queue_.front()];
+		queue_.pop_front();
+		lock.unlock();
+		Client *client = Client::connect(replica->ip, replica->port);
+		lock.lock();
+		replica->connecting = false;
+		replica->fresh = static_cast<ClientImpl *>(client);
+	}
+}
+
+int BalancedClient::pick(){
+	for(int i=0; i<(int)replicas_.size(); i++){
+		if(balancer_->is_down(i)){
+			this->reconnect();
+			break;
+		}
+	}
+	return balancer_->pick();
+}
+
+const std::vector<std::string>* BalancedClient::read(const std::vector<std::string> &req){
+	// the first replica which fails gets one retry elsewhere
+	for(int attempt=0; attempt<2; attempt++){
+		int idx = this->pick();
+		if(idx == -1){
+			break;
+		}
+		Replica *replica = replicas_[idx];
+		Clock::time_point start = Clock::now();
+		balancer_->start(idx);
+		const std::vector<std::string> *resp = replica->client->request(req);
+		balancer_->done(idx, elapsed_us(start), resp != NULL);
+		if(resp){
+			return resp;
+		}
+		replica->failed_at = Clock::now();
+	}
+	master_reads_ ++;
+	return ClientImpl::request(req);
+}
+
+const std::vector<std::string>* BalancedClient::request(const std::vector<std::string> &req){
+	if(!req.empty() && _is_read_command(req[0])){
+		return this->read(req);
+	}
+	return ClientImpl::request(req);
+}
+
+// a streamed reply may be half delivered when its replica fails, so it is not retried
+Status BalancedClient::request_stream(const std::vector<std::string> &req, ReplyHandler *handler){
+	int idx = -1;
+	if(!req.empty() && _is_read_command(req[0])){
+		idx = this->pick();
+	}
+	if(idx == -1){
+		return ClientImpl::request_stream(req, handler);
+	}
+	Replica *replica = replicas_[idx];
+	Clock::time_point start = Clock::now();
+	balancer_->start(idx);
+	Status s = replica->client->request_stream(req, handler);
+	bool ok = !replica->client->broken();
+	balancer_->done(idx, elapsed_us(start), ok);
+	if(!ok){
+		replica->failed_at = Clock::now();
+	}
+	return s;
+}
+
+Status BalancedClient::request_stream(const Slice *head, int head_num,
+	const Slice *args, int num, ReplyHandler *handler)
+{
+	int idx = -1;
+	if(head_num > 0 && _is_read_command(head[0].data, head[0].size)){
+		idx = this->pick();
+	}
+	if(idx == -1){
+		return ClientImpl::request_stream(head, head_num, args, num, handler);
+	}
+	Replica *replica = replicas_[idx];
+	Clock::time_point start = Clock::now();
+	balancer_->start(idx);
+	Status s = replica->client->request_stream(head, head_num, args, num, handler);
+	bool ok = !replica->client->broken();
+	balancer_->done(idx, elapsed_us(start), ok);
+	if(!ok){
+		replica->failed_at = Clock::now();
+	}
+	return s;
+}
+
+std::string BalancedClient::stats() const{
+	std::string ret = "master reads: " + str(master_reads_);
+	for(int i=0; i<(int)replicas_.size(); i++){
+		ret.append("\n" + replicas_[i]->ip + ":" + str(replicas_[i]->port) + ": " + balancer_->stats(i));
+	}
+	return ret;
+}
+
+}; // namespace ssdb
@@ -0,0 +1,94 @@
+#ifndef SSDB_API_BALANCED_CPP
+#define SSDB_API_BALANCED_CPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SSDB_impl.h"
+#include "balancer.h"
+
+namespace ssdb{
+
+/**
+ * A client writing to a master and spreading reads over its replicas.
+ *
+ * Writes and any command not known to be a read (get, hget, exists,
+ * multi_get, zget, ...) go to the master. Every read goes to the replica
+ * picked by the Balancer, a P2CBalancer by default, which weighs each
+ * replica's recent latency by the requests it has in flight. Replicas may
+ * lag, a read can return older data than the master holds.
+ *
+ * A read whose replica fails is retried once on another replica, and on
+ * the master when no replica is left. The first read after a failed
+ * replica has been down retry_interval() seconds hands it to a background
+ * thread to reconnect, reads never wait for a connect, they go to the
+ * live replicas until a later read finds the replica connected again.
+ */
+class BalancedClient : public ClientImpl{
+private:
+	struct Replica;
+
+	std::vector<Replica *> replicas_;
+	Balancer *balancer_;
+	int retry_interval_;
+	int64_t master_reads_;
+
+	// the reconnect thread, started when a replica first needs it, and
+	// the replicas waiting for it, by index
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	std::deque<int> queue_;
+	bool stop_;
+
+	BalancedClient();
+	void reconnect();
+	void run();
+	int pick();
+	const std::vector<std::string>* read(const std::vector<std::string> &req);
+public:
+	~BalancedClient();
+
+	static BalancedClient* connect(const char *ip, int port);
+	static BalancedClient* connect(const std::string &ip, int port);
+
+	/**
+	 * Add a replica to send reads to.
+	 * @return false if it can not be connected.
+	 */
+	bool add_replica(const std::string &ip, int port);
+
+	/**
+	 * Replace the policy picking replicas, the client keeps its own copy.
+	 * Its statistics start over.
+	 */
+	void balancer(const Balancer &balancer);
+	const Balancer* balancer() const{
+		return balancer_;
+	}
+	/**
+	 * Seconds before a failed replica is connected again. Default 5.
+	 */
+	void retry_interval(int seconds){
+		retry_interval_ = seconds >= 0? seconds : 0;
+	}
+
+	/**
+	 * Reads served by the master, then the balancer's line per replica.
+	 */
+	std::string stats() const;
+
+	using ClientImpl::request;
+	virtual const std::vector<std::string>* request(const std::vector<std::string> &req);
+	using ClientImpl::request_stream;
+	virtual Status request_stream(const std::vector<std::string> &req, ReplyHandler *handler);
+	virtual Status request_stream(const Slice *head, int head_num,
+		const Slice *args, int num, ReplyHandler *handler);
+};
+
+}; // namespace ssdb
+
+#endif
@@ -59,13 +59,111 @@ private:
 	std::string code_;
 };
 
+/**
+ * A borrowed range of bytes, used by the Slice methods of Client to pass
+ * keys and values without copying them into std::string. The bytes must
+ * stay valid for the duration of the call.
+ *
+ * There is no constructor from a bare const char *, so that set("k", "v")
+ * still resolves to the std::string methods.
+ */
+class Slice{
+public:
+	const char *data;
+	int size;
+
+	Slice(){
+		data = "";
+		size = 0;
+	}
+	Slice(const char *data, int size){
+		this->data = data;
+		this->size = size;
+	}
+	Slice(const std::string &str){
+		data = str.data();
+		size = (int)str.size();
+	}
+};
+
+/**
+ * Receives the items of a reply one at a time, see Client::request_stream().
+ */
+class ReplyHandler{
+public:
+	virtual ~ReplyHandler(){}
+	/**
+	 * Called for every item following the status code, data is only valid
+	 * during the call. Return -1 to skip the remaining items.
+	 */
+	virtual int item(const char *data, int size) = 0;
+};
+
+/**
+ * Holds the items of a reply in one contiguous block, with their ends in a
+ * second array, instead of one std::string per item.
+ *
+ * Methods taking a ResultArena clear it first, the memory is kept, so an
+ * arena reused across calls stops allocating once it has grown to the
+ * largest reply. Slices returned by at() are valid until the arena is
+ * cleared or filled again.
+ */
+class ResultArena : public ReplyHandler{
+public:
+	void clear(){
+		data_.clear();
+		ends_.clear();
+	}
+	bool empty() const{
+		return ends_.empty();
+	}
+	int size() const{
+		return (int)ends_.size();
+	}
+	Slice at(int i) const{
+		int start = (i == 0)? 0 : ends_[i - 1];
+		return Slice(data_.data() + start, ends_[i] - start);
+	}
+	Slice operator[](int i) const{
+		return this->at(i);
+	}
+	std::string str(int i) const{
+		Slice s = this->at(i);
+		return std::string(s.data, s.size);
+	}
+	// reserve room for num items of bytes in total
+	void reserve(int num, int bytes){
+		ends_.reserve(num);
+		data_.reserve(bytes);
+	}
+
+	virtual int item(const char *data, int size){
+		data_.append(data, size);
+		ends_.push_back((int)data_.size());
+		return 0;
+	}
+private:
+	std::string data_;
+	std::vector<int> ends_;
+};
+
 /**
  * The SSDB client used to connect to SSDB server.
  */
 class Client{
 public:
+	enum Protocol{
+		PROTOCOL_SSDB,
+		/**
+		 * RESP2, for the redis port of SSDB or a Redis compatible server.
+		 * The common commands are translated, see RespCodec in link_codec.h.
+		 */
+		PROTOCOL_RESP
+	};
+
 	static Client* connect(const char *ip, int port);
 	static Client* connect(const std::string &ip, int port);
+	static Client* connect(const std::string &ip, int port, Protocol protocol);
 	Client(){};
 	virtual ~Client(){};
 
@@ -243,6 +341,85 @@ public:
 	virtual Status qslice(const std::string &name, int64_t begin, int64_t end, std::vector<std::string> *ret) = 0;
 	virtual Status qrange(const std::string &name, int64_t begin, int64_t limit, std::vector<std::string> *ret) = 0;
 	virtual Status qclear(const std::string &name, int64_t *ret=NULL) = 0;
+
+	/// @name Streaming methods
+	/// Items of the reply are handed to the handler as they arrive instead of
+	/// being collected, so memory use does not grow with the reply size.
+	/// Items are only delivered when the status is ok.
+	/// @{
+	virtual Status request_stream(const std::vector<std::string> &req, ReplyHandler *handler);
+	/**
+	 * Key-value pairs arrive as two consecutive items.
+	 */
+	Status scan_stream(const std::string &key_start, const std::string &key_end,
+		uint64_t limit, ReplyHandler *handler);
+	Status hgetall_stream(const std::string &name, ReplyHandler *handler);
+	Status hscan_stream(const std::string &name, const std::string &key_start, const std::string &key_end,
+		uint64_t limit, ReplyHandler *handler);
+	Status qslice_stream(const std::string &name, int64_t begin, int64_t end, ReplyHandler *handler);
+	/// @}
+
+	/// @name Slice methods
+	/// Arguments are sent straight from the caller's memory and results are
+	/// written into caller-owned buffers, so a request allocates nothing.
+	/// Pairs are passed flat, kvs[n] and kvs[n+1] form a key-value pair,
+	/// n=0,2,4,..., num is the number of Slices.
+	/// @{
+	/**
+	 * Send head followed by args, the reply is streamed to handler.
+	 */
+	virtual Status request_stream(const Slice *head, int head_num,
+		const Slice *args, int num, ReplyHandler *handler);
+	Status request_stream(const Slice *req, int num, ReplyHandler *handler){
+		return this->request_stream(req, num, NULL, 0, handler);
+	}
+	/**
+	 * Copy at most size bytes of the value into buf, *len is set to the
+	 * full length of the value, the value is truncated if *len > size.
+	 */
+	Status get(const Slice &key, char *buf, int size, int *len);
+	Status set(const Slice &key, const Slice &val);
+	Status setx(const Slice &key, const Slice &val, int ttl);
+	Status del(const Slice &key);
+	/**
+	 * Found keys and their values arrive as two consecutive items.
+	 */
+	Status multi_get(const Slice *keys, int num, ReplyHandler *handler);
+	Status multi_set(const Slice *kvs, int num);
+	Status multi_del(const Slice *keys, int num);
+	/**
+	 * Same as get(const Slice &, char *, int, int *).
+	 */
+	Status hget(const Slice &name, const Slice &key, char *buf, int size, int *len);
+	Status hset(const Slice &name, const Slice &key, const Slice &val);
+	Status hdel(const Slice &name, const Slice &key);
+	Status multi_hset(const Slice &name, const Slice *kvs, int num);
+	/// @}
+
+	/// @name ResultArena methods
+	/// Same as the methods returning a std::vector<std::string>, with the
+	/// items stored in ret, see ResultArena.
+	/// @{
+	Status scan(const std::string &key_start, const std::string &key_end,
+		uint64_t limit, ResultArena *ret);
+	Status rscan(const std::string &key_start, const std::string &key_end,
+		uint64_t limit, ResultArena *ret);
+	Status multi_get(const std::vector<std::string> &keys, ResultArena *ret);
+	Status hgetall(const std::string &name, ResultArena *ret);
+	Status hscan(const std::string &name, const std::string &key_start, const std::string &key_end,
+		uint64_t limit, ResultArena *ret);
+	Status hrscan(const std::string &name, const std::string &key_start, const std::string &key_end,
+		uint64_t limit, ResultArena *ret);
+	Status multi_hget(const std::string &name, const std::vector<std::string> &keys, ResultArena *ret);
+	Status zrange(const std::string &name, uint64_t offset, uint64_t limit, ResultArena *ret);
+	Status zrrange(const std::string &name, uint64_t offset, uint64_t limit, ResultArena *ret);
+	Status zscan(const std::string &name, const std::string &key_start,
+		int64_t *score_start, int64_t *score_end,
+		uint64_t limit, ResultArena *ret);
+	Status zrscan(const std::string &name, const std::string &key_start,
+		int64_t *score_start, int64_t *score_end,
+		uint64_t limit, ResultArena *ret);
+	/// @}
 private:
 	// No copying allowed
 	Client(const Client&);
@@ -0,0 +1,512 @@
+#include "SSDB_coro.h"
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <algorithm>
+#include "SSDB_reply.h"
+#include "ssdb_strings.h"
+#if !defined(_WIN32)
+	#include <signal.h>
+	#include <sys/select.h>
+#endif
+
+namespace ssdb{
+namespace coro{
+
+/******************** decoders *************************/
+
+static Status decode_status(const std::vector<std::string> *resp, void *){
+	return Status(resp);
+}
+
+static Status decode_str(const std::vector<std::string> *resp, void *out){
+	return _read_str(resp, (std::string *)out);
+}
+
+static Status decode_int64(const std::vector<std::string> *resp, void *out){
+	return _read_int64(resp, (int64_t *)out);
+}
+
+static Status decode_list(const std::vector<std::string> *resp, void *out){
+	if(out == NULL){
+		return Status(resp);
+	}
+	return _read_list(resp, (std::vector<std::string> *)out);
+}
+
+static Status decode_size(const std::vector<std::string> *resp, void *out){
+	Status s(resp);
+	if(out != NULL && s.ok()){
+		if(resp->size() > 1){
+			*(int64_t *)out = str_to_int64(resp->at(1));
+		}else{
+			return Status("error");
+		}
+	}
+	return s;
+}
+
+/******************** executor *************************/
+
+void LoopExecutor::post(std::coroutine_handle<> h){
+	ready_.push_back(h);
+}
+
+void LoopExecutor::watch(AsyncClient *client){
+	clients_.push_back(client);
+}
+
+void LoopExecutor::unwatch(AsyncClient *client){
+	clients_.erase(std::remove(clients_.begin(), clients_.end(), client), clients_.end());
+}
+
+int LoopExecutor::run_once(int timeout_ms){
+	int resumed = 0;
+	while(!ready_.empty()){
+		std::coroutine_handle<> h = ready_.front();
+		ready_.pop_front();
+		h.resume();
+		resumed ++;
+	}
+
+	fd_set rfds, wfds;
+	FD_ZERO(&rfds);
+	FD_ZERO(&wfds);
+	int maxfd = -1;
+	for(size_t i=0; i<clients_.size(); i++){
+		AsyncClient *c = clients_[i];
+		if(!c->busy()){
+			continue;
+		}
+		FD_SET(c->fd(), &rfds);
+		if(c->want_write()){
+			FD_SET(c->fd(), &wfds);
+		}
+		maxfd = std::max(maxfd, c->fd());
+	}
+	if(maxfd == -1){
+		return resumed;
+	}
+
+	struct timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	int ret = ::select(maxfd + 1, &rfds, &wfds, NULL, &tv);
+	if(ret == -1){
+		return errno == EINTR? resumed : -1;
+	}
+	// on_io() may unwatch clients, walk over a copy
+	std::vector<AsyncClient *> clients = clients_;
+	for(size_t i=0; i<clients.size() && ret > 0; i++){
+		AsyncClient *c = clients[i];
+		bool r = FD_ISSET(c->fd(), &rfds);
+		bool w = FD_ISSET(c->fd(), &wfds);
+		if(r || w){
+			c->on_io(r, w);
+		}
+	}
+	return resumed;
+}
+
+void LoopExecutor::run(){
+	while(1){
+		bool busy = !ready_.empty();
+		for(size_t i=0; !busy && i<clients_.size(); i++){
+			busy = clients_[i]->busy();
+		}
+		if(!busy){
+			break;
+		}
+		if(this->run_once(100) == -1){
+			break;
+		}
+	}
+}
+
+/******************** request *************************/
+
+Request::Request(AsyncClient *client, const std::vector<std::string> &req, ReplyDecoder decoder, void *out){
+	client_ = client;
+	decoder_ = decoder;
+	out_ = out;
+	failed_ = false;
+	Link::encode_packet(req, &packet_);
+}
+
+void Request::await_suspend(std::coroutine_handle<> h){
+	handle_ = h;
+	client_->start(this);
+}
+
+/******************** client *************************/
+
+AsyncClient::AsyncClient(Link *link, Executor *executor){
+	this->link = link;
+	this->executor = executor;
+	executor->watch(this);
+}
+
+AsyncClient::~AsyncClient(){
+	executor->unwatch(this);
+	this->fail_all();
+	delete link;
+}
+
+AsyncClient* AsyncClient::connect(const char *ip, int port, Executor *executor){
+	return AsyncClient::connect(std::string(ip), port, executor);
+}
+
+AsyncClient* AsyncClient::connect(const std::string &ip, int port, Executor *executor){
+#if !defined(_WIN32)
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	Link *link = Link::connect(ip.c_str(), port);
+	if(link == NULL){
+		return NULL;
+	}
+	link->nodelay(true);
+	link->noblock(true);
+	return new AsyncClient(link, executor);
+}
+
+void AsyncClient::start(Request *req){
+	if(link->error() || link->send_packet(req->packet_.data(), (int)req->packet_.size()) == -1){
+		req->failed_ = true;
+		executor->post(req->handle_);
+		return;
+	}
+	pending_.push_back(req);
+	// try to send at once, the rest is written when the socket is writable
+	if(link->write() == -1){
+		this->fail_all();
+	}
+}
+
+void AsyncClient::fail_all(){
+	link->mark_error();
+	while(!pending_.empty()){
+		Request *req = pending_.front();
+		pending_.pop_front();
+		req->failed_ = true;
+		executor->post(req->handle_);
+	}
+}
+
+int AsyncClient::on_io(bool readable, bool writable){
+	if(link->error()){
+		return -1;
+	}
+	if(writable && !link->output->empty()){
+		if(link->write() == -1){
+			this->fail_all();
+			return -1;
+		}
+	}
+	if(readable){
+		if(link->read() <= 0){
+			this->fail_all();
+			return -1;
+		}
+		while(!pending_.empty()){
+			const std::vector<Bytes> *packet = link->recv();
+			if(packet == NULL){
+				this->fail_all();
+				return -1;
+			}
+			if(packet->empty()){
+				break;
+			}
+			Request *req = pending_.front();
+			pending_.pop_front();
+			req->resp_.clear();
+			for(std::vector<Bytes>::const_iterator it=packet->begin(); it!=packet->end(); it++){
+				req->resp_.push_back(it->String());
+			}
+			executor->post(req->handle_);
+		}
+	}
+	return 0;
+}
+
+Request AsyncClient::request(const std::vector<std::string> &req, std::vector<std::string> *out){
+	return Request(this, req, decode_list, out);
+}
+
+static std::vector<std::string> join(const char *cmd, const std::vector<std::string> &items){
+	std::vector<std::string> req;
+	req.reserve(items.size() + 1);
+	req.push_back(cmd);
+	req.insert(req.end(), items.begin(), items.end());
+	return req;
+}
+
+static std::vector<std::string> join(const char *cmd, const std::string &name, const std::vector<std::string> &items){
+	std::vector<std::string> req;
+	req.reserve(items.size() + 2);
+	req.push_back(cmd);
+	req.push_back(name);
+	req.insert(req.end(), items.begin(), items.end());
+	return req;
+}
+
+/******************** misc *************************/
+
+Request AsyncClient::dbsize(int64_t *ret){
+	return Request(this, {"dbsize"}, decode_int64, ret);
+}
+
+/******************** KV *************************/
+
+Request AsyncClient::get(const std::string &key, std::string *val){
+	return Request(this, {"get", key}, decode_str, val);
+}
+
+Request AsyncClient::set(const std::string &key, const std::string &val){
+	return Request(this, {"set", key, val}, decode_status, NULL);
+}
+
+Request AsyncClient::setx(const std::string &key, const std::string &val, int ttl){
+	return Request(this, {"setx", key, val, str(ttl)}, decode_status, NULL);
+}
+
+Request AsyncClient::del(const std::string &key){
+	return Request(this, {"del", key}, decode_status, NULL);
+}
+
+Request AsyncClient::incr(const std::string &key, int64_t incrby, int64_t *ret){
+	return Request(this, {"incr", key, str(incrby)}, decode_int64, ret);
+}
+
+Request AsyncClient::keys(const std::string &key_start, const std::string &key_end,
+	uint64_t limit, std::vector<std::string> *ret)
+{
+	return Request(this, {"keys", key_start, key_end, str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::scan(const std::string &key_start, const std::string &key_end,
+	uint64_t limit, std::vector<std::string> *ret)
+{
+	return Request(this, {"scan", key_start, key_end, str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::rscan(const std::string &key_start, const std::string &key_end,
+	uint64_t limit, std::vector<std::string> *ret)
+{
+	return Request(this, {"rscan", key_start, key_end, str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::multi_get(const std::vector<std::string> &keys, std::vector<std::string> *ret){
+	return Request(this, join("multi_get", keys), decode_list, ret);
+}
+
+Request AsyncClient::multi_set(const std::map<std::string, std::string> &kvs){
+	std::vector<std::string> req;
+	req.push_back("multi_set");
+	for(std::map<std::string, std::string>::const_iterator it = kvs.begin(); it != kvs.end(); ++it){
+		req.push_back(it->first);
+		req.push_back(it->second);
+	}
+	return Request(this, req, decode_status, NULL);
+}
+
+Request AsyncClient::multi_del(const std::vector<std::string> &keys){
+	return Request(this, join("multi_del", keys), decode_status, NULL);
+}
+
+/******************** hash *************************/
+
+Request AsyncClient::hget(const std::string &name, const std::string &key, std::string *val){
+	return Request(this, {"hget", name, key}, decode_str, val);
+}
+
+Request AsyncClient::hset(const std::string &name, const std::string &key, const std::string &val){
+	return Request(this, {"hset", name, key, val}, decode_status, NULL);
+}
+
+Request AsyncClient::hdel(const std::string &name, const std::string &key){
+	return Request(this, {"hdel", name, key}, decode_status, NULL);
+}
+
+Request AsyncClient::hincr(const std::string &name, const std::string &key, int64_t incrby, int64_t *ret){
+	return Request(this, {"hincr", name, key, str(incrby)}, decode_int64, ret);
+}
+
+Request AsyncClient::hsize(const std::string &name, int64_t *ret){
+	return Request(this, {"hsize", name}, decode_int64, ret);
+}
+
+Request AsyncClient::hclear(const std::string &name, int64_t *ret){
+	return Request(this, {"hclear", name}, decode_int64, ret);
+}
+
+Request AsyncClient::hkeys(const std::string &name, const std::string &key_start, const std::string &key_end,
+	uint64_t limit, std::vector<std::string> *ret)
+{
+	return Request(this, {"hkeys", name, key_start, key_end, str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::hgetall(const std::string &name, std::vector<std::string> *ret){
+	return Request(this, {"hgetall", name}, decode_list, ret);
+}
+
+Request AsyncClient::hscan(const std::string &name, const std::string &key_start, const std::string &key_end,
+	uint64_t limit, std::vector<std::string> *ret)
+{
+	return Request(this, {"hscan", name, key_start, key_end, str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::hrscan(const std::string &name, const std::string &key_start, const std::string &key_end,
+	uint64_t limit, std::vector<std::string> *ret)
+{
+	return Request(this, {"hrscan", name, key_start, key_end, str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::multi_hget(const std::string &name, const std::vector<std::string> &keys,
+	std::vector<std::string> *ret)
+{
+	return Request(this, join("multi_hget", name, keys), decode_list, ret);
+}
+
+Request AsyncClient::multi_hset(const std::string &name, const std::map<std::string, std::string> &kvs){
+	std::vector<std::string> req;
+	req.push_back("multi_hset");
+	req.push_back(name);
+	for(std::map<std::string, std::string>::const_iterator it = kvs.begin(); it != kvs.end(); ++it){
+		req.push_back(it->first);
+		req.push_back(it->second);
+	}
+	return Request(this, req, decode_status, NULL);
+}
+
+Request AsyncClient::multi_hdel(const std::string &name, const std::vector<std::string> &keys){
+	return Request(this, join("multi_hdel", name, keys), decode_status, NULL);
+}
+
+/******************** zset *************************/
+
+Request AsyncClient::zget(const std::string &name, const std::string &key, int64_t *ret){
+	return Request(this, {"zget", name, key}, decode_int64, ret);
+}
+
+Request AsyncClient::zset(const std::string &name, const std::string &key, int64_t score){
+	return Request(this, {"zset", name, key, str(score)}, decode_status, NULL);
+}
+
+Request AsyncClient::zdel(const std::string &name, const std::string &key){
+	return Request(this, {"zdel", name, key}, decode_status, NULL);
+}
+
+Request AsyncClient::zincr(const std::string &name, const std::string &key, int64_t incrby, int64_t *ret){
+	return Request(this, {"zincr", name, key, str(incrby)}, decode_int64, ret);
+}
+
+Request AsyncClient::zsize(const std::string &name, int64_t *ret){
+	return Request(this, {"zsize", name}, decode_int64, ret);
+}
+
+Request AsyncClient::zclear(const std::string &name, int64_t *ret){
+	return Request(this, {"zclear", name}, decode_int64, ret);
+}
+
+Request AsyncClient::zrank(const std::string &name, const std::string &key, int64_t *ret){
+	return Request(this, {"zrank", name, key}, decode_int64, ret);
+}
+
+Request AsyncClient::zrrank(const std::string &name, const std::string &key, int64_t *ret){
+	return Request(this, {"zrrank", name, key}, decode_int64, ret);
+}
+
+Request AsyncClient::zrange(const std::string &name, uint64_t offset, uint64_t limit,
+	std::vector<std::string> *ret)
+{
+	return Request(this, {"zrange", name, str(offset), str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::zrrange(const std::string &name, uint64_t offset, uint64_t limit,
+	std::vector<std::string> *ret)
+{
+	return Request(this, {"zrrange", name, str(offset), str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::zkeys(const std::string &name, const std::string &key_start,
+	int64_t *score_start, int64_t *score_end,
+	uint64_t limit, std::vector<std::string> *ret)
+{
+	std::string s_score_start = score_start? str(*score_start) : "";
+	std::string s_score_end = score_end? str(*score_end) : "";
+	return Request(this, {"zkeys", name, key_start, s_score_start, s_score_end, str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::zscan(const std::string &name, const std::string &key_start,
+	int64_t *score_start, int64_t *score_end,
+	uint64_t limit, std::vector<std::string> *ret)
+{
+	std::string s_score_start = score_start? str(*score_start) : "";
+	std::string s_score_end = score_end? str(*score_end) : "";
+	return Request(this, {"zscan", name, key_start, s_score_start, s_score_end, str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::zrscan(const std::string &name, const std::string &key_start,
+	int64_t *score_start, int64_t *score_end,
+	uint64_t limit, std::vector<std::string> *ret)
+{
+	std::string s_score_start = score_start? str(*score_start) : "";
+	std::string s_score_end = score_end? str(*score_end) : "";
+	return Request(this, {"zrscan", name, key_start, s_score_start, s_score_end, str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::multi_zget(const std::string &name, const std::vector<std::string> &keys,
+	std::vector<std::string> *scores)
+{
+	return Request(this, join("multi_zget", name, keys), decode_list, scores);
+}
+
+Request AsyncClient::multi_zset(const std::string &name, const std::map<std::string, int64_t> &kss){
+	std::vector<std::string> req;
+	req.push_back("multi_zset");
+	req.push_back(name);
+	for(std::map<std::string, int64_t>::const_iterator it = kss.begin(); it != kss.end(); ++it){
+		req.push_back(it->first);
+		req.push_back(str(it->second));
+	}
+	return Request(this, req, decode_status, NULL);
+}
+
+Request AsyncClient::multi_zdel(const std::string &name, const std::vector<std::string> &keys){
+	return Request(this, join("multi_zdel", name, keys), decode_status, NULL);
+}
+
+/******************** queue *************************/
+
+Request AsyncClient::qpush(const std::string &name, const std::string &item, int64_t *ret_size){
+	return Request(this, {"qpush", name, item}, decode_size, ret_size);
+}
+
+Request AsyncClient::qpush(const std::string &name, const std::vector<std::string> &items, int64_t *ret_size){
+	return Request(this, join("qpush", name, items), decode_size, ret_size);
+}
+
+Request AsyncClient::qpop(const std::string &name, std::string *ret){
+	return Request(this, {"qpop", name}, decode_str, ret);
+}
+
+Request AsyncClient::qpop(const std::string &name, int64_t limit, std::vector<std::string> *ret){
+	return Request(this, {"qpop", name, str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::qslice(const std::string &name, int64_t begin, int64_t end, std::vector<std::string> *ret){
+	return Request(this, {"qslice", name, str(begin), str(end)}, decode_list, ret);
+}
+
+Request AsyncClient::qrange(const std::string &name, int64_t begin, int64_t limit, std::vector<std::string> *ret){
+	return Request(this, {"qrange", name, str(begin), str(limit)}, decode_list, ret);
+}
+
+Request AsyncClient::qclear(const std::string &name, int64_t *ret){
+	return Request(this, {"qclear", name}, decode_int64, ret);
+}
+
+}; // namespace coro
+}; // namespace ssdb
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef SSDB_API_CORO_CPP
+#define SSDB_API_CORO_CPP
+
+// C++20 coroutine API, compiled only by compilers with coroutine support.
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include "SSDB_client.h"
+#include "link.h"
+
+namespace ssdb{
+namespace coro{
+
+class AsyncClient;
+
+/**
+ * Resumes coroutines and drives the I/O of AsyncClients.
+ *
+ * A user-supplied executor implements post() to schedule a coroutine,
+ * and for every watched client, registers fd() for reading (and for
+ * writing when want_write() is true) in its own event loop, calling
+ * on_io() when the socket is ready.
+ */
+class Executor{
+public:
+	virtual ~Executor(){}
+	virtual void post(std::coroutine_handle<> h) = 0;
+	virtual void watch(AsyncClient *client) = 0;
+	virtual void unwatch(AsyncClient *client) = 0;
+};
+
+/**
+ * The bundled single-threaded executor, polls watched clients with select().
+ */
+class LoopExecutor : public Executor{
+private:
+	std::deque<std::coroutine_handle<> > ready_;
+	std::vector<AsyncClient *> clients_;
+public:
+	virtual void post(std::coroutine_handle<> h);
+	virtual void watch(AsyncClient *client);
+	virtual void unwatch(AsyncClient *client);
+
+	/**
+	 * Resume ready coroutines, then wait at most timeout_ms for I/O.
+	 * @return number of coroutines resumed, -1 on error.
+	 */
+	int run_once(int timeout_ms);
+	// run until no coroutine is ready and no request is in flight
+	void run();
+};
+
+/**
+ * A detached coroutine, starts running at once and frees itself at the end.
+ *
+ *     ssdb::coro::Task worker(ssdb::coro::AsyncClient *c){
+ *         std::string val;
+ *         ssdb::Status s = co_await c->get("key", &val);
+ *     }
+ */
+struct Task{
+	struct promise_type{
+		Task get_return_object(){
+			return Task();
+		}
+		std::suspend_never initial_suspend() noexcept{
+			return std::suspend_never();
+		}
+		std::suspend_never final_suspend() noexcept{
+			return std::suspend_never();
+		}
+		void return_void(){}
+		void unhandled_exception(){
+			std::terminate();
+		}
+	};
+};
+
+typedef Status (*ReplyDecoder)(const std::vector<std::string> *resp, void *out);
+
+/**
+ * Awaitable request, suspends until the response arrives.
+ * co_await yields a Status, outputs are written through the pointer
+ * passed to the AsyncClient method.
+ */
+class Request{
+private:
+	friend class AsyncClient;
+
+	AsyncClient *client_;
+	std::string packet_;
+	ReplyDecoder decoder_;
+	void *out_;
+	std::vector<std::string> resp_;
+	bool failed_;
+	std::coroutine_handle<> handle_;
+
+	Request(AsyncClient *client, const std::vector<std::string> &req, ReplyDecoder decoder, void *out);
+public:
+	bool await_ready() const{
+		return false;
+	}
+	void await_suspend(std::coroutine_handle<> h);
+	Status await_resume(){
+		return decoder_(failed_? NULL : &resp_, out_);
+	}
+};
+
+/**
+ * Non-blocking SSDB client for coroutines.
+ * Requests issued by any number of coroutines are pipelined on one Link,
+ * responses resume the waiting coroutines in FIFO order.
+ */
+class AsyncClient{
+private:
+	friend class Request;
+
+	Link *link;
+	Executor *executor;
+	std::deque<Request *> pending_;
+
+	AsyncClient(Link *link, Executor *executor);
+	void start(Request *req);
+	void fail_all();
+	// No copying allowed
+	AsyncClient(const AsyncClient&);
+	void operator=(const AsyncClient&);
+public:
+	~AsyncClient();
+	static AsyncClient* connect(const char *ip, int port, Executor *executor);
+	static AsyncClient* connect(const std::string &ip, int port, Executor *executor);
+
+	int fd() const{
+		return link->fd();
+	}
+	// true if requests are waiting for responses
+	bool busy() const{
+		return !pending_.empty();
+	}
+	bool want_write() const{
+		return !link->output->empty();
+	}
+	/**
+	 * Called by the executor when the socket is ready.
+	 * @return -1 if the connection is broken, all pending requests fail.
+	 */
+	int on_io(bool readable, bool writable);
+
+	/**
+	 * Generic request, out receives the response without the status code.
+	 */
+	Request request(const std::vector<std::string> &req, std::vector<std::string> *out=NULL);
+
+	Request dbsize(int64_t *ret);
+
+	/// @name KV methods
+	/// @{
+	Request get(const std::string &key, std::string *val);
+	Request set(const std::string &key, const std::string &val);
+	Request setx(const std::string &key, const std::string &val, int ttl);
+	Request del(const std::string &key);
+	Request incr(const std::string &key, int64_t incrby, int64_t *ret);
+	Request keys(const std::string &key_start, const std::string &key_end,
+		uint64_t limit, std::vector<std::string> *ret);
+	Request scan(const std::string &key_start, const std::string &key_end,
+		uint64_t limit, std::vector<std::string> *ret);
+	Request rscan(const std::string &key_start, const std::string &key_end,
+		uint64_t limit, std::vector<std::string> *ret);
+	Request multi_get(const std::vector<std::string> &keys, std::vector<std::string> *ret);
+	Request multi_set(const std::map<std::string, std::string> &kvs);
+	Request multi_del(const std::vector<std::string> &keys);
+	/// @}
+
+	/// @name Map(Hash) methods
+	/// @{
+	Request hget(const std::string &name, const std::string &key, std::string *val);
+	Request hset(const std::string &name, const std::string &key, const std::string &val);
+	Request hdel(const std::string &name, const std::string &key);
+	Request hincr(const std::string &name, const std::string &key, int64_t incrby, int64_t *ret);
+	Request hsize(const std::string &name, int64_t *ret);
+	Request hclear(const std::string &name, int64_t *ret=NULL);
+	Request hkeys(const std::string &name, const std::string &key_start, const std::string &key_end,
+		uint64_t limit, std::vector<std::string> *ret);
+	Request hgetall(const std::string &name, std::vector<std::string> *ret);
+	Request hscan(const std::string &name, const std::string &key_start, const std::string &key_end,
+		uint64_t limit, std::vector<std::string> *ret);
+	Request hrscan(const std::string &name, const std::string &key_start, const std::string &key_end,
+		uint64_t limit, std::vector<std::string> *ret);
+	Request multi_hget(const std::string &name, const std::vector<std::string> &keys,
+		std::vector<std::string> *ret);
+	Request multi_hset(const std::string &name, const std::map<std::string, std::string> &kvs);
+	Request multi_hdel(const std::string &name, const std::vector<std::string> &keys);
+	/// @}
+
+	/// @name Zset methods
+	/// @{
+	Request zget(const std::string &name, const std::string &key, int64_t *ret);
+	Request zset(const std::string &name, const std::string &key, int64_t score);
+	Request zdel(const std::string &name, const std::string &key);
+	Request zincr(const std::string &name, const std::string &key, int64_t incrby, int64_t *ret);
+	Request zsize(const std::string &name, int64_t *ret);
+	Request zclear(const std::string &name, int64_t *ret=NULL);
+	Request zrank(const std::string &name, const std::string &key, int64_t *ret);
+	Request zrrank(const std::string &name, const std::string &key, int64_t *ret);
+	Request zrange(const std::string &name, uint64_t offset, uint64_t limit,
+		std::vector<std::string> *ret);
+	Request zrrange(const std::string &name, uint64_t offset, uint64_t limit,
+		std::vector<std::string> *ret);
+	Request zkeys(const std::string &name, const std::string &key_start,
+		int64_t *score_start, int64_t *score_end,
+		uint64_t limit, std::vector<std::string> *ret);
+	Request zscan(const std::string &name, const std::string &key_start,
+		int64_t *score_start, int64_t *score_end,
+		uint64_t limit, std::vector<std::string> *ret);
+	Request zrscan(const std::string &name, const std::string &key_start,
+		int64_t *score_start, int64_t *score_end,
+		uint64_t limit, std::vector<std::string> *ret);
+	Request multi_zget(const std::string &name, const std::vector<std::string> &keys,
+		std::vector<std::string> *scores);
+	Request multi_zset(const std::string &name, const std::map<std::string, int64_t> &kss);
+	Request multi_zdel(const std::string &name, const std::vector<std::string> &keys);
+	/// @}
+
+	Request qpush(const std::string &name, const std::string &item, int64_t *ret_size=NULL);
+	Request qpush(const std::string &name, const std::vector<std::string> &items, int64_t *ret_size=NULL);
+	Request qpop(const std::string &name, std::string *ret);
+	Request qpop(const std::string &name, int64_t limit, std::vector<std::string> *ret);
+	Request qslice(const std::string &name, int64_t begin, int64_t end, std::vector<std::string> *ret);
+	Request qrange(const std::string &name, int64_t begin, int64_t limit, std::vector<std::string> *ret);
+	Request qclear(const std::string &name, int64_t *ret=NULL);
+};
+
+}; // namespace coro
+}; // namespace ssdb
+
+#endif
+
+#endif
@@ -0,0 +1,384 @@
+#include "SSDB_hedged.h"
+#include "SSDB_reply.h"
+#include "ssdb_strings.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#if !defined(_WIN32)
+	#include <signal.h>
+	#include <sys/select.h>
+#endif
+
+namespace ssdb{
+
+typedef std::chrono::steady_clock Clock;
+
+static int64_t elapsed_us(Clock::time_point since, Clock::time_point now){
+	return std::chrono::duration_cast<std::chrono::microseconds>(now - since).count();
+}
+
+struct HedgedClient::Node{
+	const static int MAX_SAMPLES = 128;
+	// the quantile is not trusted with fewer samples
+	const static int MIN_SAMPLES = 16;
+
+	Link *link;
+	std::string addr;
+	bool failed;
+	// send times of the requests whose replies are not read yet
+	std::deque<Clock::time_point> sent;
+
+	// ring of recent latencies in microseconds
+	int64_t samples[MAX_SAMPLES];
+	int num_samples;
+	int next;
+	int64_t cached;
+	double cached_q;
+	int stale;
+
+	Node(Link *link, const std::string &addr){
+		this->link = link;
+		this->addr = addr;
+		this->failed = false;
+		this->num_samples = 0;
+		this->next = 0;
+		this->cached = -1;
+		this->cached_q = 0;
+		this->stale = 0;
+	}
+
+	// a reply has been read, record how long it took
+	void complete(Clock::time_point now){
+		if(sent.empty()){
+			return;
+		}
+		samples[next] = elapsed_us(sent.front(), now);
+		next = (next + 1) % MAX_SAMPLES;
+		if(num_samples < MAX_SAMPLES){
+			num_samples ++;
+		}
+		stale ++;
+		sent.pop_front();
+	}
+
+	// -1 if there are not enough samples yet
+	int64_t quantile(double q){
+		if(num_samples < MIN_SAMPLES){
+			return -1;
+		}
+		// recomputed every MIN_SAMPLES replies
+		if(cached == -1 || cached_q != q || stale >= MIN_SAMPLES){
+			int64_t tmp[MAX_SAMPLES];
+			memcpy(tmp, samples, num_samples * sizeof(int64_t));
+			int k = (int)(q * (num_samples - 1));
+			std::nth_element(tmp, tmp + k, tmp + num_samples);
+			cached = tmp[k];
+			cached_q = q;
+			stale = 0;
+		}
+		return cached;
+	}
+};
+
+static bool readable(int fd, int timeout_ms){
+	fd_set rfds;
+	FD_ZERO(&rfds);
+	FD_SET(fd, &rfds);
+	struct timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	return ::select(fd + 1, &rfds, NULL, NULL, &tv) > 0;
+}
+
+HedgedClient::HedgedClient(){
+	quantile_ = 0.95;
+	min_delay_us_ = 1000;
+	max_delay_us_ = 50000;
+	max_hedge_ratio_ = 0.1;
+	memset(&stats_, 0, sizeof(stats_));
+}
+
+HedgedClient::~HedgedClient(){
+	for(int i=0; i<(int)nodes_.size(); i++){
+		// the primary's Link is deleted by ClientImpl
+		if(i > 0){
+			delete nodes_[i]->link;
+		}
+		delete nodes_[i];
+	}
+}
+
+HedgedClient* HedgedClient::connect(const char *ip, int port){
+	return HedgedClient::connect(std::string(ip), port);
+}
+
+HedgedClient* HedgedClient::connect(const std::string &ip, int port){
+#if !defined(_WIN32)
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	Link *link = Link::connect(ip.c_str(), port);
+	if(link == NULL){
+		return NULL;
+	}
+	link->nodelay(true);
+	HedgedClient *client = new HedgedClient();
+	client->link = link;
+	client->nodes_.push_back(new Node(link, ip + ":" + str(port)));
+	return client;
+}
+
+bool HedgedClient::add_replica(const std::string &ip, int port){
+	Link *link = Link::connect(ip.c_str(), port);
+	if(link == NULL){
+		return false;
+	}
+	link->nodelay(true);
+	nodes_.push_back(new Node(link, ip + ":" + str(port)));
+	return true;
+}
+
+void HedgedClient::hedge_delay(double quantile, int min_us, int max_us){
+	quantile_ = (quantile > 0 && quantile <= 1)? quantile : 0.95;
+	min_delay_us_ = min_us > 0? min_us : 0;
+	max_delay_us_ = max_us > min_delay_us_? max_us : min_delay_us_;
+}
+
+int64_t HedgedClient::hedge_delay(Node *node){
+	int64_t us = node->quantile(quantile_);
+	if(us < 0 || us > max_delay_us_){
+		return max_delay_us_;
+	}
+	return us < min_delay_us_? min_delay_us_ : us;
+}
+
+void HedgedClient::fail(Node *node){
+	node->link->mark_error();
+	node->failed = true;
+	node->sent.clear();
+}
+
+// read and throw away the replies of abandoned requests,
+// return false if the node failed
+bool HedgedClient::drain(Node *node, bool block){
+	while(!node->failed && !node->sent.empty()){
+		const std::vector<Bytes> *packet = node->link->recv();
+		if(packet == NULL){
+			this->fail(node);
+			break;
+		}
+		if(!packet->empty()){
+			node->complete(Clock::now());
+			stats_.discarded ++;
+			continue;
+		}
+		if(!block && !readable(node->link->fd(), 0)){
+			break;
+		}
+		if(node->link->read() <= 0){
+			this->fail(node);
+		}
+	}
+	return !node->failed;
+}
+
+// the idle node with the lowest latency, other than exclude
+HedgedClient::Node* HedgedClient::pick_replica(Node *exclude){
+	Node *ret = NULL;
+	int64_t best = 0;
+	for(int i=0; i<(int)nodes_.size(); i++){
+		Node *node = nodes_[i];
+		if(node == exclude || !this->drain(node, false) || !node->sent.empty()){
+			continue;
+		}
+		int64_t us = node->quantile(quantile_);
+		if(us < 0){
+			us = max_delay_us_;
+		}
+		if(ret == NULL || us < best){
+			ret = node;
+			best = us;
+		}
+	}
+	return ret;
+}
+
+bool HedgedClient::send(Node *node, const std::vector<std::string> &req){
+	if(node->link->send(req) == -1 || node->link->flush() == -1){
+		this->fail(node);
+		return false;
+	}
+	node->sent.push_back(Clock::now());
+	return true;
+}
+
+/**
+ * wait for a reply on any of nodes, at most timeout_us, -1 for no limit.
+ * return the index of the node whose reply is in link->last_recv(),
+ * -1 on timeout, -2 if every node failed.
+ */
+int HedgedClient::wait(Node **nodes, int num, int64_t timeout_us){
+	Clock::time_point deadline = Clock::now() + std::chrono::microseconds(timeout_us);
+	while(1){
+		fd_set rfds;
+		FD_ZERO(&rfds);
+		int max_fd = -1;
+		for(int i=0; i<num; i++){
+			Node *node = nodes[i];
+			if(node->failed){
+				continue;
+			}
+			const std::vector<Bytes> *packet = node->link->recv();
+			if(packet == NULL){
+				this->fail(node);
+				continue;
+			}
+			if(!packet->empty()){
+				node->complete(Clock::now());
+				return i;
+			}
+			FD_SET(node->link->fd(), &rfds);
+			max_fd = std::max(max_fd, node->link->fd());
+		}
+		if(max_fd == -1){
+			return -2;
+		}
+
+		struct timeval tv;
+		struct timeval *ptv = NULL;
+		if(timeout_us >= 0){
+			int64_t us = elapsed_us(Clock::now(), deadline);
+			if(us <= 0){
+				return -1;
+			}
+			tv.tv_sec = (long)(us / 1000000);
+			tv.tv_usec = (long)(us % 1000000);
+			ptv = &tv;
+		}
+		int ret = ::select(max_fd + 1, &rfds, NULL, NULL, ptv);
+		if(ret == -1){
+			if(errno == EINTR){
+				continue;
+			}
+			return -2;
+		}
+		for(int i=0; i<num; i++){
+			Node *node = nodes[i];
+			if(!node->failed && FD_ISSET(node->link->fd(), &rfds)){
+				if(node->link->read() <= 0){
+					this->fail(node);
+				}
+			}
+		}
+	}
+	return -2;
+}
+
+const std::vector<std::string>* HedgedClient::hedged_request(const std::vector<std::string> &req){
+	stats_.reads ++;
+	Node *active[2];
+	int num = 0;
+
+	// a primary still busy with an abandoned reply is skipped if a replica is idle
+	Node *first = nodes_[0];
+	if(!this->drain(first, false) || !first->sent.empty()){
+		Node *node = this->pick_replica(first);
+		if(node){
+			first = node;
+		}else if(!this->drain(first, true)){
+			return NULL;
+		}
+	}
+	if(this->send(first, req)){
+		active[num++] = first;
+	}
+
+	int idx = -2;
+	if(num > 0){
+		bool may_hedge = nodes_.size() > 1 && stats_.hedged < max_hedge_ratio_ * stats_.reads;
+		idx = this->wait(active, num, may_hedge? this->hedge_delay(first) : -1);
+		if(idx == -1){
+			Node *node = this->pick_replica(first);
+			if(node && this->send(node, req)){
+				active[num++] = node;
+				stats_.hedged ++;
+			}
+			idx = this->wait(active, num, -1);
+		}
+	}
+	if(idx == -2){
+		// every node asked so far failed, try one more
+		Node *node = this->pick_replica(first);
+		if(node == NULL || !this->send(node, req)){
+			return NULL;
+		}
+		num = 0;
+		active[num++] = node;
+		idx = this->wait(active, num, -1);
+		if(idx < 0){
+			return NULL;
+		}
+		stats_.failovers ++;
+	}else if(idx > 0){
+		stats_.hedge_wins ++;
+	}
+
+	const std::vector<Bytes> *packet = active[idx]->link->last_recv();
+	resp_.clear();
+	for(std::vector<Bytes>::const_iterator it=packet->begin(); it!=packet->end(); it++){
+		resp_.push_back(it->String());
+	}
+	// the loser's reply is drained before its next request
+	return &resp_;
+}
+
+const std::vector<std::string>* HedgedClient::request(const std::vector<std::string> &req){
+	if(!req.empty() && _is_read_command(req[0])){
+		return this->hedged_request(req);
+	}
+	if(!this->drain(nodes_[0], true)){
+		return NULL;
+	}
+	return ClientImpl::request(req);
+}
+
+Status HedgedClient::request_stream(const std::vector<std::string> &req, ReplyHandler *handler){
+	if(!this->drain(nodes_[0], true)){
+		return Status("error");
+	}
+	return ClientImpl::request_stream(req, handler);
+}
+
+Status HedgedClient::request_stream(const Slice *head, int head_num,
+	const Slice *args, int num, ReplyHandler *handler)
+{
+	if(!this->drain(nodes_[0], true)){
+		return Status("error");
+	}
+	return ClientImpl::request_stream(head, head_num, args, num, handler);
+}
+
+HedgeStats HedgedClient::get_stats() const{
+	return stats_;
+}
+
+std::string HedgedClient::stats(){
+	char buf[256];
+	double load = stats_.reads? 100.0 * stats_.hedged / stats_.reads : 0;
+	snprintf(buf, sizeof(buf),
+		"reads: %" PRId64 ", hedged: %" PRId64 " (+%.1f%% load), hedge_wins: %" PRId64
+		", discarded: %" PRId64 ", failovers: %" PRId64,
+		stats_.reads, stats_.hedged, load, stats_.hedge_wins, stats_.discarded, stats_.failovers);
+	std::string ret(buf);
+	for(int i=0; i<(int)nodes_.size(); i++){
+		Node *node = nodes_[i];
+		int64_t us = node->quantile(quantile_);
+		snprintf(buf, sizeof(buf), "\n%s: p%d %s, pending: %d%s",
+			node->addr.c_str(), (int)(quantile_ * 100 + 0.5),
+			us < 0? "-" : (str(us) + "us").c_str(),
+			(int)node->sent.size(), node->failed? ", failed" : "");
+		ret.append(buf);
+	}
+	return ret;
+}
+
+}; // namespace ssdb
@@ -0,0 +1,98 @@
+#ifndef SSDB_API_HEDGED_CPP
+#define SSDB_API_HEDGED_CPP
+
+#include <string>
+#include <vector>
+#include "SSDB_impl.h"
+
+namespace ssdb{
+
+struct HedgeStats{
+	int64_t reads;      // requests eligible for hedging
+	int64_t hedged;     // duplicate requests sent, the extra load
+	int64_t hedge_wins; // reads answered by the duplicate first
+	int64_t discarded;  // replies of the losers, read and thrown away
+	int64_t failovers;  // reads whose first node failed, answered by another
+};
+
+/**
+ * A client reading from a primary and its replicas, which hedges slow reads.
+ *
+ * Writes and any command not known to be a read go to the primary. A read
+ * (get, hget, exists, multi_get, zget, ...) is sent to the primary first,
+ * if no reply arrived after its recent latency quantile, the same read is
+ * sent to the fastest idle replica, and the first reply wins. The loser's
+ * reply is drained from its Link before that Link is used again.
+ *
+ * Hedging stops once duplicates exceed max_hedge_ratio() of the reads, so
+ * a cluster-wide slowdown does not double the load. Replicas may lag, a
+ * hedged read can return older data than the primary holds.
+ *
+ * A read whose node fails is retried once on an idle node. A failed node
+ * is not used again, writes fail once the primary has failed.
+ *
+ * Streaming requests (request_stream() and the Slice methods) are not
+ * hedged, they go to the primary.
+ */
+class HedgedClient : public ClientImpl{
+private:
+	struct Node;
+
+	// nodes_[0] is the primary, its Link is also ClientImpl::link
+	std::vector<Node *> nodes_;
+	double quantile_;
+	int min_delay_us_;
+	int max_delay_us_;
+	double max_hedge_ratio_;
+	HedgeStats stats_;
+
+	HedgedClient();
+	int64_t hedge_delay(Node *node);
+	Node* pick_replica(Node *exclude);
+	bool send(Node *node, const std::vector<std::string> &req);
+	int wait(Node **nodes, int num, int64_t timeout_us);
+	bool drain(Node *node, bool block);
+	void fail(Node *node);
+	const std::vector<std::string>* hedged_request(const std::vector<std::string> &req);
+public:
+	~HedgedClient();
+
+	static HedgedClient* connect(const char *ip, int port);
+	static HedgedClient* connect(const std::string &ip, int port);
+
+	/**
+	 * Add a replica to hedge reads to.
+	 * @return false if it can not be connected.
+	 */
+	bool add_replica(const std::string &ip, int port);
+
+	/**
+	 * Hedge once a read has been waiting longer than this quantile of the
+	 * node's recent latencies, clamped to [min_us, max_us]. Until enough
+	 * samples are seen, max_us is used. Default 0.95, 1ms, 50ms.
+	 */
+	void hedge_delay(double quantile, int min_us, int max_us);
+	/**
+	 * At most this share of reads is duplicated. Default 0.1.
+	 */
+	void max_hedge_ratio(double ratio){
+		max_hedge_ratio_ = ratio > 0? ratio : 0;
+	}
+
+	HedgeStats get_stats() const;
+	/**
+	 * The counters, the extra load, and the latency quantile of every node.
+	 */
+	std::string stats();
+
+	using ClientImpl::request;
+	virtual const std::vector<std::string>* request(const std::vector<std::string> &req);
+	using ClientImpl::request_stream;
+	virtual Status request_stream(const std::vector<std::string> &req, ReplyHandler *handler);
+	virtual Status request_stream(const Slice *head, int head_num,
+		const Slice *args, int num, ReplyHandler *handler);
+};
+
+}; // namespace ssdb
+
+#endif
@@ -1,4 +1,5 @@
 #include "SSDB_impl.h"
+#include "SSDB_reply.h"
 #include "ssdb_strings.h"
 #if !defined(_WIN32)
 	#include <signal.h>
@@ -6,46 +7,6 @@
 
 namespace ssdb{
 
-inline static
-Status _read_list(const std::vector<std::string> *resp, std::vector<std::string> *ret){
-	Status s(resp);
-	if(s.ok()){
-		std::vector<std::string>::const_iterator it;
-		for(it = resp->begin() + 1; it != resp->end(); it++){
-			ret->push_back(*it);
-		}
-	}
-	return s;
-}
-
-inline static
-Status _read_int64(const std::vector<std::string> *resp, int64_t *ret){
-	Status s(resp);
-	if(s.ok()){
-		if(resp->size() >= 2){
-			if(ret){
-				*ret = str_to_int64(resp->at(1));
-			}
-		}else{
-			return Status("server_error");
-		}
-	}
-	return s;
-}
-
-inline static
-Status _read_str(const std::vector<std::string> *resp, std::string *ret){
-	Status s(resp);
-	if(s.ok()){
-		if(resp->size() >= 2){
-			*ret = resp->at(1);
-		}else{
-			return Status("server_error");
-		}
-	}
-	return s;
-}
-
 ClientImpl::ClientImpl(){
 	link = NULL;
 }
@@ -77,15 +38,22 @@ Client* Client::connect(const std::string &ip, int port){
 	return client;
 }
 
-const std::vector<std::string>* ClientImpl::request(const std::vector<std::string> &req){
-	if(link->send(req) == -1){
-		return NULL;
+Client* Client::connect(const std::string &ip, int port, Protocol protocol){
+	ClientImpl *client = (ClientImpl *)Client::connect(ip, port);
+	if(client && protocol == PROTOCOL_RESP){
+		client->link->codec(RespCodec());
 	}
-	if(link->flush() == -1){
+	return client;
+}
+
+const std::vector<std::string>* ClientImpl::request(const std::vector<std::string> &req){
+	if(link->send(req) == -1 || link->flush() == -1){
+		link->mark_error();
 		return NULL;
 	}
 	const std::vector<Bytes> *packet = link->response();
 	if(packet == NULL){
+		link->mark_error();
 		return NULL;
 	}
 	resp_.clear();
@@ -598,4 +566,363 @@ Status ClientImpl::qclear(const std::string &name, int64_t *ret){
 	return _read_int64(resp, ret);
 }
 
+// fallback for clients without direct access to a Link, the reply is buffered
+Status Client::request_stream(const std::vector<std::string> &req, ReplyHandler *handler){
+	const std::vector<std::string> *resp = this->request(req);
+	Status s(resp);
+	if(s.ok()){
+		for(int i=1; i<(int)resp->size(); i++){
+			const std::string &item = resp->at(i);
+			if(handler->item(item.data(), (int)item.size()) == -1){
+				break;
+			}
+		}
+	}
+	return s;
+}
+
+Status Client::scan_stream(const std::string &key_start, const std::string &key_end,
+	uint64_t limit, ReplyHandler *handler)
+{
+	std::vector<std::string> req;
+	req.push_back("scan");
+	req.push_back(key_start);
+	req.push_back(key_end);
+	req.push_back(str(limit));
+	return this->request_stream(req, handler);
+}
+
+Status Client::hgetall_stream(const std::string &name, ReplyHandler *handler){
+	std::vector<std::string> req;
+	req.push_back("hgetall");
+	req.push_back(name);
+	return this->request_stream(req, handler);
+}
+
+Status Client::hscan_stream(const std::string &name,
+	const std::string &key_start, const std::string &key_end,
+	uint64_t limit, ReplyHandler *handler)
+{
+	std::vector<std::string> req;
+	req.push_back("hscan");
+	req.push_back(name);
+	req.push_back(key_start);
+	req.push_back(key_end);
+	req.push_back(str(limit));
+	return this->request_stream(req, handler);
+}
+
+Status Client::qslice_stream(const std::string &name, int64_t begin, int64_t end, ReplyHandler *handler){
+	std::vector<std::string> req;
+	req.push_back("qslice");
+	req.push_back(name);
+	req.push_back(str(begin));
+	req.push_back(str(end));
+	return this->request_stream(req, handler);
+}
+
+// takes the status code, forwards the items of an ok reply
+class StreamAdapter : public FieldHandler{
+public:
+	ReplyHandler *handler;
+	std::string code;
+
+	virtual int field(int index, const Bytes &data){
+		if(index == 0){
+			code = data.String();
+			return code == "ok"? 0 : -1;
+		}
+		return handler->item(data.data(), data.size());
+	}
+};
+
+// flush the request queued on link, stream its reply to handler
+static Status stream_reply(Link *link, ReplyHandler *handler){
+	if(link->flush() == -1){
+		link->mark_error();
+		return Status("error");
+	}
+	StreamAdapter adapter;
+	adapter.handler = handler;
+	if(link->response_stream(&adapter) == -1){
+		link->mark_error();
+		return Status("error");
+	}
+	return Status(adapter.code);
+}
+
+Status ClientImpl::request_stream(const std::vector<std::string> &req, ReplyHandler *handler){
+	if(link->send(req) == -1){
+		link->mark_error();
+		return Status("error");
+	}
+	return stream_reply(link, handler);
+}
+
+Status ClientImpl::request_stream(const Slice *head, int head_num,
+	const Slice *args, int num, ReplyHandler *handler)
+{
+	args_.clear();
+	for(int i=0; i<head_num; i++){
+		args_.push_back(Bytes(head[i].data, head[i].size));
+	}
+	for(int i=0; i<num; i++){
+		args_.push_back(Bytes(args[i].data, args[i].size));
+	}
+	if(link->send(args_) == -1){
+		link->mark_error();
+		return Status("error");
+	}
+	return stream_reply(link, handler);
+}
+
+/******************** Slice methods *************************/
+
+// fallback for clients without direct access to a Link
+Status Client::request_stream(const Slice *head, int head_num,
+	const Slice *args, int num, ReplyHandler *handler)
+{
+	std::vector<std::string> req;
+	req.reserve(head_num + num);
+	for(int i=0; i<head_num; i++){
+		req.push_back(std::string(head[i].data, head[i].size));
+	}
+	for(int i=0; i<num; i++){
+		req.push_back(std::string(args[i].data, args[i].size));
+	}
+	return this->request_stream(req, handler);
+}
+
+// for replies that carry nothing but the status
+class DiscardHandler : public ReplyHandler{
+public:
+	virtual int item(const char *, int){
+		return -1;
+	}
+};
+
+// copies the single item of a reply into a caller buffer
+class CopyHandler : public ReplyHandler{
+public:
+	char *buf;
+	int size;
+	int *len;
+	int count;
+
+	CopyHandler(char *buf, int size, int *len){
+		this->buf = buf;
+		this->size = size;
+		this->len = len;
+		this->count = 0;
+	}
+	virtual int item(const char *data, int size){
+		if(count++ == 0){
+			*len = size;
+			memcpy(buf, data, size < this->size? size : this->size);
+		}
+		return 0;
+	}
+};
+
+static inline Slice literal(const char *s){
+	return Slice(s, (int)strlen(s));
+}
+
+static Status read_copy(Status s, const CopyHandler &handler){
+	if(s.ok() && handler.count != 1){
+		return Status("server_error");
+	}
+	return s;
+}
+
+Status Client::get(const Slice &key, char *buf, int size, int *len){
+	Slice req[] = {literal("get"), key};
+	CopyHandler handler(buf, size, len);
+	return read_copy(this->request_stream(req, 2, &handler), handler);
+}
+
+Status Client::set(const Slice &key, const Slice &val){
+	Slice req[] = {literal("set"), key, val};
+	DiscardHandler handler;
+	return this->request_stream(req, 3, &handler);
+}
+
+Status Client::setx(const Slice &key, const Slice &val, int ttl){
+	char buf[21];
+	Slice req[] = {literal("setx"), key, val, Slice(buf, int64_to_str(buf, ttl))};
+	DiscardHandler handler;
+	return this->request_stream(req, 4, &handler);
+}
+
+Status Client::del(const Slice &key){
+	Slice req[] = {literal("del"), key};
+	DiscardHandler handler;
+	return this->request_stream(req, 2, &handler);
+}
+
+Status Client::multi_get(const Slice *keys, int num, ReplyHandler *handler){
+	Slice head[] = {literal("multi_get")};
+	return this->request_stream(head, 1, keys, num, handler);
+}
+
+Status Client::multi_set(const Slice *kvs, int num){
+	Slice head[] = {literal("multi_set")};
+	DiscardHandler handler;
+	return this->request_stream(head, 1, kvs, num, &handler);
+}
+
+Status Client::multi_del(const Slice *keys, int num){
+	Slice head[] = {literal("multi_del")};
+	DiscardHandler handler;
+	return this->request_stream(head, 1, keys, num, &handler);
+}
+
+Status Client::hget(const Slice &name, const Slice &key, char *buf, int size, int *len){
+	Slice req[] = {literal("hget"), name, key};
+	CopyHandler handler(buf, size, len);
+	return read_copy(this->request_stream(req, 3, &handler), handler);
+}
+
+Status Client::hset(const Slice &name, const Slice &key, const Slice &val){
+	Slice req[] = {literal("hset"), name, key, val};
+	DiscardHandler handler;
+	return this->request_stream(req, 4, &handler);
+}
+
+Status Client::hdel(const Slice &name, const Slice &key){
+	Slice req[] = {literal("hdel"), name, key};
+	DiscardHandler handler;
+	return this->request_stream(req, 3, &handler);
+}
+
+Status Client::multi_hset(const Slice &name, const Slice *kvs, int num){
+	Slice head[] = {literal("multi_hset"), name};
+	DiscardHandler handler;
+	return this->request_stream(head, 2, kvs, num, &handler);
+}
+
+/******************** ResultArena methods *************************/
+
+// the request is cmd, the Slices in head, then keys
+static Status request_keys(Client *client, const Slice *head, int head_num,
+	const std::vector<std::string> &keys, ResultArena *ret)
+{
+	std::vector<Slice> args(keys.begin(), keys.end());
+	ret->clear();
+	return client->request_stream(head, head_num, args.empty()? NULL : &args[0], (int)args.size(), ret);
+}
+
+// command with bounds and a limit, the common shape of the scans
+static Status request_range(Client *client, const char *cmd, const std::string *name,
+	const std::string &key_start, const std::string &key_end,
+	uint64_t limit, ResultArena *ret)
+{
+	char buf[21];
+	Slice req[5];
+	int num = 0;
+	req[num++] = literal(cmd);
+	if(name){
+		req[num++] = *name;
+	}
+	req[num++] = key_start;
+	req[num++] = key_end;
+	req[num++] = Slice(buf, uint64_to_str(buf, limit));
+	ret->clear();
+	return client->request_stream(req, num, ret);
+}
+
+static Status request_zrange(Client *client, const char *cmd, const std::string &name,
+	uint64_t offset, uint64_t limit, ResultArena *ret)
+{
+	char buf1[21], buf2[21];
+	Slice req[] = {
+		literal(cmd), name,
+		Slice(buf1, uint64_to_str(buf1, offset)),
+		Slice(buf2, uint64_to_str(buf2, limit))
+	};
+	ret->clear();
+	return client->request_stream(req, 4, ret);
+}
+
+static Status request_zscan(Client *client, const char *cmd, const std::string &name,
+	const std::string &key_start, int64_t *score_start, int64_t *score_end,
+	uint64_t limit, ResultArena *ret)
+{
+	char buf1[21], buf2[21], buf3[21];
+	Slice req[] = {
+		literal(cmd), name, key_start,
+		Slice(buf1, score_start? int64_to_str(buf1, *score_start) : 0),
+		Slice(buf2, score_end? int64_to_str(buf2, *score_end) : 0),
+		Slice(buf3, uint64_to_str(buf3, limit))
+	};
+	ret->clear();
+	return client->request_stream(req, 6, ret);
+}
+
+Status Client::scan(const std::string &key_start, const std::string &key_end,
+	uint64_t limit, ResultArena *ret)
+{
+	return request_range(this, "scan", NULL, key_start, key_end, limit, ret);
+}
+
+Status Client::rscan(const std::string &key_start, const std::string &key_end,
+	uint64_t limit, ResultArena *ret)
+{
+	return request_range(this, "rscan", NULL, key_start, key_end, limit, ret);
+}
+
+Status Client::multi_get(const std::vector<std::string> &keys, ResultArena *ret){
+	Slice head[] = {literal("multi_get")};
+	return request_keys(this, head, 1, keys, ret);
+}
+
+Status Client::hgetall(const std::string &name, ResultArena *ret){
+	Slice req[] = {literal("hgetall"), name};
+	ret->clear();
+	return this->request_stream(req, 2, ret);
+}
+
+Status Client::hscan(const std::string &name,
+	const std::string &key_start, const std::string &key_end,
+	uint64_t limit, ResultArena *ret)
+{
+	return request_range(this, "hscan", &name, key_start, key_end, limit, ret);
+}
+
+Status Client::hrscan(const std::string &name,
+	const std::string &key_start, const std::string &key_end,
+	uint64_t limit, ResultArena *ret)
+{
+	return request_range(this, "hrscan", &name, key_start, key_end, limit, ret);
+}
+
+Status Client::multi_hget(const std::string &name, const std::vector<std::string> &keys,
+	ResultArena *ret)
+{
+	Slice head[] = {literal("multi_hget"), name};
+	return request_keys(this, head, 2, keys, ret);
+}
+
+Status Client::zrange(const std::string &name, uint64_t offset, uint64_t limit, ResultArena *ret){
+	return request_zrange(this, "zrange", name, offset, limit, ret);
+}
+
+Status Client::zrrange(const std::string &name, uint64_t offset, uint64_t limit, ResultArena *ret){
+	return request_zrange(this, "zrrange", name, offset, limit, ret);
+}
+
+Status Client::zscan(const std::string &name, const std::string &key_start,
+	int64_t *score_start, int64_t *score_end,
+	uint64_t limit, ResultArena *ret)
+{
+	return request_zscan(this, "zscan", name, key_start, score_start, score_end, limit, ret);
+}
+
+Status Client::zrscan(const std::string &name, const std::string &key_start,
+	int64_t *score_start, int64_t *score_end,
+	uint64_t limit, ResultArena *ret)
+{
+	return request_zscan(this, "zrscan", name, key_start, score_start, score_end, limit, ret);
+}
+
 }; // namespace ssdb
@@ -7,15 +7,21 @@
 namespace ssdb{
 
 class ClientImpl : public Client{
-private:
+protected:
 	friend class Client;
 	
 	Link *link;
 	std::vector<std::string> resp_;
+	std::vector<Bytes> args_;
 public:
 	ClientImpl();
 	~ClientImpl();
 
+	// the connection failed, every further request will fail
+	bool broken() const{
+		return link == NULL || link->error();
+	}
+
 	virtual const std::vector<std::string>* request(const std::vector<std::string> &req);
 	virtual const std::vector<std::string>* request(const std::string &cmd);
 	virtual const std::vector<std::string>* request(const std::string &cmd, const std::string &s2);
@@ -98,6 +104,33 @@ public:
 	virtual Status qslice(const std::string &name, int64_t begin, int64_t end, std::vector<std::string> *ret);
 	virtual Status qrange(const std::string &name, int64_t begin, int64_t limit, std::vector<std::string> *ret);
 	virtual Status qclear(const std::string &name, int64_t *ret=NULL);
+
+	using Client::request_stream;
+	virtual Status request_stream(const std::vector<std::string> &req, ReplyHandler *handler);
+	virtual Status request_stream(const Slice *head, int head_num,
+		const Slice *args, int num, ReplyHandler *handler);
+
+	using Client::get;
+	using Client::set;
+	using Client::setx;
+	using Client::del;
+	using Client::multi_get;
+	using Client::multi_set;
+	using Client::multi_del;
+	using Client::hget;
+	using Client::hset;
+	using Client::hdel;
+	using Client::multi_hset;
+	using Client::scan;
+	using Client::rscan;
+	using Client::hgetall;
+	using Client::hscan;
+	using Client::hrscan;
+	using Client::multi_hget;
+	using Client::zrange;
+	using Client::zrrange;
+	using Client::zscan;
+	using Client::zrscan;
 };
 
 }; // namespace ssdb
@@ -0,0 +1,220 @@
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+
+#include "SSDB_memory.h"
+#include "ssdb_strings.h"
+#include <stdio.h>
+#include <map>
+#if !defined(_WIN32)
+	#include <signal.h>
+#endif
+
+namespace ssdb{
+
+InMemoryClient::InMemoryClient(MemoryStore *store){
+	own_store_ = (store == NULL);
+	store_ = own_store_? new MemoryStore() : store;
+	cache_ttl_ = 60;
+	hits_ = 0;
+	misses_ = 0;
+}
+
+InMemoryClient::~InMemoryClient(){
+	if(own_store_){
+		delete store_;
+	}
+}
+
+InMemoryClient* InMemoryClient::create(MemoryStore *store){
+	return new InMemoryClient(store);
+}
+
+InMemoryClient* InMemoryClient::connect(const char *ip, int port, MemoryStore *store){
+	return InMemoryClient::connect(std::string(ip), port, store);
+}
+
+InMemoryClient* InMemoryClient::connect(const std::string &ip, int port, MemoryStore *store){
+#if !defined(_WIN32)
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	Link *link = Link::connect(ip.c_str(), port);
+	if(link == NULL){
+		return NULL;
+	}
+	InMemoryClient *client = new InMemoryClient(store);
+	client->link = link;
+	return client;
+}
+
+std::string InMemoryClient::stats() const{
+	char buf[128];
+	snprintf(buf, sizeof(buf), "hits: %" PRId64 ", misses: %" PRId64, hits_, misses_);
+	return buf;
+}
+
+// run req_ on the store
+void InMemoryClient::execute(std::vector<std::string> *resp){
+	store_->execute(req_.empty()? NULL : &req_[0], (int)req_.size(), resp);
+}
+
+void InMemoryClient::cache(const std::string &key, const std::string &val){
+	std::string ttl = str(cache_ttl_);
+	req_.clear();
+	req_.push_back(Bytes(cache_ttl_? "setx" : "set"));
+	req_.push_back(Bytes(key));
+	req_.push_back(Bytes(val));
+	if(cache_ttl_){
+		req_.push_back(Bytes(ttl));
+	}
+	this->execute(&scratch_);
+}
+
+// drop the keys a kv write in req_ changes on the server
+void InMemoryClient::invalidate(){
+	static const char *writes[] = {
+		"set", "setx", "setnx", "getset", "del", "incr", "decr", "expire",
+	};
+	const Bytes &cmd = req_[0];
+	if(cmd == Bytes("flushdb")){
+		store_->clear();
+		return;
+	}
+	int first = 0;
+	int step = 1;
+	if(cmd == Bytes("multi_set")){
+		first = 1;
+		step = 2;
+	}else if(cmd == Bytes("multi_del")){
+		first = 1;
+	}else{
+		for(int i=0; i<(int)(sizeof(writes)/sizeof(writes[0])); i++){
+			if(cmd == Bytes(writes[i]) && req_.size() > 1){
+				req_.resize(2);
+				first = 1;
+				break;
+			}
+		}
+	}
+	if(first == 0){
+		return;
+	}
+	// multi_del of the keys, in place of the request
+	int num = 1;
+	for(int i=first; i<(int)req_.size(); i+=step){
+		req_[num++] = req_[i];
+	}
+	req_.resize(num);
+	req_[0] = Bytes("multi_del");
+	this->execute(&scratch_);
+}
+
+const std::vector<std::string>* InMemoryClient::read_get(const std::vector<std::string> &req){
+	this->execute(&resp_);
+	if(resp_[0] != "not_found"){
+		hits_ ++;
+		return &resp_;
+	}
+	misses_ ++;
+	const std::vector<std::string> *resp = ClientImpl::request(req);
+	if(resp && resp->size() >= 2 && resp->at(0) == "ok"){
+		this->cache(req[1], resp->at(1));
+	}
+	return resp;
+}
+
+const std::vector<std::string>* InMemoryClient::read_multi_get(const std::vector<std::string> &req){
+	std::map<std::string, std::string> found;
+	this->execute(&scratch_);
+	for(int i=1; i+1<(int)scratch_.size(); i+=2){
+		found[scratch_[i]].swap(scratch_[i+1]);
+	}
+	hits_ += found.size();
+
+	std::vector<std::string> missing;
+	missing.push_back("multi_get");
+	for(int i=1; i<(int)req.size(); i++){
+		if(found.find(req[i]) == found.end()){
+			missing.push_back(req[i]);
+		}
+	}
+	if(missing.size() > 1){
+		misses_ += missing.size() - 1;
+		const std::vector<std::string> *resp = ClientImpl::request(missing);
+		if(resp == NULL || resp->empty() || resp->at(0) != "ok"){
+			return resp;
+		}
+		for(int i=1; i+1<(int)resp->size(); i+=2){
+			found[resp->at(i)] = resp->at(i+1);
+		}
+		for(int i=1; i<(int)missing.size(); i++){
+			std::map<std::string, std::string>::const_iterator it = found.find(missing[i]);
+			if(it != found.end()){
+				this->cache(it->first, it->second);
+			}
+		}
+	}
+
+	// the keys found, in the order asked for, as the server replies
+	resp_.clear();
+	resp_.push_back("ok");
+	for(int i=1; i<(int)req.size(); i++){
+		std::map<std::string, std::string>::const_iterator it = found.find(req[i]);
+		if(it != found.end()){
+			resp_.push_back(it->first);
+			resp_.push_back(it->second);
+		}
+	}
+	return &resp_;
+}
+
+const std::vector<std::string>* InMemoryClient::request(const std::vector<std::string> &req){
+	req_.clear();
+	for(int i=0; i<(int)req.size(); i++){
+		req_.push_back(Bytes(req[i]));
+	}
+	if(link == NULL){
+		this->execute(&resp_);
+		return &resp_;
+	}
+	if(req.size() == 2 && req[0] == "get"){
+		return this->read_get(req);
+	}
+	if(req.size() > 1 && req[0] == "multi_get"){
+		return this->read_multi_get(req);
+	}
+	const std::vector<std::string> *resp = ClientImpl::request(req);
+	if(!req_.empty()){
+		this->invalidate();
+	}
+	return resp;
+}
+
+Status InMemoryClient::request_stream(const Slice *head, int head_num,
+	const Slice *args, int num, ReplyHandler *handler)
+{
+	if(link != NULL){
+		return Client::request_stream(head, head_num, args, num, handler);
+	}
+	// no std::string copies of the arguments
+	req_.clear();
+	for(int i=0; i<head_num; i++){
+		req_.push_back(Bytes(head[i].data, head[i].size));
+	}
+	for(int i=0; i<num; i++){
+		req_.push_back(Bytes(args[i].data, args[i].size));
+	}
+	this->execute(&resp_);
+	Status s(&resp_);
+	if(s.ok()){
+		for(int i=1; i<(int)resp_.size(); i++){
+			const std::string &item = resp_[i];
+			if(handler->item(item.data(), (int)item.size()) == -1){
+				break;
+			}
+		}
+	}
+	return s;
+}
+
+}; // namespace ssdb
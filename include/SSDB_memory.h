@@ -0,0 +1,87 @@
+#ifndef SSDB_API_MEMORY_CPP
+#define SSDB_API_MEMORY_CPP
+
+#include <string>
+#include <vector>
+#include "SSDB_impl.h"
+#include "memory_store.h"
+
+namespace ssdb{
+
+/**
+ * A client whose data lives in process memory, in a MemoryStore, with no
+ * server. Every Client method works and replies as an SSDB server would,
+ * so tests and benchmarks written against Client run unchanged.
+ *
+ * A client made by create() is the only copy of its data. One made by
+ * connect() is a read-through tier in front of a server: get and
+ * multi_get are answered from memory when they can, keys missing are
+ * fetched from the server and kept for cache_ttl() seconds. Every other
+ * command goes to the server, kv writes (set, setx, del, incr,
+ * multi_set, ...) also drop their keys from memory. Writes by other
+ * clients are seen once the copy expires.
+ *
+ * Clients may share a store, from many threads, each thread with its own
+ * client, see MemoryStore.
+ */
+class InMemoryClient : public ClientImpl{
+private:
+	MemoryStore *store_;
+	bool own_store_;
+	int cache_ttl_;
+	int64_t hits_;
+	int64_t misses_;
+	std::vector<Bytes> req_;
+	std::vector<std::string> scratch_;
+
+	InMemoryClient(MemoryStore *store);
+	void execute(std::vector<std::string> *resp);
+	void cache(const std::string &key, const std::string &val);
+	void invalidate();
+	const std::vector<std::string>* read_get(const std::vector<std::string> &req);
+	const std::vector<std::string>* read_multi_get(const std::vector<std::string> &req);
+public:
+	~InMemoryClient();
+
+	/**
+	 * A client on store, which must outlive it, or on a store of its own
+	 * if store is NULL.
+	 */
+	static InMemoryClient* create(MemoryStore *store=NULL);
+	/**
+	 * A read-through client in front of the server at ip:port.
+	 */
+	static InMemoryClient* connect(const char *ip, int port, MemoryStore *store=NULL);
+	static InMemoryClient* connect(const std::string &ip, int port, MemoryStore *store=NULL);
+
+	MemoryStore* store() const{
+		return store_;
+	}
+	/**
+	 * Seconds a value fetched from the server is kept, 0 to keep it until
+	 * it is written through this client. Default 60.
+	 */
+	void cache_ttl(int seconds){
+		cache_ttl_ = seconds >= 0? seconds : 0;
+	}
+
+	/**
+	 * Reads answered from memory and fetched from the server, of a
+	 * read-through client.
+	 */
+	std::string stats() const;
+
+	using ClientImpl::request;
+	virtual const std::vector<std::string>* request(const std::vector<std::string> &req);
+	// replies are built in memory, there is nothing to stream
+	using ClientImpl::request_stream;
+	virtual Status request_stream(const std::vector<std::string> &req, ReplyHandler *handler){
+		return Client::request_stream(req, handler);
+	}
+	virtual Status request_stream(const Slice *head, int head_num,
+		const Slice *args, int num, ReplyHandler *handler);
+};
+
+}; // namespace ssdb
+
+#endif
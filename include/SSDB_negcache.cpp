@@ -0,0 +1,542 @@
+#include "SSDB_negcache.h"
+#include "bloom_filter.h"
+#include "ssdb_strings.h"
+#include <chrono>
+#if !defined(_WIN32)
+	#include <signal.h>
+#endif
+
+namespace ssdb{
+
+// name and is_hash never change, the rest is guarded by mutex_
+struct NegativeCacheClient::Filter{
+	std::string name; // key prefix, or hash name
+	bool is_hash;
+	bool built;
+	// queued for, or being rebuilt by, the rebuild thread
+	bool pending;
+	// invalidated while being rebuilt, the keys scanned may be out of date
+	bool invalidated;
+	// NULL when it could not be built, or would be useless
+	BloomFilter *bloom;
+	std::chrono::steady_clock::time_point built_at;
+	// keys written while pending, the scan may have passed them
+	std::vector<uint64_t> written;
+
+	Filter(const std::string &name, bool is_hash){
+		this->name = name;
+		this->is_hash = is_hash;
+		this->built = false;
+		this->pending = false;
+		this->invalidated = false;
+		this->bloom = NULL;
+	}
+	~Filter(){
+		delete bloom;
+	}
+	bool covers(const Slice &key) const{
+		if(is_hash){
+			return (int)name.size() == key.size && memcmp(name.data(), key.data, key.size) == 0;
+		}
+		return key.size > (int)name.size() && memcmp(name.data(), key.data, name.size()) == 0;
+	}
+};
+
+// a request given either as a vector or as Slices, see request_stream()
+struct NegativeCacheClient::Args{
+	const std::vector<std::string> *vec;
+	const Slice *head;
+	int head_num;
+	const Slice *args;
+	int num;
+
+	Args(const std::vector<std::string> &req){
+		vec = &req;
+		head = args = NULL;
+		head_num = num = 0;
+	}
+	Args(const Slice *head, int head_num, const Slice *args, int num){
+		this->vec = NULL;
+		this->head = head;
+		this->head_num = head_num;
+		this->args = args;
+		this->num = num;
+	}
+	int size() const{
+		return vec? (int)vec->size() : head_num + num;
+	}
+	Slice at(int i) const{
+		if(vec){
+			return Slice(vec->at(i));
+		}
+		return i < head_num? head[i] : args[i - head_num];
+	}
+};
+
+enum{
+	CMD_OTHER = 0,
+	CMD_GET,
+	CMD_EXISTS,
+	CMD_HGET,
+	CMD_HEXISTS,
+	CMD_SET,       // key at 1
+	CMD_MULTI_SET, // keys at 1, 3, 5...
+	CMD_HSET,      // name at 1, key at 2
+	CMD_MULTI_HSET // name at 1, keys at 2, 4, 6...
+};
+
+// what check() decided about a request
+enum{
+	FORWARD = 0,
+	PROBE,   // a lookup the filter let through
+	ABSENT   // a lookup the filter answered
+};
+
+static int command_type(const Slice &cmd){
+	static const struct{
+		const char *name;
+		int type;
+	} commands[] = {
+		{"get", CMD_GET},
+		{"exists", CMD_EXISTS},
+		{"hget", CMD_HGET},
+		{"hexists", CMD_HEXISTS},
+		{"set", CMD_SET},
+		{"setx", CMD_SET},
+		{"setnx", CMD_SET},
+		{"getset", CMD_SET},
+		{"incr", CMD_SET},
+		{"decr", CMD_SET},
+		{"setbit", CMD_SET},
+		{"multi_set", CMD_MULTI_SET},
+		{"hset", CMD_HSET},
+		{"hincr", CMD_HSET},
+		{"hdecr", CMD_HSET},
+		{"multi_hset", CMD_MULTI_HSET},
+	};
+	for(int i=0; i<(int)(sizeof(commands)/sizeof(commands[0])); i++){
+		const char *name = commands[i].name;
+		if((int)strlen(name) == cmd.size && memcmp(name, cmd.data, cmd.size) == 0){
+			return commands[i].type;
+		}
+	}
+	return CMD_OTHER;
+}
+
+// hashes the keys of a keys/hkeys page, stops past the end of a prefix
+class KeyCollector : public ReplyHandler{
+public:
+	const std::string *prefix;
+	std::vector<uint64_t> *hashes;
+	std::string last;
+	int count;
+	bool done;
+
+	virtual int item(const char *data, int size){
+		if(prefix && (size < (int)prefix->size() || memcmp(data, prefix->data(), prefix->size()) != 0)){
+			done = true;
+			return -1;
+		}
+		hashes->push_back(BloomFilter::hash(data, size));
+		last.assign(data, size);
+		count ++;
+		return 0;
+	}
+};
+
+// forwards the items of a lookup reply, notes whether the key was found
+class ProbeHandler : public ReplyHandler{
+public:
+	ReplyHandler *handler;
+	bool exists;
+	bool zero;
+
+	ProbeHandler(ReplyHandler *handler, int type){
+		this->handler = handler;
+		this->exists = (type == CMD_EXISTS || type == CMD_HEXISTS);
+		this->zero = false;
+	}
+	virtual int item(const char *data, int size){
+		zero = (size == 1 && data[0] == '0');
+		return handler->item(data, size);
+	}
+	bool found(Status &s) const{
+		return exists? !zero : !s.not_found();
+	}
+};
+
+// the reply to a lookup answered by a filter
+static Status absent_reply(int type, ReplyHandler *handler){
+	if(type == CMD_EXISTS || type == CMD_HEXISTS){
+		handler->item("0", 1);
+		return Status("ok");
+	}
+	return Status("not_found");
+}
+
+NegativeCacheClient::NegativeCacheClient(){
+	fp_rate_ = 0.01;
+	memory_budget_ = 16 * 1024 * 1024;
+	rebuild_interval_ = 300;
+	memset(&stats_, 0, sizeof(stats_));
+	port_ = 0;
+	stop_ = false;
+}
+
+NegativeCacheClient::~NegativeCacheClient(){
+	if(thread_.joinable()){
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		cond_.notify_one();
+		thread_.join();
+	}
+	for(int i=0; i<(int)filters_.size(); i++){
+		delete filters_[i];
+	}
+}
+
+NegativeCacheClient* NegativeCacheClient::connect(const char *ip, int port){
+	return NegativeCacheClient::connect(std::string(ip), port);
+}
+
+NegativeCacheClient* NegativeCacheClient::connect(const std::string &ip, int port){
+#if !defined(_WIN32)
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	Link *link = Link::connect(ip.c_str(), port);
+	if(link == NULL){
+		return NULL;
+	}
+	NegativeCacheClient *client = new NegativeCacheClient();
+	client->link = link;
+	client->ip_ = ip;
+	client->port_ = port;
+	client->thread_ = std::thread(&NegativeCacheClient::run, client);
+	return client;
+}
+
+void NegativeCacheClient::cache_prefix(const std::string &prefix){
+	for(int i=0; i<(int)filters_.size(); i++){
+		if(!filters_[i]->is_hash && filters_[i]->name == prefix){
+			return;
+		}
+	}
+	std::unique_lock<std::mutex> lock(mutex_);
+	filters_.push_back(new Filter(prefix, false));
+}
+
+void NegativeCacheClient::cache_hash(const std::string &name){
+	if(this->find_filter(true, Slice(name)) == NULL){
+		std::unique_lock<std::mutex> lock(mutex_);
+		filters_.push_back(new Filter(name, true));
+	}
+}
+
+void NegativeCacheClient::fp_rate(double rate){
+	std::unique_lock<std::mutex> lock(mutex_);
+	fp_rate_ = (rate > 0 && rate < 1)? rate : 0.01;
+}
+
+void NegativeCacheClient::memory_budget(int64_t bytes){
+	std::unique_lock<std::mutex> lock(mutex_);
+	memory_budget_ = bytes;
+}
+
+void NegativeCacheClient::invalidate(){
+	std::unique_lock<std::mutex> lock(mutex_);
+	for(int i=0; i<(int)filters_.size(); i++){
+		filters_[i]->built = false;
+		filters_[i]->invalidated = filters_[i]->pending;
+	}
+}
+
+// the hash filter of name, or the longest prefix filter covering key name,
+// only the thread using the client changes filters_, it may read it unlocked
+NegativeCacheClient::Filter* NegativeCacheClient::find_filter(bool is_hash, const Slice &name){
+	Filter *ret = NULL;
+	for(int i=0; i<(int)filters_.size(); i++){
+		Filter *f = filters_[i];
+		if(f->is_hash != is_hash || !f->covers(name)){
+			continue;
+		}
+		if(is_hash){
+			return f;
+		}
+		if(ret == NULL || f->name.size() > ret->name.size()){
+			ret = f;
+		}
+	}
+	return ret;
+}
+
+void NegativeCacheClient::add_key(bool is_hash, const Slice &name, const Slice &key){
+	Filter *f = this->find_filter(is_hash, name);
+	if(f == NULL){
+		return;
+	}
+	uint64_t hash = BloomFilter::hash(key.data, key.size);
+	std::unique_lock<std::mutex> lock(mutex_);
+	if(f->pending){
+		f->written.push_back(hash);
+	}
+	if(f->bloom){
+		f->bloom->add(hash);
+	}
+}
+
+// hash every key of filter, false if the scan failed
+bool NegativeCacheClient::scan_keys(Client *client, const Filter *filter, std::vector<uint64_t> *hashes){
+	const int limit = 1000;
+	KeyCollector collector;
+	collector.prefix = filter->is_hash? NULL : &filter->name;
+	collector.hashes = hashes;
+	collector.last = filter->is_hash? "" : filter->name;
+
+	std::vector<std::string> req;
+	while(1){
+		req.clear();
+		if(filter->is_hash){
+			req.push_back("hkeys");
+			req.push_back(filter->name);
+		}else{
+			req.push_back("keys");
+		}
+		req.push_back(collector.last);
+		req.push_back("");
+		req.push_back(str(limit));
+		collector.count = 0;
+		collector.done = false;
+		Status s = client->request_stream(req, &collector);
+		if(!s.ok()){
+			return false;
+		}
+		if(collector.done || collector.count < limit){
+			return true;
+		}
+	}
+}
+
+// rebuilds the filters check() queues, on a connection of its own
+void NegativeCacheClient::run(){
+	Client *client = NULL;
+	std::unique_lock<std::mutex> lock(mutex_);
+	while(1){
+		while(queue_.empty() && !stop_){
+			cond_.wait(lock);
+		}
+		if(stop_){
+			break;
+		}
+		Filter *filter = queue_.front();
+		queue_.pop_front();
+		int64_t budget = memory_budget_ / (int64_t)filters_.size();
+		double fp_rate = fp_rate_;
+		lock.unlock();
+
+		std::vector<uint64_t> hashes;
+		if(client == NULL){
+			client = Client::connect(ip_, port_);
+		}
+		bool ok = client && this->scan_keys(client, filter, &hashes);
+		if(!ok){
+			// reconnect for the next rebuild
+			delete client;
+			client = NULL;
+		}
+		BloomFilter *bloom = NULL;
+		if(ok){
+			// room for the keys written until the next rebuild
+			int64_t num = (int64_t)hashes.size() + (int64_t)hashes.size() / 4 + 1024;
+			bloom = new BloomFilter(num, fp_rate, budget);
+			for(int i=0; i<(int)hashes.size(); i++){
+				bloom->add(hashes[i]);
+			}
+			if(bloom->fp_rate() > 0.5){
+				delete bloom;
+				bloom = NULL;
+			}
+		}
+
+		lock.lock();
+		if(filter->invalidated){
+			// scan again, the keys written until now are on the server
+			filter->invalidated = false;
+			filter->written.clear();
+			queue_.push_back(filter);
+			lock.unlock();
+			delete bloom;
+			lock.lock();
+			continue;
+		}
+		for(int i=0; bloom && i<(int)filter->written.size(); i++){
+			bloom->add(filter->written[i]);
+		}
+		BloomFilter *old = filter->bloom;
+		filter->bloom = bloom;
+		filter->written.clear();
+		filter->pending = false;
+		filter->built = true;
+		filter->built_at = std::chrono::steady_clock::now();
+		stats_.rebuilds ++;
+		lock.unlock();
+		delete old;
+		lock.lock();
+	}
+	lock.unlock();
+	delete client;
+}
+
+// add the keys of a write to the filters, or look a read up in them
+int NegativeCacheClient::check(const Args &req, int *type){
+	int size = req.size();
+	*type = size > 0? command_type(req.at(0)) : CMD_OTHER;
+	switch(*type){
+		case CMD_SET:
+			if(size >= 2){
+				this->add_key(false, req.at(1), req.at(1));
+			}
+			return FORWARD;
+		case CMD_MULTI_SET:
+			for(int i=1; i<size; i+=2){
+				this->add_key(false, req.at(i), req.at(i));
+			}
+			return FORWARD;
+		case CMD_HSET:
+			if(size >= 3){
+				this->add_key(true, req.at(1), req.at(2));
+			}
+			return FORWARD;
+		case CMD_MULTI_HSET:
+			for(int i=2; size >= 2 && i<size; i+=2){
+				this->add_key(true, req.at(1), req.at(i));
+			}
+			return FORWARD;
+		case CMD_OTHER:
+			return FORWARD;
+	}
+
+	bool is_hash = (*type == CMD_HGET || *type == CMD_HEXISTS);
+	if(size < (is_hash? 3 : 2)){
+		return FORWARD;
+	}
+	Slice key = req.at(is_hash? 2 : 1);
+	Filter *f = this->find_filter(is_hash, req.at(1));
+	if(f == NULL){
+		return FORWARD;
+	}
+	stats_.lookups ++;
+	std::unique_lock<std::mutex> lock(mutex_);
+	if(!f->built || (rebuild_interval_ > 0 &&
+		std::chrono::steady_clock::now() - f->built_at > std::chrono::seconds(rebuild_interval_)))
+	{
+		// the server answers until the rebuild thread is done
+		if(!f->pending){
+			f->pending = true;
+			queue_.push_back(f);
+			cond_.notify_one();
+		}
+		return FORWARD;
+	}
+	if(f->bloom == NULL){
+		return FORWARD;
+	}
+	if(!f->bloom->may_contain(key.data, key.size)){
+		stats_.skipped ++;
+		return ABSENT;
+	}
+	return PROBE;
+}
+
+void NegativeCacheClient::probed(bool found){
+	if(!found){
+		stats_.false_positives ++;
+	}
+}
+
+const std::vector<std::string>* NegativeCacheClient::request(const std::vector<std::string> &req){
+	int type;
+	int ret = this->check(Args(req), &type);
+	if(ret == ABSENT){
+		resp_.clear();
+		if(type == CMD_EXISTS || type == CMD_HEXISTS){
+			resp_.push_back("ok");
+			resp_.push_back("0");
+		}else{
+			resp_.push_back("not_found");
+		}
+		return &resp_;
+	}
+	const std::vector<std::string> *resp = ClientImpl::request(req);
+	if(ret == PROBE && resp && !resp->empty()){
+		if(type == CMD_EXISTS || type == CMD_HEXISTS){
+			this->probed(resp->size() < 2 || resp->at(1) != "0");
+		}else{
+			this->probed(resp->at(0) != "not_found");
+		}
+	}
+	return resp;
+}
+
+Status NegativeCacheClient::request_stream(const std::vector<std::string> &req, ReplyHandler *handler){
+	int type;
+	int ret = this->check(Args(req), &type);
+	if(ret == ABSENT){
+		return absent_reply(type, handler);
+	}
+	if(ret == FORWARD){
+		return ClientImpl::request_stream(req, handler);
+	}
+	ProbeHandler probe(handler, type);
+	Status s = ClientImpl::request_stream(req, &probe);
+	this->probed(probe.found(s));
+	return s;
+}
+
+Status NegativeCacheClient::request_stream(const Slice *head, int head_num,
+	const Slice *args, int num, ReplyHandler *handler)
+{
+	int type;
+	int ret = this->check(Args(head, head_num, args, num), &type);
+	if(ret == ABSENT){
+		return absent_reply(type, handler);
+	}
+	if(ret == FORWARD){
+		return ClientImpl::request_stream(head, head_num, args, num, handler);
+	}
+	ProbeHandler probe(handler, type);
+	Status s = ClientImpl::request_stream(head, head_num, args, num, &probe);
+	this->probed(probe.found(s));
+	return s;
+}
+
+NegativeCacheStats NegativeCacheClient::get_stats() const{
+	std::unique_lock<std::mutex> lock(mutex_);
+	NegativeCacheStats st = stats_;
+	st.items = 0;
+	st.bytes = 0;
+	for(int i=0; i<(int)filters_.size(); i++){
+		const BloomFilter *bloom = filters_[i]->bloom;
+		if(bloom){
+			st.items += bloom->items();
+			st.bytes += bloom->bytes();
+		}
+	}
+	return st;
+}
+
+std::string NegativeCacheClient::stats() const{
+	NegativeCacheStats st = this->get_stats();
+	// share of the absent keys the filters let through
+	int64_t absent = st.skipped + st.false_positives;
+	double fp = absent? (double)st.false_positives / absent : 0;
+	char buf[256];
+	snprintf(buf, sizeof(buf),
+		"lookups: %" PRId64 ", skipped: %" PRId64 ", false_positives: %" PRId64
+		", fp_rate: %.4f, rebuilds: %" PRId64 ", items: %" PRId64 ", bytes: %" PRId64,
+		st.lookups, st.skipped, st.false_positives, fp, st.rebuilds, st.items, st.bytes);
+	return std::string(buf);
+}
+
+}; // namespace ssdb
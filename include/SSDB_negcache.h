@@ -0,0 +1,118 @@
+#ifndef SSDB_API_NEGCACHE_CPP
+#define SSDB_API_NEGCACHE_CPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SSDB_impl.h"
+
+namespace ssdb{
+
+struct NegativeCacheStats{
+	int64_t lookups;         // get/hget/exists/hexists on a cached range
+	int64_t skipped;         // answered by a filter, no round trip
+	int64_t false_positives; // passed a filter, then not found by the server
+	int64_t rebuilds;
+	int64_t items;           // keys in all filters
+	int64_t bytes;           // memory of all filters
+};
+
+/**
+ * A client that answers lookups of absent keys without a round trip.
+ *
+ * Every cached key prefix and every cached hash gets a Bloom filter,
+ * built by paging through keys/hkeys. A get, hget, exists or hexists
+ * whose key is not in the filter is answered not_found (or 0) locally.
+ * Keys written through this client (set, setx, setnx, getset, incr,
+ * decr, setbit, multi_set, hset, hincr, hdecr, multi_hset) are added to
+ * the filters as they go, deletes leave them in, which only costs a
+ * round trip.
+ *
+ * Keys created by other clients are missed until the next rebuild, so a
+ * filter is rebuilt once it is older than rebuild_interval(). Only use
+ * it on ranges that other writers do not touch, or where answering
+ * not_found for a recent key until then is acceptable.
+ *
+ * Filters are built by a background thread on a connection of its own,
+ * lookups never wait for one. Until a filter is built, and while an
+ * expired one is rebuilt, its lookups go to the server.
+ *
+ * A key equal to a cached prefix itself is never short-circuited.
+ */
+class NegativeCacheClient : public ClientImpl{
+private:
+	struct Filter;
+	struct Args;
+
+	std::vector<Filter *> filters_;
+	double fp_rate_;
+	int64_t memory_budget_;
+	int rebuild_interval_;
+	NegativeCacheStats stats_;
+
+	// the rebuild thread, and the filters waiting for it
+	std::string ip_;
+	int port_;
+	std::thread thread_;
+	mutable std::mutex mutex_;
+	std::condition_variable cond_;
+	std::deque<Filter *> queue_;
+	bool stop_;
+
+	NegativeCacheClient();
+	Filter* find_filter(bool is_hash, const Slice &name);
+	void add_key(bool is_hash, const Slice &name, const Slice &key);
+	void run();
+	bool scan_keys(Client *client, const Filter *filter, std::vector<uint64_t> *hashes);
+	int check(const Args &req, int *type);
+	void probed(bool found);
+public:
+	~NegativeCacheClient();
+
+	static NegativeCacheClient* connect(const char *ip, int port);
+	static NegativeCacheClient* connect(const std::string &ip, int port);
+
+	/**
+	 * Cache the keys starting with prefix, an empty prefix caches the
+	 * whole key space. The filter is built after the first lookup.
+	 */
+	void cache_prefix(const std::string &prefix);
+	void cache_hash(const std::string &name);
+
+	/**
+	 * Target false-positive rate of the filters. Default 0.01.
+	 */
+	void fp_rate(double rate);
+	/**
+	 * Memory for all filters in bytes, split evenly among them. A filter
+	 * over budget gets a higher false-positive rate, a filter whose
+	 * expected rate exceeds 50% is not used. Default 16MB.
+	 */
+	void memory_budget(int64_t bytes);
+	/**
+	 * Rebuild a filter on the first lookup after it is this many seconds
+	 * old, 0 to never rebuild. Default 300.
+	 */
+	void rebuild_interval(int seconds){
+		rebuild_interval_ = seconds >= 0? seconds : 0;
+	}
+	// rebuild every filter on its next lookup
+	void invalidate();
+
+	NegativeCacheStats get_stats() const;
+	std::string stats() const;
+
+	using ClientImpl::request;
+	virtual const std::vector<std::string>* request(const std::vector<std::string> &req);
+	using ClientImpl::request_stream;
+	virtual Status request_stream(const std::vector<std::string> &req, ReplyHandler *handler);
+	virtual Status request_stream(const Slice *head, int head_num,
+		const Slice *args, int num, ReplyHandler *handler);
+};
+
+}; // namespace ssdb
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef SSDB_API_REPLY_CPP
+#define SSDB_API_REPLY_CPP
+
+#include "SSDB_client.h"
+#include "ssdb_strings.h"
+
+namespace ssdb{
+
+// Decoders of response packets, shared by all client implementations.
+
+inline static
+Status _read_list(const std::vector<std::string> *resp, std::vector<std::string> *ret){
+	Status s(resp);
+	if(s.ok()){
+		std::vector<std::string>::const_iterator it;
+		for(it = resp->begin() + 1; it != resp->end(); it++){
+			ret->push_back(*it);
+		}
+	}
+	return s;
+}
+
+inline static
+Status _read_int64(const std::vector<std::string> *resp, int64_t *ret){
+	Status s(resp);
+	if(s.ok()){
+		if(resp->size() >= 2){
+			if(ret){
+				*ret = str_to_int64(resp->at(1));
+			}
+		}else{
+			return Status("server_error");
+		}
+	}
+	return s;
+}
+
+inline static
+Status _read_str(const std::vector<std::string> *resp, std::string *ret){
+	Status s(resp);
+	if(s.ok()){
+		if(resp->size() >= 2){
+			*ret = resp->at(1);
+		}else{
+			return Status("server_error");
+		}
+	}
+	return s;
+}
+
+// Commands that only read, which a replica may answer.
+inline static
+bool _is_read_command(const char *cmd, int size){
+	static const char *commands[] = {
+		"get", "exists", "ttl",
+		"hget", "hexists", "hsize",
+		"zget", "zexists", "zsize",
+		"qsize",
+		"multi_get", "multi_hget", "multi_zget",
+	};
+	for(int i=0; i<(int)(sizeof(commands)/sizeof(commands[0])); i++){
+		if((int)strlen(commands[i]) == size && memcmp(commands[i], cmd, size) == 0){
+			return true;
+		}
+	}
+	return false;
+}
+
+inline static
+bool _is_read_command(const std::string &cmd){
+	return _is_read_command(cmd.data(), (int)cmd.size());
+}
+
+}; // namespace ssdb
+
+#endif
@@ -0,0 +1,223 @@
+#include "SSDB_shared.h"
+#include "ssdb_strings.h"
+#include <chrono>
+#if !defined(_WIN32)
+	#include <signal.h>
+	#include <sys/select.h>
+#endif
+
+namespace ssdb{
+
+void Future::complete(int state){
+	int expected = PENDING;
+	if(state_.compare_exchange_strong(expected, state)){
+		// nobody is blocked on it
+		return;
+	}
+	// the waiter is blocked, or about to block, while holding the mutex
+	std::lock_guard<std::mutex> lock(mutex_);
+	state_.store(state);
+	cond_.notify_one();
+}
+
+const std::vector<std::string>* Future::wait(){
+	int state = state_.load();
+	// spin a little, pipelined responses usually arrive in no time
+	for(int i=0; i<64 && state == PENDING; i++){
+		std::this_thread::yield();
+		state = state_.load();
+	}
+	if(state == PENDING){
+		std::unique_lock<std::mutex> lock(mutex_);
+		int expected = PENDING;
+		if(state_.compare_exchange_strong(expected, WAITING)){
+			while((state = state_.load()) == WAITING){
+				cond_.wait(lock);
+			}
+		}else{
+			state = expected;
+		}
+	}
+	return state == DONE? &resp_ : NULL;
+}
+
+SharedClient::SharedClient(){
+	stop_.store(false);
+	error_.store(false);
+	sleeping_.store(false);
+	max_inflight_ = 1024;
+	poll_interval_ = 1;
+}
+
+SharedClient::~SharedClient(){
+	if(thread_.joinable()){
+		stop_.store(true);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			cond_.notify_one();
+		}
+		thread_.join();
+	}
+	this->fail_all();
+}
+
+SharedClient* SharedClient::connect(const char *ip, int port){
+	return SharedClient::connect(std::string(ip), port);
+}
+
+SharedClient* SharedClient::connect(const std::string &ip, int port){
+#if !defined(_WIN32)
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	Link *link = Link::connect(ip.c_str(), port);
+	if(link == NULL){
+		return NULL;
+	}
+	link->nodelay(true);
+	link->noblock(true);
+
+	SharedClient *client = new SharedClient();
+	client->link = link;
+	client->thread_ = std::thread(&SharedClient::run, client);
+	return client;
+}
+
+bool SharedClient::submit(const std::vector<std::string> &req, Future *f){
+	if(error_.load()){
+		return false;
+	}
+	f->packet_.clear();
+	Link::encode_packet(req, &f->packet_);
+	f->state_.store(Future::PENDING);
+	queue_.push(f);
+	this->wakeup();
+	return true;
+}
+
+const std::vector<std::string>* SharedClient::request(const std::vector<std::string> &req){
+	static thread_local Future future;
+	if(!this->submit(req, &future)){
+		return NULL;
+	}
+	return future.wait();
+}
+
+void SharedClient::wakeup(){
+	if(sleeping_.load()){
+		std::lock_guard<std::mutex> lock(mutex_);
+		cond_.notify_one();
+	}
+}
+
+void SharedClient::enqueue(Future *f){
+	if(error_.load() || link->send_packet(f->packet_.data(), (int)f->packet_.size()) == -1){
+		f->complete(Future::FAILED);
+		return;
+	}
+	inflight_.push_back(f);
+}
+
+void SharedClient::fail_all(){
+	error_.store(true);
+	while(!inflight_.empty()){
+		Future *f = inflight_.front();
+		inflight_.pop_front();
+		f->complete(Future::FAILED);
+	}
+	Future *f;
+	while((f = (Future *)queue_.pop()) != NULL){
+		f->complete(Future::FAILED);
+	}
+}
+
+void SharedClient::run(){
+	while(!stop_.load()){
+		while((int)inflight_.size() < max_inflight_){
+			Future *f = (Future *)queue_.pop();
+			if(f == NULL){
+				break;
+			}
+			this->enqueue(f);
+		}
+
+		if(inflight_.empty()){
+			Future *f;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				sleeping_.store(true);
+				f = (Future *)queue_.pop();
+				if(f == NULL && !stop_.load()){
+					// wakeup() notifies us, the timeout is only a safety net
+					cond_.wait_for(lock, std::chrono::milliseconds(100));
+				}
+				sleeping_.store(false);
+			}
+			if(f){
+				this->enqueue(f);
+			}
+			continue;
+		}
+
+		if(this->io(poll_interval_) == -1){
+			this->fail_all();
+		}
+	}
+}
+
+int SharedClient::io(int timeout_ms){
+	if(!link->output->empty()){
+		if(link->write() == -1){
+			return -1;
+		}
+	}
+
+	int fd = link->fd();
+	fd_set rfds, wfds;
+	FD_ZERO(&rfds);
+	FD_ZERO(&wfds);
+	FD_SET(fd, &rfds);
+	if(!link->output->empty()){
+		FD_SET(fd, &wfds);
+	}
+	struct timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+	int ret = ::select(fd + 1, &rfds, &wfds, NULL, &tv);
+	if(ret == -1){
+		return errno == EINTR? 0 : -1;
+	}
+	if(ret == 0){
+		return 0;
+	}
+	if(FD_ISSET(fd, &wfds)){
+		if(link->write() == -1){
+			return -1;
+		}
+	}
+	if(FD_ISSET(fd, &rfds)){
+		if(link->read() <= 0){
+			return -1;
+		}
+		// responses come back in the order requests were written
+		while(!inflight_.empty()){
+			const std::vector<Bytes> *packet = link->recv();
+			if(packet == NULL){
+				return -1;
+			}
+			if(packet->empty()){
+				break;
+			}
+			Future *f = inflight_.front();
+			inflight_.pop_front();
+			f->resp_.clear();
+			for(std::vector<Bytes>::const_iterator it=packet->begin(); it!=packet->end(); it++){
+				f->resp_.push_back(it->String());
+			}
+			f->complete(Future::DONE);
+		}
+	}
+	return 0;
+}
+
+}; // namespace ssdb
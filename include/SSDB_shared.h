@@ -0,0 +1,137 @@
+#ifndef SSDB_API_SHARED_CPP
+#define SSDB_API_SHARED_CPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "SSDB_impl.h"
+#include "mpsc_queue.h"
+
+namespace ssdb{
+
+class SharedClient;
+
+/**
+ * A request submitted to a SharedClient, completed by its I/O thread.
+ * The caller owns the Future and must keep it alive until wait() returns.
+ * A Future may be reused once it is completed.
+ */
+class Future : public MpscNode{
+private:
+	friend class SharedClient;
+
+	enum{
+		PENDING = 0,
+		WAITING,
+		DONE,
+		FAILED
+	};
+
+	std::string packet_;
+	std::vector<std::string> resp_;
+	std::atomic<int> state_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+
+	void complete(int state);
+	// No copying allowed
+	Future(const Future&);
+	void operator=(const Future&);
+public:
+	Future(){
+		state_.store(FAILED);
+	}
+
+	bool ready() const{
+		int state = state_.load();
+		return state != PENDING && state != WAITING;
+	}
+	/**
+	 * Wait until the response arrives.
+	 * @return NULL if error, or the response, the first element is response code.
+	 */
+	const std::vector<std::string>* wait();
+};
+
+/**
+ * A thread-safe client, many threads share one connection.
+ *
+ * Threads submit requests into a lock-free queue, a dedicated I/O thread
+ * writes them to the Link in submission order, and hands responses back
+ * by FIFO position. Requests from different threads are pipelined on the
+ * socket as a side effect.
+ *
+ * All methods of Client may be called concurrently. The vector returned
+ * by request() belongs to the calling thread, it stays valid until the
+ * same thread makes another request.
+ */
+class SharedClient : public ClientImpl{
+private:
+	MpscQueue queue_;
+	std::deque<Future *> inflight_;
+	std::thread thread_;
+	std::atomic<bool> stop_;
+	std::atomic<bool> error_;
+
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	std::atomic<bool> sleeping_;
+
+	std::atomic<int> max_inflight_;
+	std::atomic<int> poll_interval_;
+
+	SharedClient();
+	void run();
+	void wakeup();
+	void enqueue(Future *f);
+	void fail_all();
+	int io(int timeout_ms);
+public:
+	~SharedClient();
+
+	static SharedClient* connect(const char *ip, int port);
+	static SharedClient* connect(const std::string &ip, int port);
+
+	/**
+	 * Limit the number of requests sent but not yet answered,
+	 * further requests wait in the queue. Default 1024.
+	 */
+	void max_inflight(int num){
+		max_inflight_ = num > 0? num : 1;
+	}
+	/**
+	 * While responses are outstanding, the I/O thread polls the socket for
+	 * at most this many milliseconds before picking up new submissions.
+	 * Default 1.
+	 */
+	void poll_interval(int ms){
+		poll_interval_ = ms >= 0? ms : 0;
+	}
+
+	/**
+	 * Queue a request without waiting for the response.
+	 * @return false if the connection is broken, f is left untouched.
+	 */
+	bool submit(const std::vector<std::string> &req, Future *f);
+
+	using ClientImpl::request;
+	virtual const std::vector<std::string>* request(const std::vector<std::string> &req);
+	// the Link belongs to the I/O thread, replies are buffered
+	using ClientImpl::request_stream;
+	virtual Status request_stream(const std::vector<std::string> &req, ReplyHandler *handler){
+		return Client::request_stream(req, handler);
+	}
+	virtual Status request_stream(const Slice *head, int head_num,
+		const Slice *args, int num, ReplyHandler *handler)
+	{
+		return Client::request_stream(head, head_num, args, num, handler);
+	}
+};
+
+}; // namespace ssdb
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+
+#include "balancer.h"
+#include <stdio.h>
+
+// xorshift64*, one generator per thread so pick() takes no lock
+static inline uint64_t next_random(){
+	static thread_local uint64_t x = 0;
+	if(x == 0){
+		x = (uint64_t)(uintptr_t)&x ^ 0x9e3779b97f4a7c15ULL;
+	}
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+Balancer::Balancer(int decay_shift){
+	decay_shift_ = (decay_shift >= 0 && decay_shift < 16)? decay_shift : 3;
+}
+
+Balancer::~Balancer(){
+	this->resize(0);
+}
+
+void Balancer::resize(int num){
+	while((int)nodes_.size() > num){
+		delete nodes_.back();
+		nodes_.pop_back();
+	}
+	while((int)nodes_.size() < num){
+		nodes_.push_back(new Node());
+	}
+}
+
+void Balancer::start(int node){
+	nodes_[node]->inflight ++;
+	nodes_[node]->picks ++;
+}
+
+void Balancer::done(int node, int64_t latency_us, bool ok){
+	Node *n = nodes_[node];
+	n->inflight --;
+	if(!ok){
+		n->errors ++;
+		n->down = true;
+		return;
+	}
+	if(latency_us < 1){
+		latency_us = 1;
+	}
+	int64_t old = n->ewma_us;
+	while(1){
+		int64_t avg = old == 0? latency_us : old + (latency_us - old) / (1 << decay_shift_);
+		if(n->ewma_us.compare_exchange_weak(old, avg)){
+			break;
+		}
+	}
+}
+
+void Balancer::revive(int node){
+	nodes_[node]->down = false;
+}
+
+std::string Balancer::stats(int node) const{
+	const Node *n = nodes_[node];
+	char buf[128];
+	snprintf(buf, sizeof(buf), "picks: %" PRId64 ", errors: %" PRId64 ", latency: %" PRId64 "us, inflight: %d%s",
+		n->picks.load(), n->errors.load(), n->ewma_us.load(), n->inflight.load(), n->down? ", down" : "");
+	return std::string(buf);
+}
+
+std::string Balancer::stats() const{
+	std::string ret;
+	for(int i=0; i<(int)nodes_.size(); i++){
+		if(i > 0){
+			ret.append("\n");
+		}
+		char buf[16];
+		snprintf(buf, sizeof(buf), "%d: ", i);
+		ret.append(buf);
+		ret.append(this->stats(i));
+	}
+	return ret;
+}
+
+int RoundRobinBalancer::pick(){
+	int num = (int)nodes_.size();
+	for(int i=0; i<num; i++){
+		int node = (int)(next_++ % (unsigned)num);
+		if(!nodes_[node]->down){
+			return node;
+		}
+	}
+	return -1;
+}
+
+int P2CBalancer::pick(){
+	int num = (int)nodes_.size();
+	if(num == 0){
+		return -1;
+	}
+	if(num == 1){
+		return nodes_[0]->down? -1 : 0;
+	}
+	int a = (int)(next_random() % num);
+	int b = (int)(next_random() % (num - 1));
+	if(b >= a){
+		b ++;
+	}
+	bool a_down = nodes_[a]->down;
+	bool b_down = nodes_[b]->down;
+	if(a_down && b_down){
+		// both draws are down, take the first live node after them
+		for(int i=1; i<num; i++){
+			int node = (a + i) % num;
+			if(!nodes_[node]->down){
+				return node;
+			}
+		}
+		return -1;
+	}
+	if(a_down || b_down){
+		return a_down? b : a;
+	}
+	int64_t score_a = nodes_[a]->ewma_us * (nodes_[a]->inflight + 1);
+	int64_t score_b = nodes_[b]->ewma_us * (nodes_[b]->inflight + 1);
+	return score_b < score_a? b : a;
+}
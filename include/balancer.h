@@ -0,0 +1,111 @@
+#ifndef UTIL_BALANCER_H_
+#define UTIL_BALANCER_H_
+
+#include <inttypes.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+/**
+ * Decides which of a set of equivalent nodes serves the next request.
+ *
+ * The owner numbers its nodes 0..num-1 and calls resize() before the first
+ * pick(). Every request on a node picked is bracketed by start() and done(),
+ * done() with ok false takes the node out until the owner calls revive().
+ *
+ * pick(), start() and done() may be called from many threads at once, so a
+ * pool or a sharded client can share one instance per replica set. resize()
+ * must not race with them.
+ */
+class Balancer{
+	protected:
+		struct Node{
+			std::atomic<int> inflight;
+			std::atomic<bool> down;
+			std::atomic<int64_t> picks;
+			std::atomic<int64_t> errors;
+			// moving average latency in microseconds, 0 until the first reply
+			std::atomic<int64_t> ewma_us;
+			Node(){
+				inflight = 0;
+				down = false;
+				picks = 0;
+				errors = 0;
+				ewma_us = 0;
+			}
+		};
+		std::vector<Node *> nodes_;
+		int decay_shift_;
+	public:
+		/**
+		 * Every reply moves the latency average 1/2^decay_shift of the way
+		 * to the reply's latency.
+		 */
+		Balancer(int decay_shift=3);
+		virtual ~Balancer();
+		virtual Balancer* clone() const = 0;
+
+		void resize(int num);
+		int size() const{
+			return (int)nodes_.size();
+		}
+
+		// the node for the next request, -1 if every node is down
+		virtual int pick() = 0;
+		void start(int node);
+		void done(int node, int64_t latency_us, bool ok);
+		void revive(int node);
+
+		bool is_down(int node) const{
+			return nodes_[node]->down;
+		}
+		int64_t latency_us(int node) const{
+			return nodes_[node]->ewma_us;
+		}
+		int inflight(int node) const{
+			return nodes_[node]->inflight;
+		}
+
+		// picks, errors, latency and requests in flight of a node
+		virtual std::string stats(int node) const;
+		// a line per node
+		std::string stats() const;
+};
+
+/**
+ * Every node in turn, whatever its latency.
+ */
+class RoundRobinBalancer : public Balancer{
+	private:
+		std::atomic<unsigned> next_;
+	public:
+		RoundRobinBalancer(){
+			next_ = 0;
+		}
+		virtual Balancer* clone() const{
+			return new RoundRobinBalancer();
+		}
+		virtual int pick();
+};
+
+/**
+ * Power of two choices: two random nodes are compared, and the one with the
+ * lower latency * (requests in flight + 1) is picked.
+ *
+ * A node without replies yet scores 0, so new nodes are probed at once. A
+ * slow node keeps getting the occasional request when it is drawn against
+ * another slow one, which is how its average recovers. Comparing two random
+ * nodes, rather than taking the best of all, keeps many clients sharing the
+ * same statistics from stampeding the same node.
+ */
+class P2CBalancer : public Balancer{
+	public:
+		P2CBalancer(int decay_shift=3) : Balancer(decay_shift){
+		}
+		virtual Balancer* clone() const{
+			return new P2CBalancer(decay_shift_);
+		}
+		virtual int pick();
+};
+
+#endif
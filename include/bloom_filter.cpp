@@ -0,0 +1,86 @@
+#include "bloom_filter.h"
+#include <string.h>
+#include <math.h>
+
+// M_LN2 needs _USE_MATH_DEFINES with MSVC
+static const double LN2 = 0.69314718055994530942;
+
+static inline uint64_t rotl64(uint64_t x, int r){
+	return (x << r) | (x >> (64 - r));
+}
+
+// splitmix64 finalizer, every input bit affects every output bit
+static inline uint64_t fmix64(uint64_t h){
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	h ^= h >> 31;
+	return h;
+}
+
+BloomFilter::BloomFilter(int64_t num, double fp_rate, int64_t max_bytes){
+	if(num < 1){
+		num = 1;
+	}
+	if(fp_rate <= 0 || fp_rate >= 1){
+		fp_rate = 0.01;
+	}
+	// m = -n * ln(p) / ln(2)^2
+	double ideal = -(double)num * log(fp_rate) / (LN2 * LN2);
+	int64_t max_bits = max_bytes * 8;
+	int64_t bits = 64;
+	while(bits < ideal && bits * 2 <= max_bits){
+		bits *= 2;
+	}
+	bits_.assign((size_t)(bits / 64), 0);
+	mask_ = (uint64_t)bits - 1;
+
+	// k = m / n * ln(2)
+	int k = (int)((double)bits / num * LN2 + 0.5);
+	num_hashes_ = k < 1? 1 : (k > 16? 16 : k);
+	items_ = 0;
+}
+
+uint64_t BloomFilter::hash(const char *data, int size){
+	const uint64_t m = 0x9e3779b97f4a7c15ULL;
+	uint64_t h = (uint64_t)size * m;
+	int i = 0;
+	for(; i + 8 <= size; i += 8){
+		uint64_t w;
+		memcpy(&w, data + i, 8);
+		h = rotl64(h ^ (w * m), 31) * m;
+	}
+	uint64_t w = 0;
+	for(int shift = 0; i < size; i++, shift += 8){
+		w |= (uint64_t)(unsigned char)data[i] << shift;
+	}
+	h = rotl64(h ^ (w * m), 31) * m;
+	return fmix64(h);
+}
+
+void BloomFilter::add(uint64_t h){
+	uint64_t h2 = rotl64(h, 32) | 1;
+	for(int i=0; i<num_hashes_; i++){
+		uint64_t pos = (h + i * h2) & mask_;
+		bits_[pos >> 6] |= (uint64_t)1 << (pos & 63);
+	}
+	items_ ++;
+}
+
+bool BloomFilter::may_contain(uint64_t h) const{
+	uint64_t h2 = rotl64(h, 32) | 1;
+	for(int i=0; i<num_hashes_; i++){
+		uint64_t pos = (h + i * h2) & mask_;
+		if((bits_[pos >> 6] & ((uint64_t)1 << (pos & 63))) == 0){
+			return false;
+		}
+	}
+	return true;
+}
+
+double BloomFilter::fp_rate() const{
+	// (1 - e^(-k * n / m)) ^ k
+	double m = (double)bits_.size() * 64;
+	return pow(1 - exp(-num_hashes_ * (double)items_ / m), num_hashes_);
+}
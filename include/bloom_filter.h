@@ -0,0 +1,54 @@
+#ifndef UTIL_BLOOM_FILTER_H_
+#define UTIL_BLOOM_FILTER_H_
+
+#include <inttypes.h>
+#include <vector>
+
+/**
+ * A Bloom filter over byte strings. may_contain() never returns false for
+ * an item that was added, and returns true for an item that was not added
+ * with about the false-positive rate it was sized for.
+ *
+ * The bit array is a power of two, so hash positions are found with a mask.
+ * Items are hashed once with hash(), the k positions are derived from that
+ * 64-bit value by double hashing.
+ */
+class BloomFilter{
+	private:
+		std::vector<uint64_t> bits_;
+		uint64_t mask_;
+		int num_hashes_;
+		int64_t items_;
+	public:
+		/**
+		 * Sized for num items at fp_rate, but never larger than max_bytes,
+		 * in which case the real rate is higher, see fp_rate().
+		 */
+		BloomFilter(int64_t num, double fp_rate, int64_t max_bytes);
+
+		static uint64_t hash(const char *data, int size);
+
+		void add(uint64_t h);
+		bool may_contain(uint64_t h) const;
+
+		void add(const char *data, int size){
+			this->add(hash(data, size));
+		}
+		bool may_contain(const char *data, int size) const{
+			return this->may_contain(hash(data, size));
+		}
+
+		int64_t bytes() const{
+			return (int64_t)bits_.size() * 8;
+		}
+		int num_hashes() const{
+			return num_hashes_;
+		}
+		int64_t items() const{
+			return items_;
+		}
+		// expected false-positive rate with the items added so far
+		double fp_rate() const;
+};
+
+#endif
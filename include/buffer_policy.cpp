@@ -0,0 +1,91 @@
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+
+#include "buffer_policy.h"
+#include <stdio.h>
+
+static inline int round_up_pow2(int size){
+	int n = 1024;
+	while(n < size && n < (1 << 30)){
+		n <<= 1;
+	}
+	return n;
+}
+
+std::string BufferPolicy::stats() const{
+	char str[128];
+	snprintf(str, sizeof(str), "grows: %" PRId64 ", shrinks: %" PRId64 ", peak: %d",
+		grows_, shrinks_, peak_);
+	return std::string(str);
+}
+
+int FixedBufferPolicy::grow_size(int total, int){
+	grows_ ++;
+	if(total < 8 * 1024){
+		return 8 * 1024;
+	}else if(total < 512 * 1024){
+		return 8 * total;
+	}else{
+		return 2 * total;
+	}
+}
+
+int FixedBufferPolicy::drained(int total){
+	if(total > BEST_SIZE){
+		shrinks_ ++;
+		return BEST_SIZE;
+	}
+	return 0;
+}
+
+AdaptiveBufferPolicy::AdaptiveBufferPolicy(int min_size, int decay_shift, int shrink_after){
+	min_size_ = min_size;
+	decay_shift_ = decay_shift;
+	shrink_after_ = shrink_after;
+	hwm_ = 0;
+	low_count_ = 0;
+}
+
+int AdaptiveBufferPolicy::target() const{
+	int n = round_up_pow2(hwm_);
+	return n > min_size_? n : min_size_;
+}
+
+int AdaptiveBufferPolicy::grow_size(int total, int){
+	grows_ ++;
+	int n = total * 2;
+	int t = this->target();
+	if(n < t){
+		n = t;
+	}
+	return n;
+}
+
+int AdaptiveBufferPolicy::drained(int total){
+	hwm_ -= hwm_ >> decay_shift_;
+	int t = this->target();
+	if(total <= t * 2){
+		low_count_ = 0;
+		return 0;
+	}
+	if(++low_count_ < shrink_after_){
+		return 0;
+	}
+	low_count_ = 0;
+	shrinks_ ++;
+	return t;
+}
+
+void AdaptiveBufferPolicy::observe(int size){
+	BufferPolicy::observe(size);
+	if(size > hwm_){
+		hwm_ = size;
+	}
+}
+
+std::string AdaptiveBufferPolicy::stats() const{
+	char str[64];
+	snprintf(str, sizeof(str), ", hwm: %d", hwm_);
+	return BufferPolicy::stats() + str;
+}
@@ -0,0 +1,94 @@
+#ifndef UTIL_BUFFER_POLICY_H_
+#define UTIL_BUFFER_POLICY_H_
+
+#include <inttypes.h>
+#include <string>
+
+/**
+ * Decides how a Buffer grows, and how far its owner shrinks it once drained.
+ * One instance per Buffer, it may keep state about the traffic it sees.
+ */
+class BufferPolicy{
+	protected:
+		int64_t grows_;
+		int64_t shrinks_;
+		int peak_;
+	public:
+		BufferPolicy(){
+			grows_ = 0;
+			shrinks_ = 0;
+			peak_ = 0;
+		}
+		virtual ~BufferPolicy(){}
+		virtual BufferPolicy* clone() const = 0;
+
+		// new capacity for a full buffer, must be larger than total
+		virtual int grow_size(int total, int size) = 0;
+		/**
+		 * called by the owner every time the buffer is found empty,
+		 * return the capacity to shrink to, 0 to keep the buffer as is.
+		 */
+		virtual int drained(int total) = 0;
+		// called with the number of bytes buffered after every read or before every write
+		virtual void observe(int size){
+			if(size > peak_){
+				peak_ = size;
+			}
+		}
+
+		virtual std::string stats() const;
+};
+
+/**
+ * The original ladder: 8KB, x8 up to 512KB, then x2,
+ * back to 8KB as soon as the buffer is empty.
+ */
+class FixedBufferPolicy : public BufferPolicy{
+	public:
+		const static int BEST_SIZE = 8 * 1024;
+
+		virtual BufferPolicy* clone() const{
+			return new FixedBufferPolicy();
+		}
+		virtual int grow_size(int total, int size);
+		virtual int drained(int total);
+};
+
+/**
+ * Sizes the buffer to the recent working set.
+ *
+ * Tracks a high-water mark of buffered bytes which decays by 1/2^decay_shift
+ * every time the buffer drains. grow() jumps straight to the high-water mark,
+ * and the buffer is shrunk only after it has been more than twice the
+ * high-water mark for shrink_after drains in a row, so a client alternating
+ * big and small replies keeps its buffer.
+ *
+ * Both are counted in drains, not in elapsed time: a busy link forgets a
+ * burst after a few dozen requests, an idle link keeps its buffer at the
+ * size it had until traffic resumes.
+ */
+class AdaptiveBufferPolicy : public BufferPolicy{
+	private:
+		int min_size_;
+		int decay_shift_;
+		int shrink_after_;
+		int hwm_;
+		int low_count_;
+		int target() const;
+	public:
+		AdaptiveBufferPolicy(int min_size=8*1024, int decay_shift=3, int shrink_after=16);
+
+		virtual BufferPolicy* clone() const{
+			return new AdaptiveBufferPolicy(min_size_, decay_shift_, shrink_after_);
+		}
+		virtual int grow_size(int total, int size);
+		virtual int drained(int total);
+		virtual void observe(int size);
+		virtual std::string stats() const;
+
+		int high_water_mark() const{
+			return hwm_;
+		}
+};
+
+#endif
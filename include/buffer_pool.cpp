@@ -0,0 +1,241 @@
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+
+#include "buffer_pool.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace{
+
+// MIN_SIZE << (NUM_CLASSES - 1) == MAX_SIZE
+const int NUM_CLASSES = 14;
+
+// one cache line each, threads bump them on every call
+struct alignas(64) Counter{
+	std::atomic<int64_t> n;
+};
+
+Counter g_in_use;
+Counter g_cached;
+Counter g_thread_hits;
+Counter g_shared_hits;
+Counter g_mallocs;
+std::atomic<bool> g_enabled(true);
+
+inline void count(Counter &counter, int64_t n){
+	counter.n.fetch_add(n, std::memory_order_relaxed);
+}
+
+// return the class index of size, -1 if it is not pooled
+inline int size_class(int size, int *class_size){
+	if(size > BufferPool::MAX_SIZE){
+		return -1;
+	}
+	int idx = 0;
+	int n = BufferPool::MIN_SIZE;
+	while(n < size){
+		n <<= 1;
+		idx ++;
+	}
+	*class_size = n;
+	return idx;
+}
+
+// number of blocks of class idx fitting in bytes, at least 1
+inline int class_limit(int idx, int bytes){
+	int n = bytes / (BufferPool::MIN_SIZE << idx);
+	return n > 0? n : 1;
+}
+
+struct SharedPool{
+	std::mutex mutex;
+	std::vector<char *> blocks[NUM_CLASSES];
+};
+
+// never destroyed, threads exiting during process shutdown still return blocks to it
+SharedPool* shared_pool(){
+	static SharedPool *pool = new SharedPool();
+	return pool;
+}
+
+// move blocks into the shared pool, free what exceeds its cap
+void release(int idx, char **blocks, int num){
+	int class_size = BufferPool::MIN_SIZE << idx;
+	int limit = class_limit(idx, BufferPool::SHARED_POOL_BYTES);
+	SharedPool *pool = shared_pool();
+	int i = 0;
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		std::vector<char *> &shared = pool->blocks[idx];
+		for(; i < num && (int)shared.size() < limit; i++){
+			shared.push_back(blocks[i]);
+		}
+	}
+	for(; i < num; i++){
+		::free(blocks[i]);
+		count(g_cached, -class_size);
+	}
+}
+
+struct ThreadCache{
+	std::vector<char *> blocks[NUM_CLASSES];
+
+	~ThreadCache();
+
+	void clear(){
+		for(int idx=0; idx<NUM_CLASSES; idx++){
+			std::vector<char *> &local = blocks[idx];
+			if(!local.empty()){
+				release(idx, &local[0], (int)local.size());
+				local.clear();
+			}
+		}
+	}
+};
+
+thread_local ThreadCache t_cache;
+// set once t_cache is destroyed, Buffers freed later on this thread
+// (static objects at exit) go to the shared pool
+thread_local bool t_cache_gone = false;
+
+ThreadCache::~ThreadCache(){
+	this->clear();
+	t_cache_gone = true;
+}
+
+}; // namespace
+
+char* BufferPool::alloc(int *size){
+	int class_size = 0;
+	int idx = g_enabled.load(std::memory_order_relaxed)? size_class(*size, &class_size) : -1;
+	if(idx == -1){
+		char *p = (char *)malloc(*size);
+		count(g_mallocs, 1);
+		if(p){
+			count(g_in_use, *size);
+		}
+		return p;
+	}
+	*size = class_size;
+
+	char *p = NULL;
+	if(t_cache_gone){
+		SharedPool *pool = shared_pool();
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		std::vector<char *> &shared = pool->blocks[idx];
+		if(!shared.empty()){
+			p = shared.back();
+			shared.pop_back();
+			count(g_shared_hits, 1);
+		}
+	}else if(!t_cache.blocks[idx].empty()){
+		std::vector<char *> &local = t_cache.blocks[idx];
+		p = local.back();
+		local.pop_back();
+		count(g_thread_hits, 1);
+	}else{
+		// take a batch, so the next allocations skip the lock
+		std::vector<char *> &local = t_cache.blocks[idx];
+		SharedPool *pool = shared_pool();
+		int batch = class_limit(idx, THREAD_CACHE_BYTES) / 2 + 1;
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		std::vector<char *> &shared = pool->blocks[idx];
+		while(!shared.empty() && batch-- > 0){
+			local.push_back(shared.back());
+			shared.pop_back();
+		}
+		if(!local.empty()){
+			p = local.back();
+			local.pop_back();
+			count(g_shared_hits, 1);
+		}
+	}
+	if(p){
+		count(g_cached, -class_size);
+	}else{
+		p = (char *)malloc(class_size);
+		count(g_mallocs, 1);
+		if(p == NULL){
+			return NULL;
+		}
+	}
+	count(g_in_use, class_size);
+	return p;
+}
+
+void BufferPool::free(char *p, int size){
+	if(p == NULL){
+		return;
+	}
+	count(g_in_use, -size);
+	int class_size = 0;
+	int idx = g_enabled.load(std::memory_order_relaxed)? size_class(size, &class_size) : -1;
+	if(idx == -1 || class_size != size){
+		::free(p);
+		return;
+	}
+	count(g_cached, size);
+	if(t_cache_gone){
+		release(idx, &p, 1);
+		return;
+	}
+
+	std::vector<char *> &local = t_cache.blocks[idx];
+	local.push_back(p);
+	int limit = class_limit(idx, THREAD_CACHE_BYTES);
+	if((int)local.size() > limit){
+		// hand half of the cache over, so a producer thread keeps feeding consumers
+		int num = (int)local.size() - limit / 2;
+		release(idx, &local[local.size() - num], num);
+		local.resize(local.size() - num);
+	}
+}
+
+void BufferPool::enable(bool on){
+	g_enabled.store(on);
+}
+
+bool BufferPool::enabled(){
+	return g_enabled.load();
+}
+
+BufferPoolStats BufferPool::get_stats(){
+	BufferPoolStats st;
+	st.in_use = g_in_use.n.load();
+	st.cached = g_cached.n.load();
+	st.thread_hits = g_thread_hits.n.load();
+	st.shared_hits = g_shared_hits.n.load();
+	st.mallocs = g_mallocs.n.load();
+	st.allocs = st.thread_hits + st.shared_hits + st.mallocs;
+	return st;
+}
+
+std::string BufferPool::stats(){
+	BufferPoolStats st = get_stats();
+	char str[256];
+	snprintf(str, sizeof(str),
+		"in_use: %" PRId64 ", cached: %" PRId64 ", allocs: %" PRId64
+		", thread_hits: %" PRId64 ", shared_hits: %" PRId64 ", mallocs: %" PRId64,
+		st.in_use, st.cached, st.allocs, st.thread_hits, st.shared_hits, st.mallocs);
+	return std::string(str);
+}
+
+void BufferPool::trim(){
+	if(!t_cache_gone){
+		t_cache.clear();
+	}
+	SharedPool *pool = shared_pool();
+	std::lock_guard<std::mutex> lock(pool->mutex);
+	for(int idx=0; idx<NUM_CLASSES; idx++){
+		std::vector<char *> &shared = pool->blocks[idx];
+		for(int i=0; i<(int)shared.size(); i++){
+			::free(shared[i]);
+			count(g_cached, -(BufferPool::MIN_SIZE << idx));
+		}
+		shared.clear();
+	}
+}
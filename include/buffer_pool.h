@@ -0,0 +1,51 @@
+#ifndef UTIL_BUFFER_POOL_H_
+#define UTIL_BUFFER_POOL_H_
+
+#include <inttypes.h>
+#include <string>
+
+struct BufferPoolStats{
+	int64_t in_use;      // bytes handed out to Buffers
+	int64_t cached;      // bytes kept in thread caches and the shared pool
+	int64_t allocs;
+	int64_t thread_hits; // served from the calling thread's cache
+	int64_t shared_hits; // served from the shared pool
+	int64_t mallocs;     // fell through to malloc()
+};
+
+/**
+ * Memory for Buffer, in power-of-two size classes from MIN_SIZE to MAX_SIZE.
+ *
+ * Freed blocks go to a small per-thread cache first, then to a shared pool
+ * guarded by a mutex, both capped in bytes per size class, beyond which
+ * blocks are returned to malloc. Requests larger than MAX_SIZE are not pooled.
+ * A block may be freed by a thread other than the one that allocated it.
+ */
+class BufferPool{
+	public:
+		const static int MIN_SIZE = 1024;
+		const static int MAX_SIZE = 8 * 1024 * 1024;
+		// cap per size class, at least one block is always kept
+		const static int THREAD_CACHE_BYTES = 512 * 1024;
+		const static int SHARED_POOL_BYTES = 4 * 1024 * 1024;
+
+		/**
+		 * *size is rounded up to the size class, the caller owns that many bytes.
+		 * return NULL if out of memory.
+		 */
+		static char* alloc(int *size);
+		// size must be the value alloc() stored
+		static void free(char *p, int size);
+
+		// disabled, alloc() and free() go straight to malloc(), for debugging
+		// with memory checkers. Only change it while no Buffer exists.
+		static void enable(bool on);
+		static bool enabled();
+
+		static BufferPoolStats get_stats();
+		static std::string stats();
+		// release the calling thread's cache and the shared pool
+		static void trim();
+};
+
+#endif
@@ -20,11 +20,15 @@ found in the LICENSE file.
 #endif
 
 #include "link.h"
+#include "ssdb_scan.h"
 
 #include "link_redis.cpp"
+#include "link_codec.cpp"
+#include "link_capture.cpp"
 
 #define INIT_BUFFER_SIZE  1024
-#define BEST_BUFFER_SIZE  (8 * 1024)
+
+static std::atomic<LinkCapture *> default_capture(NULL);
 
 
 Link::Link(bool is_server){
@@ -36,6 +40,14 @@ Link::Link(bool is_server){
 #endif
 
 	redis = NULL;
+	codec_ = NULL;
+	capture_ = NULL;
+	capture_id_ = 0;
+	stream_index_ = 0;
+	stream_skip_ = false;
+	stream_offset_ = 0;
+	input_policy_ = NULL;
+	output_policy_ = NULL;
 
 	sock = -1;
 	noblock_ = false;
@@ -50,6 +62,8 @@ Link::Link(bool is_server){
 	}else{
 		input = new Buffer(INIT_BUFFER_SIZE);
 		output = new Buffer(INIT_BUFFER_SIZE);
+		this->buffer_policy(AdaptiveBufferPolicy());
+		this->capture(default_capture.load());
 	}
 }
 
@@ -63,9 +77,85 @@ Link::~Link(){
 	if(output){
 		delete output;
 	}
+	delete input_policy_;
+	delete output_policy_;
+	delete codec_;
 	this->close();
 }
 
+void Link::buffer_policy(const BufferPolicy &policy){
+	if(input == NULL){
+		return;
+	}
+	delete input_policy_;
+	delete output_policy_;
+	input_policy_ = policy.clone();
+	output_policy_ = policy.clone();
+	input->policy(input_policy_);
+	output->policy(output_policy_);
+}
+
+std::string Link::buffer_stats() const{
+	if(input == NULL){
+		return std::string();
+	}
+	return "input: {" + input->stats() + ", " + input_policy_->stats() + "}, "
+		+ "output: {" + output->stats() + ", " + output_policy_->stats() + "}";
+}
+
+void Link::codec(const LinkCodec &codec){
+	delete codec_;
+	codec_ = codec.clone();
+}
+
+void Link::capture(LinkCapture *capture){
+	capture_ = capture;
+	capture_id_ = capture? capture->attach() : 0;
+}
+
+void Link::capture_all(LinkCapture *capture){
+	default_capture.store(capture);
+}
+
+// split the ssdb packet at the start of data into fields, return its
+// length with the empty line ending it, -1 if data holds no whole packet
+static int split_packet(const char *data, int size, std::vector<Bytes> *fields){
+	fields->clear();
+	const char *p = data;
+	int left = size;
+	while(left > 0){
+		if(p[0] == '\n'){
+			return size - left + 1;
+		}
+		if(p[0] == '\r'){
+			return (left >= 2 && p[1] == '\n')? size - left + 2 : -1;
+		}
+		int body_len;
+		int head_len = parse_header(p, left, &body_len);
+		if(head_len <= 0 || body_len >= left - head_len){
+			return -1;
+		}
+		int len = head_len + body_len;
+		if(p[len] == '\r'){
+			len += 1;
+		}
+		if(left <= len || p[len] != '\n'){
+			return -1;
+		}
+		fields->push_back(Bytes(p + head_len, body_len));
+		p += len + 1;
+		left -= len + 1;
+	}
+	return -1;
+}
+
+int Link::encode(const Bytes *fields, int num){
+	if(codec_->encode(output, fields, num) == -1){
+		return -1;
+	}
+	return 0;
+}
+
 void Link::close(){
 	if(sock >= 0){
 #if defined(_WIN232)
@@ -252,8 +342,11 @@ int Link::read(){
 	input->nice();
 	// 由于 recv() 返回的数据是指向 input 所占的内存, 所以, 不能在 recv()
 	// 之后立即就释放内存, 只能在下一次read()的时候再释放.
-	if(input->size() == 0 && input->total() > BEST_BUFFER_SIZE){
-		input->shrink(BEST_BUFFER_SIZE);
+	if(input->size() == 0){
+		int total = input_policy_->drained(input->total());
+		if(total > 0){
+			input->shrink(total);
+		}
 	}
 	
 	while((want = input->space()) > 0){
@@ -286,6 +379,7 @@ int Link::read(){
 			break;
 		}
 	}
+	input_policy_->observe(input->size());
 	//log_debug("read %d", ret);
 	//printf("%s\n", hexmem(input->data(), input->size()).c_str());
 	return ret;
@@ -294,6 +388,7 @@ int Link::read(){
 int Link::write(){
 	int ret = 0;
 	int want;
+	output_policy_->observe(output->size());
 	while((want = output->size()) > 0){
 		// test
 		//want = 1;
@@ -325,8 +420,11 @@ int Link::write(){
 		}
 	}
 	output->nice();
-	if(output->size() == 0 && output->total() > BEST_BUFFER_SIZE){
-		output->shrink(BEST_BUFFER_SIZE);
+	if(output->size() == 0){
+		int total = output_policy_->drained(output->total());
+		if(total > 0){
+			output->shrink(total);
+		}
 	}
 	return ret;
 }
@@ -350,117 +448,204 @@ const std::vector<Bytes>* Link::recv(){
 		return &this->recv_data;
 	}
 
-	// TODO: 记住上回的解析状态
-	int parsed = 0;
-	int size = input->size();
-	char *head = input->data();
-
-	// ignore leading empty lines
-	while(size > 0 && (head[0] == '\n' || head[0] == '\r')){
-		head ++;
-		size --;
-		parsed ++;
+	int ret;
+	if(codec_){
+		ret = codec_->decode(input, &this->recv_data);
+	}else{
+		int size = input->size();
+		char *head = input->data();
+		// ignore leading empty lines
+		while(size > 0 && (head[0] == '\n' || head[0] == '\r')){
+			head ++;
+			size --;
+		}
+		// Redis protocol supports
+		if(size > 0 && head[0] == '*'){
+			if(redis == NULL){
+				redis = new RedisLink();
+			}
+			const std::vector<Bytes> *ret = redis->recv_req(input);
+			if(ret){
+				this->recv_data = *ret;
+				if(capture_ && !recv_data.empty()){
+					this->captured(LinkCapture::RECV, &recv_data[0], (int)recv_data.size());
+				}
+				return &this->recv_data;
+			}else{
+				return NULL;
+			}
+		}
+		// TODO: 记住上回的解析状态
+		ret = SsdbCodec::parse(input, &this->recv_data);
 	}
-	
-	// Redis protocol supports
-	if(head[0] == '*'){
-		if(redis == NULL){
-			redis = new RedisLink();
-		}
-		const std::vector<Bytes> *ret = redis->recv_req(input);
-		if(ret){
-			this->recv_data = *ret;
-			return &this->recv_data;
-		}else{
-			return NULL;
+	if(ret == -1){
+		//log_warn("bad format");
+		return NULL;
+	}
+	if(ret == 1){
+		if(capture_ && !recv_data.empty()){
+			this->captured(LinkCapture::RECV, &recv_data[0], (int)recv_data.size());
 		}
+		return &this->recv_data;
 	}
 
-	while(size > 0){
-		char *body = (char *)memchr(head, '\n', size);
-		if(body == NULL){
-			break;
+	if(input->space() == 0){
+		input->nice();
+		if(input->space() == 0){
+			if(input->grow() == -1){
+				//log_error("fd: %d, unable to resize input buffer!", this->sock);
+				return NULL;
+			}
+			//log_debug("fd: %d, resize input buffer, %s", this->sock, input->stats().c_str());
 		}
-		body ++;
+	}
 
-		int head_len = body - head;
-		if(head_len == 1 || (head_len == 2 && head[0] == '\r')){
-			// packet end
-			parsed += head_len;
-			input->decr(parsed);
-			return &this->recv_data;;
+	// not ready
+	this->recv_data.clear();
+	return &this->recv_data;
+}
+
+int Link::recv_stream(FieldHandler *handler){
+	if(codec_){
+		// a codec hands out whole packets
+		const std::vector<Bytes> *packet = this->recv();
+		if(packet == NULL){
+			return -1;
 		}
-		if(head[0] < '0' || head[0] > '9'){
-			//log_warn("bad format");
-			return NULL;
+		if(packet->empty()){
+			return 0;
 		}
-
-		char head_str[20];
-		if(head_len > (int)sizeof(head_str) - 1){
-			return NULL;
+		for(int i=0; i<(int)packet->size(); i++){
+			if(handler->field(i, packet->at(i)) == -1){
+				break;
+			}
+		}
+		return 1;
+	}
+	while(1){
+		int size = input->size() - stream_offset_;
+		char *head = input->data() + stream_offset_;
+
+		if(stream_index_ == 0){
+			// ignore leading empty lines
+			int skip = 0;
+			while(skip < size && (head[skip] == '\n' || head[skip] == '\r')){
+				skip ++;
+			}
+			input->decr(skip);
+			size -= skip;
+			head += skip;
+		}
+		if(size == 0){
+			break;
 		}
-		memcpy(head_str, head, head_len - 1); // no '\n'
-		head_str[head_len - 1] = '\0';
 
-		int body_len = atoi(head_str);
-		if(body_len < 0){
-			//log_warn("bad format");
-			return NULL;
+		if(head[0] == '\n' || head[0] == '\r'){
+			int end_len = (head[0] == '\n')? 1 : 2;
+			if(size < end_len){
+				break;
+			}
+			if(end_len == 2 && head[1] != '\n'){
+				return -1;
+			}
+			// packet end
+			int len = stream_offset_ + end_len;
+			if(capture_ && split_packet(input->data(), len, &codec_args_) == len){
+				capture_->record(capture_id_, LinkCapture::RECV,
+					codec_args_.empty()? NULL : &codec_args_[0], (int)codec_args_.size());
+			}
+			input->decr(len);
+			stream_offset_ = 0;
+			stream_index_ = 0;
+			stream_skip_ = false;
+			return 1;
 		}
-		//log_debug("size: %d, head_len: %d, body_len: %d", size, head_len, body_len);
-		size -= head_len + body_len;
-		if(size < 0){
+
+		int body_len;
+		int head_len = parse_header(head, size, &body_len);
+		if(head_len == 0){
 			break;
 		}
+		if(head_len == -1 || body_len > MAX_PACKET_SIZE){
+			return -1;
+		}
+		char *body = head + head_len;
 
-		this->recv_data.push_back(Bytes(body, body_len));
-
-		head += head_len + body_len;
-		parsed += head_len + body_len;
-		if(size >= 1 && head[0] == '\n'){
-			head += 1;
-			size -= 1;
-			parsed += 1;
-		}else if(size >= 2 && head[0] == '\r' && head[1] == '\n'){
-			head += 2;
-			size -= 2;
-			parsed += 2;
-		}else if(size >= 2){
-			// bad format
-			return NULL;
-		}else{
+		int len = head_len + body_len;
+		if(size < len + 1){
 			break;
 		}
-		if(parsed > MAX_PACKET_SIZE){
-			 //log_warn("fd: %d, exceed max packet size, parsed: %d", this->sock, parsed);
-			 return NULL;
+		if(head[len] == '\n'){
+			len += 1;
+		}else if(head[len] == '\r'){
+			if(size < len + 2){
+				break;
+			}
+			if(head[len + 1] != '\n'){
+				return -1;
+			}
+			len += 2;
+		}else{
+			return -1;
+		}
+
+		if(!stream_skip_){
+			if(handler->field(stream_index_, Bytes(body, body_len)) == -1){
+				stream_skip_ = true;
+			}
+		}
+		stream_index_ ++;
+		if(capture_){
+			// recorded from input when the response is complete
+			stream_offset_ += len;
+		}else{
+			input->decr(len);
 		}
 	}
 
+	// every complete field is consumed, only a partial one is left
 	if(input->space() == 0){
-		input->nice();
+		input->compact();
 		if(input->space() == 0){
 			if(input->grow() == -1){
-				//log_error("fd: %d, unable to resize input buffer!", this->sock);
-				return NULL;
+				return -1;
 			}
-			//log_debug("fd: %d, resize input buffer, %s", this->sock, input->stats().c_str());
 		}
 	}
+	return 0;
+}
 
-	// not ready
-	this->recv_data.clear();
-	return &this->recv_data;
+int Link::response_stream(FieldHandler *handler){
+	while(1){
+		int ret = this->recv_stream(handler);
+		if(ret != 0){
+			return ret;
+		}
+		if(this->read() <= 0){
+			return -1;
+		}
+	}
+	return -1;
 }
 
 int Link::send(const std::vector<std::string> &resp){
 	if(resp.empty()){
 		return 0;
 	}
+	if(capture_){
+		capture_->record(capture_id_, LinkCapture::SEND, &resp[0], (int)resp.size());
+	}
 	// Redis protocol supports
 	if(this->redis){
 		return this->redis->send_resp(this->output, resp);
 	}
+	if(codec_){
+		codec_args_.clear();
+		for(int i=0; i<resp.size(); i++){
+			codec_args_.push_back(Bytes(resp[i]));
+		}
+		return this->encode(&codec_args_[0], (int)codec_args_.size());
+	}
 	
 	for(int i=0; i<resp.size(); i++){
 		output->append_record(resp[i]);
@@ -470,6 +655,12 @@ int Link::send(const std::vector<std::string> &resp){
 }
 
 int Link::send(const std::vector<Bytes> &resp){
+	if(capture_ && !resp.empty()){
+		this->captured(LinkCapture::SEND, &resp[0], (int)resp.size());
+	}
+	if(codec_){
+		return resp.empty()? 0 : this->encode(&resp[0], (int)resp.size());
+	}
 	for(int i=0; i<resp.size(); i++){
 		output->append_record(resp[i]);
 	}
@@ -478,12 +669,26 @@ int Link::send(const std::vector<Bytes> &resp){
 }
 
 int Link::send(const Bytes &s1){
+	if(capture_){
+		this->captured(LinkCapture::SEND, &s1, 1);
+	}
+	if(codec_){
+		return this->encode(&s1, 1);
+	}
 	output->append_record(s1);
 	output->append('\n');
 	return 0;
 }
 
 int Link::send(const Bytes &s1, const Bytes &s2){
+	if(capture_){
+		Bytes args[] = {s1, s2};
+		this->captured(LinkCapture::SEND, args, 2);
+	}
+	if(codec_){
+		Bytes args[] = {s1, s2};
+		return this->encode(args, 2);
+	}
 	output->append_record(s1);
 	output->append_record(s2);
 	output->append('\n');
@@ -491,6 +696,14 @@ int Link::send(const Bytes &s1, const Bytes &s2){
 }
 
 int Link::send(const Bytes &s1, const Bytes &s2, const Bytes &s3){
+	if(capture_){
+		Bytes args[] = {s1, s2, s3};
+		this->captured(LinkCapture::SEND, args, 3);
+	}
+	if(codec_){
+		Bytes args[] = {s1, s2, s3};
+		return this->encode(args, 3);
+	}
 	output->append_record(s1);
 	output->append_record(s2);
 	output->append_record(s3);
@@ -499,6 +712,14 @@ int Link::send(const Bytes &s1, const Bytes &s2, const Bytes &s3){
 }
 
 int Link::send(const Bytes &s1, const Bytes &s2, const Bytes &s3, const Bytes &s4){
+	if(capture_){
+		Bytes args[] = {s1, s2, s3, s4};
+		this->captured(LinkCapture::SEND, args, 4);
+	}
+	if(codec_){
+		Bytes args[] = {s1, s2, s3, s4};
+		return this->encode(args, 4);
+	}
 	output->append_record(s1);
 	output->append_record(s2);
 	output->append_record(s3);
@@ -508,6 +729,14 @@ int Link::send(const Bytes &s1, const Bytes &s2, const Bytes &s3, const Bytes &s
 }
 
 int Link::send(const Bytes &s1, const Bytes &s2, const Bytes &s3, const Bytes &s4, const Bytes &s5){
+	if(capture_){
+		Bytes args[] = {s1, s2, s3, s4, s5};
+		this->captured(LinkCapture::SEND, args, 5);
+	}
+	if(codec_){
+		Bytes args[] = {s1, s2, s3, s4, s5};
+		return this->encode(args, 5);
+	}
 	output->append_record(s1);
 	output->append_record(s2);
 	output->append_record(s3);
@@ -517,6 +746,35 @@ int Link::send(const Bytes &s1, const Bytes &s2, const Bytes &s3, const Bytes &s
 	return 0;
 }
 
+int Link::send_packet(const char *data, int size){
+	if(codec_ || capture_){
+		int len = split_packet(data, size, &codec_args_);
+		if(codec_ && (len != size || codec_args_.empty())){
+			return -1;
+		}
+		if(capture_ && len > 0 && !codec_args_.empty()){
+			this->captured(LinkCapture::SEND, &codec_args_[0], (int)codec_args_.size());
+		}
+		if(codec_){
+			return this->encode(&codec_args_[0], (int)codec_args_.size());
+		}
+	}
+	return output->append(data, size) == -1? -1 : 0;
+}
+
+void Link::encode_packet(const std::vector<std::string> &req, std::string *packet){
+	// uint64_to_str writes up to 20 digits, plus the '\n'
+	char len[21];
+	for(int i=0; i<(int)req.size(); i++){
+		int num = uint64_to_str(len, (uint64_t)req[i].size());
+		len[num++] = '\n';
+		packet->append(len, num);
+		packet->append(req[i]);
+		packet->push_back('\n');
+	}
+	packet->push_back('\n');
+}
+
 const std::vector<Bytes>* Link::response(){
 	while(1){
 		const std::vector<Bytes> *resp = this->recv();
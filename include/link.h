@@ -19,8 +19,19 @@ found in the LICENSE file.
 #endif
 
 #include "ssdb_bytes.h"
+#include "buffer_policy.h"
 
 #include "link_redis.h"
+#include "link_codec.h"
+#include "link_capture.h"
+
+// Receives the fields of a response one at a time, see Link::recv_stream().
+class FieldHandler{
+	public:
+		virtual ~FieldHandler(){}
+		// data is only valid during the call, return -1 to skip the remaining fields
+		virtual int field(int index, const Bytes &data) = 0;
+};
 
 class Link{
 	private:
@@ -28,8 +39,23 @@ class Link{
 		bool noblock_;
 		bool error_;
 		std::vector<Bytes> recv_data;
+		int stream_index_;
+		bool stream_skip_;
+		BufferPolicy *input_policy_;
+		BufferPolicy *output_policy_;
+		LinkCodec *codec_;
+		// fields of a packet being encoded or recorded
+		std::vector<Bytes> codec_args_;
+		LinkCapture *capture_;
+		int capture_id_;
+		// bytes of the response being streamed, held in input for capture_
+		int stream_offset_;
 
 		RedisLink *redis;
+		int encode(const Bytes *fields, int num);
+		void captured(int dir, const Bytes *fields, int num){
+			capture_->record(capture_id_, dir, fields, num);
+		}
 	public:
 		const static int MAX_PACKET_SIZE = 128 * 1024 * 1024;
 
@@ -53,6 +79,30 @@ class Link{
 		// otherwise, flush() may cause a lot unneccessary write calls.
 		void noblock(bool enable=true);
 		void keepalive(bool enable=true);
+		/**
+		 * replace the sizing policy of input and output buffers by copies
+		 * of policy, AdaptiveBufferPolicy by default.
+		 */
+		void buffer_policy(const BufferPolicy &policy);
+		std::string buffer_stats() const;
+		/**
+		 * speak the protocol of a copy of codec to the server, requests
+		 * are encoded and responses parsed by it, NULL for the ssdb
+		 * protocol, which also accepts Redis requests on the server side.
+		 */
+		void codec(const LinkCodec &codec);
+		const LinkCodec* codec() const{
+			return codec_;
+		}
+		/**
+		 * record every packet sent and received into capture, which must
+		 * outlive the link, NULL to stop recording.
+		 */
+		void capture(LinkCapture *capture);
+		/**
+		 * links created from now on record into capture, NULL for none.
+		 */
+		static void capture_all(LinkCapture *capture);
 
 		int fd() const{
 			return sock;
@@ -85,6 +135,19 @@ class Link{
 		// wait until a response received.
 		const std::vector<Bytes>* response();
 
+		/**
+		 * parse received data, hand every completed field to handler and
+		 * release its buffer space at once, so a huge response only needs
+		 * room for its largest field, or for all of it while capturing,
+		 * return -
+		 * -1: error
+		 * 0: response not complete, read more
+		 * 1: response complete
+		 */
+		int recv_stream(FieldHandler *handler);
+		// wait until a response received, streaming its fields.
+		int response_stream(FieldHandler *handler);
+
 		// need to call flush to ensure all data has flush into network
 		int send(const std::vector<std::string> &packet);
 		int send(const std::vector<Bytes> &packet);
@@ -93,6 +156,13 @@ class Link{
 		int send(const Bytes &s1, const Bytes &s2, const Bytes &s3);
 		int send(const Bytes &s1, const Bytes &s2, const Bytes &s3, const Bytes &s4);
 		int send(const Bytes &s1, const Bytes &s2, const Bytes &s3, const Bytes &s4, const Bytes &s5);
+		/**
+		 * append a request already encoded in the ssdb protocol, a link
+		 * with a codec re-encodes it, -1 if it is not a single request.
+		 */
+		int send_packet(const char *data, int size);
+		// append req to packet, encoded in the ssdb protocol
+		static void encode_packet(const std::vector<std::string> &req, std::string *packet);
 
 		const std::vector<Bytes>* last_recv(){
 			return &recv_data;
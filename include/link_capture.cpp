@@ -0,0 +1,198 @@
+#include <string.h>
+#include <chrono>
+#include "link_capture.h"
+
+static const char CAPTURE_MAGIC[] = "SSDBCAP1";
+// wake the writer early once this much is buffered
+static const int CAPTURE_FLUSH_SIZE = 256 * 1024;
+static const int CAPTURE_MAX_FIELD = 128 * 1024 * 1024;
+
+static int64_t capture_time_us(){
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void put_varint(std::string *buf, uint64_t v){
+	char tmp[10];
+	int n = 0;
+	while(v >= 0x80){
+		tmp[n++] = (char)(v | 0x80);
+		v >>= 7;
+	}
+	tmp[n++] = (char)v;
+	buf->append(tmp, n);
+}
+
+template<class T>
+static void put_fields(std::string *buf, const T *fields, int num){
+	for(int i=0; i<num; i++){
+		put_varint(buf, (uint64_t)fields[i].size());
+		buf->append(fields[i].data(), fields[i].size());
+	}
+}
+
+LinkCapture::LinkCapture(FILE *fp, int64_t max_buffer) : next_id(0), frames_(0), dropped_(0){
+	this->fp = fp;
+	this->max_buffer = max_buffer;
+	this->last_time = capture_time_us();
+	this->stop = false;
+	this->thread = std::thread(&LinkCapture::run, this);
+}
+
+LinkCapture::~LinkCapture(){
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stop = true;
+	}
+	cond.notify_one();
+	thread.join();
+	fclose(fp);
+}
+
+LinkCapture* LinkCapture::open(const char *path, int64_t max_buffer){
+	FILE *fp = fopen(path, "wb");
+	if(fp == NULL){
+		return NULL;
+	}
+	if(fwrite(CAPTURE_MAGIC, 1, 8, fp) != 8){
+		fclose(fp);
+		return NULL;
+	}
+	return new LinkCapture(fp, max_buffer);
+}
+
+void LinkCapture::run(){
+	std::string out;
+	std::unique_lock<std::mutex> lock(mutex);
+	while(1){
+		bool last = stop;
+		if(!last && (int)buffer.size() < CAPTURE_FLUSH_SIZE){
+			cond.wait_for(lock, std::chrono::milliseconds(100));
+		}
+		out.swap(buffer);
+		lock.unlock();
+		if(!out.empty()){
+			fwrite(out.data(), 1, out.size(), fp);
+			fflush(fp);
+			out.clear();
+		}
+		lock.lock();
+		if(last && buffer.empty()){
+			break;
+		}
+	}
+}
+
+// REQUIRES: mutex held
+void LinkCapture::put_frame(int link_id, int dir, int num){
+	int64_t now = capture_time_us();
+	int64_t delta = now > last_time? now - last_time : 0;
+	last_time += delta;
+	put_varint(&buffer, (uint64_t)delta);
+	put_varint(&buffer, (uint64_t)link_id);
+	buffer.push_back((char)dir);
+	put_varint(&buffer, (uint64_t)num);
+}
+
+template<class T>
+void LinkCapture::put(int link_id, int dir, const T *fields, int num){
+	std::unique_lock<std::mutex> lock(mutex);
+	if((int64_t)buffer.size() >= max_buffer){
+		dropped_ ++;
+		return;
+	}
+	this->put_frame(link_id, dir, num);
+	put_fields(&buffer, fields, num);
+	frames_ ++;
+	if((int)buffer.size() >= CAPTURE_FLUSH_SIZE){
+		cond.notify_one();
+	}
+}
+
+void LinkCapture::record(int link_id, int dir, const Bytes *fields, int num){
+	this->put(link_id, dir, fields, num);
+}
+
+void LinkCapture::record(int link_id, int dir, const std::string *fields, int num){
+	this->put(link_id, dir, fields, num);
+}
+
+
+CaptureReader::CaptureReader(){
+	fp = NULL;
+	time_ = 0;
+}
+
+CaptureReader::~CaptureReader(){
+	if(fp){
+		fclose(fp);
+	}
+}
+
+int CaptureReader::open(const char *path){
+	fp = fopen(path, "rb");
+	if(fp == NULL){
+		return -1;
+	}
+	char magic[8];
+	if(fread(magic, 1, 8, fp) != 8 || memcmp(magic, CAPTURE_MAGIC, 8) != 0){
+		fclose(fp);
+		fp = NULL;
+		return -1;
+	}
+	time_ = 0;
+	return 0;
+}
+
+// 0 at the end of the file
+int CaptureReader::get_varint(uint64_t *v){
+	*v = 0;
+	for(int shift=0; shift<64; shift+=7){
+		int c = fgetc(fp);
+		if(c == EOF){
+			return shift == 0? 0 : -1;
+		}
+		*v |= (uint64_t)(c & 0x7f) << shift;
+		if((c & 0x80) == 0){
+			return 1;
+		}
+	}
+	return -1;
+}
+
+int CaptureReader::next(Frame *frame){
+	if(fp == NULL){
+		return -1;
+	}
+	uint64_t delta, link_id, num, len;
+	int ret = this->get_varint(&delta);
+	if(ret != 1){
+		return ret;
+	}
+	if(this->get_varint(&link_id) != 1){
+		return -1;
+	}
+	int dir = fgetc(fp);
+	if(dir != LinkCapture::SEND && dir != LinkCapture::RECV){
+		return -1;
+	}
+	if(this->get_varint(&num) != 1 || num > CAPTURE_MAX_FIELD){
+		return -1;
+	}
+	time_ += (int64_t)delta;
+	frame->time = time_;
+	frame->link_id = (int)link_id;
+	frame->dir = dir;
+	frame->fields.resize((size_t)num);
+	for(int i=0; i<(int)num; i++){
+		if(this->get_varint(&len) != 1 || len > CAPTURE_MAX_FIELD){
+			return -1;
+		}
+		std::string &field = frame->fields[i];
+		field.resize((size_t)len);
+		if(len > 0 && fread(&field[0], 1, (size_t)len, fp) != len){
+			return -1;
+		}
+	}
+	return 1;
+}
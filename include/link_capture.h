@@ -0,0 +1,110 @@
+#ifndef NET_LINK_CAPTURE_H_
+#define NET_LINK_CAPTURE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ssdb_bytes.h"
+
+/**
+ * Records the packets links send and receive into a capture file, for
+ * ssdb_replay to play the same traffic back later.
+ *
+ * A link only encodes a frame into a memory buffer under a lock, a
+ * background thread writes the buffer to the file. While the file falls
+ * more than max_buffer behind, frames are dropped and counted rather
+ * than slowing the links down.
+ *
+ * The file starts with "SSDBCAP1", followed by frames of
+ *     varint  microseconds since the previous frame
+ *     varint  link id
+ *     byte    SEND or RECV
+ *     varint  number of fields
+ *     varint  length and the bytes of every field
+ */
+class LinkCapture{
+	private:
+		FILE *fp;
+		int64_t max_buffer;
+		int64_t last_time;
+		std::atomic<int> next_id;
+		std::atomic<int64_t> frames_;
+		std::atomic<int64_t> dropped_;
+		std::string buffer;
+		bool stop;
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::thread thread;
+
+		LinkCapture(FILE *fp, int64_t max_buffer);
+		void run();
+		void put_frame(int link_id, int dir, int num);
+		template<class T>
+		void put(int link_id, int dir, const T *fields, int num);
+		// No copying allowed
+		LinkCapture(const LinkCapture&);
+		void operator=(const LinkCapture&);
+	public:
+		enum{
+			SEND = 0,
+			RECV = 1
+		};
+
+		/**
+		 * Start a capture into the file at path, NULL if it can't be created.
+		 */
+		static LinkCapture* open(const char *path, int64_t max_buffer=64 * 1024 * 1024);
+		// writes out the frames buffered and closes the file
+		~LinkCapture();
+
+		// a new id for a link recording into this capture
+		int attach(){
+			return ++next_id;
+		}
+		void record(int link_id, int dir, const Bytes *fields, int num);
+		void record(int link_id, int dir, const std::string *fields, int num);
+
+		int64_t frames() const{
+			return frames_.load();
+		}
+		int64_t dropped() const{
+			return dropped_.load();
+		}
+};
+
+/**
+ * Reads the frames of a capture file in the order they were recorded.
+ */
+class CaptureReader{
+	private:
+		FILE *fp;
+		int64_t time_;
+		int get_varint(uint64_t *v);
+	public:
+		struct Frame{
+			// microseconds since the capture was started
+			int64_t time;
+			int link_id;
+			int dir;
+			std::vector<std::string> fields;
+		};
+
+		CaptureReader();
+		~CaptureReader();
+		// -1 if the file is missing or not a capture
+		int open(const char *path);
+		/**
+		 * @return
+		 * 1: frame filled
+		 * 0: end of file
+		 * -1: the file is truncated or corrupt
+		 */
+		int next(Frame *frame);
+};
+
+#endif
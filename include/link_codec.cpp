@@ -0,0 +1,362 @@
+#include "link_codec.h"
+#include "link.h"
+#include "ssdb_scan.h"
+
+/******************** ssdb *************************/
+
+int SsdbCodec::encode(Buffer *output, const Bytes *fields, int num){
+	for(int i=0; i<num; i++){
+		if(output->append_record(fields[i]) == -1){
+			return -1;
+		}
+	}
+	return output->append('\n');
+}
+
+int SsdbCodec::decode(Buffer *input, std::vector<Bytes> *packet){
+	return SsdbCodec::parse(input, packet);
+}
+
+int SsdbCodec::parse(Buffer *input, std::vector<Bytes> *packet){
+	packet->clear();
+
+	int parsed = 0;
+	int size = input->size();
+	char *head = input->data();
+
+	// ignore leading empty lines
+	while(size > 0 && (head[0] == '\n' || head[0] == '\r')){
+		head ++;
+		size --;
+		parsed ++;
+	}
+
+	while(size > 0){
+		if(head[0] == '\n' || head[0] == '\r'){
+			int end_len = (head[0] == '\n')? 1 : 2;
+			if(size < end_len){
+				break;
+			}
+			if(end_len == 2 && head[1] != '\n'){
+				//log_warn("bad format");
+				return -1;
+			}
+			// packet end
+			parsed += end_len;
+			input->decr(parsed);
+			return 1;
+		}
+
+		// the length is parsed in place, no need to search for the newline first
+		int body_len;
+		int head_len = parse_header(head, size, &body_len);
+		if(head_len == 0){
+			break;
+		}
+		if(head_len == -1){
+			//log_warn("bad format");
+			return -1;
+		}
+		char *body = head + head_len;
+		//log_debug("size: %d, head_len: %d, body_len: %d", size, head_len, body_len);
+		size -= head_len + body_len;
+		if(size < 0){
+			break;
+		}
+
+		packet->push_back(Bytes(body, body_len));
+
+		head += head_len + body_len;
+		parsed += head_len + body_len;
+		if(size >= 1 && head[0] == '\n'){
+			head += 1;
+			size -= 1;
+			parsed += 1;
+		}else if(size >= 2 && head[0] == '\r' && head[1] == '\n'){
+			head += 2;
+			size -= 2;
+			parsed += 2;
+		}else if(size >= 2){
+			// bad format
+			return -1;
+		}else{
+			break;
+		}
+		if(parsed > Link::MAX_PACKET_SIZE){
+			 //log_warn("exceed max packet size, parsed: %d", parsed);
+			 return -1;
+		}
+	}
+
+	packet->clear();
+	return 0;
+}
+
+/******************** RESP *************************/
+
+enum{
+	// fields sent as they are
+	RESP_ARGS_SAME,
+	// the 2nd and 3rd arguments swapped: setx key val ttl => SETEX key ttl val
+	RESP_ARGS_SWAP,
+	// name offset limit => name start stop WITHSCORES
+	RESP_ARGS_ZRANGE,
+	// incr key => INCR key, incr key num => INCRBY key num
+	RESP_ARGS_INCR
+};
+
+enum{
+	RESP_REPLY_PLAIN,
+	// values of MGET, paired with the keys from the 2nd field on
+	RESP_REPLY_PAIRS,
+	// values of HMGET, paired with the keys from the 3rd field on
+	RESP_REPLY_HPAIRS
+};
+
+struct RespCommand{
+	const char *ssdb_cmd;
+	const char *redis_cmd;
+	int args;
+	int reply;
+};
+
+static const RespCommand resp_cmds[] = {
+	{"setx",		"setex",		RESP_ARGS_SWAP,		RESP_REPLY_PLAIN},
+	{"incr",		"incrby",		RESP_ARGS_INCR,		RESP_REPLY_PLAIN},
+	{"multi_get",	"mget",			RESP_ARGS_SAME,		RESP_REPLY_PAIRS},
+	{"multi_set",	"mset",			RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"multi_del",	"del",			RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+
+	{"hsize",		"hlen",			RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"hincr",		"hincrby",		RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"multi_hget",	"hmget",		RESP_ARGS_SAME,		RESP_REPLY_HPAIRS},
+	{"multi_hset",	"hmset",		RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"multi_hdel",	"hdel",			RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+
+	{"zget",		"zscore",		RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"zset",		"zadd",			RESP_ARGS_SWAP,		RESP_REPLY_PLAIN},
+	{"zincr",		"zincrby",		RESP_ARGS_SWAP,		RESP_REPLY_PLAIN},
+	{"zdel",		"zrem",			RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"multi_zdel",	"zrem",			RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"zsize",		"zcard",		RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"zrrank",		"zrevrank",		RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"zrange",		"zrange",		RESP_ARGS_ZRANGE,	RESP_REPLY_PLAIN},
+	{"zrrange",		"zrevrange",	RESP_ARGS_ZRANGE,	RESP_REPLY_PLAIN},
+
+	{"qpush",		"rpush",		RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"qpush_back",	"rpush",		RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"qpush_front",	"lpush",		RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"qpop",		"lpop",			RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"qpop_front",	"lpop",			RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"qpop_back",	"rpop",			RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"qsize",		"llen",			RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"qget",		"lindex",		RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"qset",		"lset",			RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+	{"qslice",		"lrange",		RESP_ARGS_SAME,		RESP_REPLY_PLAIN},
+
+	{NULL,			NULL,			0,					0}
+};
+
+static const RespCommand* find_resp_command(const Bytes &cmd){
+	for(const RespCommand *def = resp_cmds; def->ssdb_cmd != NULL; def++){
+		if(cmd == Bytes(def->ssdb_cmd)){
+			return def;
+		}
+	}
+	return NULL;
+}
+
+static inline bool starts_with(const Bytes &s, const char *prefix, int len){
+	return s.size() >= len && memcmp(s.data(), prefix, len) == 0;
+}
+
+int RespCodec::encode(Buffer *output, const Bytes *fields, int num){
+	if(num == 0){
+		return 0;
+	}
+	args_.assign(fields, fields + num);
+	Pending req;
+	req.reply = RESP_REPLY_PLAIN;
+
+	const RespCommand *def = find_resp_command(fields[0]);
+	if(def){
+		args_[0] = Bytes(def->redis_cmd);
+		req.reply = def->reply;
+		if(def->args == RESP_ARGS_SWAP && num == 4){
+			std::swap(args_[2], args_[3]);
+		}else if(def->args == RESP_ARGS_INCR && num == 2){
+			args_[0] = Bytes("incr");
+		}else if(def->args == RESP_ARGS_ZRANGE && num == 4){
+			int64_t offset = fields[2].Int64();
+			int64_t limit = fields[3].Int64();
+			if(limit > 0){
+				buf_ = str(offset + limit - 1);
+				args_[3] = Bytes(buf_);
+			}else{
+				// a stop before the start selects nothing, stop -1 would be the last member
+				args_[2] = Bytes("1");
+				args_[3] = Bytes("0");
+			}
+			args_.push_back(Bytes("withscores"));
+		}
+		int first = (def->reply == RESP_REPLY_PAIRS)? 1 : 2;
+		if(def->reply != RESP_REPLY_PLAIN){
+			for(int i=first; i<num; i++){
+				req.keys.push_back(fields[i].String());
+			}
+		}
+	}
+
+	int size = RespWriter::header_size((int)args_.size());
+	for(int i=0; i<(int)args_.size(); i++){
+		size += RespWriter::bulk_size(args_[i].size());
+	}
+	RespWriter writer;
+	if(writer.reserve(output, size) == -1){
+		return -1;
+	}
+	writer.put_header('*', (int)args_.size());
+	for(int i=0; i<(int)args_.size(); i++){
+		writer.put_bulk(args_[i].data(), args_[i].size());
+	}
+	writer.done();
+
+	pending_.push_back(Pending());
+	pending_.back().reply = req.reply;
+	pending_.back().keys.swap(req.keys);
+	return size;
+}
+
+int RespCodec::decode(Buffer *input, std::vector<Bytes> *packet){
+	packet->clear();
+	nils_.clear();
+	// the status code goes here
+	packet->push_back(Bytes());
+	nils_.push_back(false);
+
+	const char *start = input->data();
+	const char *end = start + input->size();
+	const char *p = start;
+	char type = 0;
+	bool nil = false;
+	// values still to be read, nested arrays are flattened
+	int64_t remaining = 1;
+	while(remaining > 0){
+		if(p == end){
+			return 0;
+		}
+		const char *nl = (const char *)memchr(p, '\n', end - p);
+		if(nl == NULL){
+			return 0;
+		}
+		const char *line = p + 1;
+		int line_len = (int)(nl - line);
+		if(line_len > 0 && line[line_len - 1] == '\r'){
+			line_len --;
+		}
+		p = nl + 1;
+		bool top = (type == 0);
+		if(top){
+			type = line[-1];
+		}
+		remaining --;
+
+		int64_t len;
+		switch(line[-1]){
+			case '+':
+			case '-':
+			case ':':
+				packet->push_back(Bytes(line, line_len));
+				nils_.push_back(false);
+				break;
+			case '$':
+				if(parse_int64(line, line_len, &len) != 0 || len > Link::MAX_PACKET_SIZE){
+					return -1;
+				}
+				if(len < 0){
+					nil = top;
+					packet->push_back(Bytes("", 0));
+					nils_.push_back(true);
+					break;
+				}
+				if(end - p < len + 2){
+					return 0;
+				}
+				if(p[len] != '\r' || p[len + 1] != '\n'){
+					return -1;
+				}
+				packet->push_back(Bytes(p, (int)len));
+				nils_.push_back(false);
+				p += len + 2;
+				break;
+			case '*':
+				if(parse_int64(line, line_len, &len) != 0 || len > Link::MAX_PACKET_SIZE){
+					return -1;
+				}
+				if(len < 0){
+					nil = top;
+					if(!nil){
+						packet->push_back(Bytes("", 0));
+						nils_.push_back(true);
+					}
+					break;
+				}
+				remaining += len;
+				break;
+			default:
+				return -1;
+		}
+	}
+	input->decr((int)(p - start));
+
+	// the request this reply is for, its keys are kept until the next decode()
+	current_.reply = RESP_REPLY_PLAIN;
+	current_.keys.clear();
+	if(!pending_.empty()){
+		current_.reply = pending_.front().reply;
+		current_.keys.swap(pending_.front().keys);
+		pending_.pop_front();
+	}
+
+	if(nil){
+		packet->resize(1);
+		(*packet)[0] = Bytes("not_found");
+		return 1;
+	}
+	if(type == '-'){
+		Bytes msg = packet->at(1);
+		if(starts_with(msg, "NOAUTH", 6)){
+			(*packet)[0] = Bytes("noauth");
+			msg = Bytes(msg.data() + 6, msg.size() - 6);
+		}else{
+			(*packet)[0] = Bytes("error");
+			if(starts_with(msg, "ERR", 3)){
+				msg = Bytes(msg.data() + 3, msg.size() - 3);
+			}
+		}
+		if(starts_with(msg, " ", 1)){
+			msg = Bytes(msg.data() + 1, msg.size() - 1);
+		}
+		(*packet)[1] = msg;
+		return 1;
+	}
+	(*packet)[0] = Bytes("ok");
+	if(type == '+' && packet->at(1) == Bytes("OK")){
+		packet->resize(1);
+		return 1;
+	}
+	if(type == '*' && current_.reply != RESP_REPLY_PLAIN){
+		// MGET/HMGET answer every key, ssdb lists the keys found and their values
+		int num = (int)packet->size() - 1;
+		args_.clear();
+		args_.push_back(Bytes("ok"));
+		for(int i=0; i<num && i<(int)current_.keys.size(); i++){
+			if(!nils_[i + 1]){
+				args_.push_back(Bytes(current_.keys[i]));
+				args_.push_back(packet->at(i + 1));
+			}
+		}
+		packet->swap(args_);
+	}
+	return 1;
+}
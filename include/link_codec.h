@@ -0,0 +1,142 @@
+#ifndef NET_LINK_CODEC_H_
+#define NET_LINK_CODEC_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+#include "ssdb_bytes.h"
+
+/**
+ * Writes one RESP message into a Buffer. The caller adds up the size of the
+ * message with the *_size() helpers, reserve() grows the Buffer once, then
+ * every put_*() writes in place without checking for room.
+ */
+class RespWriter{
+	private:
+		Buffer *output;
+		char *p;
+	public:
+		// "*N\r\n", "$N\r\n" or ":N\r\n"
+		static int header_size(int n){
+			return 1 + uint64_digits((uint64_t)n) + 2;
+		}
+		static int bulk_size(int len){
+			return header_size(len) + len + 2;
+		}
+
+		int reserve(Buffer *output, int size){
+			this->output = output;
+			while(size > output->space()){
+				if(output->grow() == -1){
+					return -1;
+				}
+			}
+			p = output->slot();
+			return 0;
+		}
+		void put_header(char type, int n){
+			*p++ = type;
+			p += uint64_to_str(p, (uint64_t)n);
+			*p++ = '\r';
+			*p++ = '\n';
+		}
+		void put_bulk(const char *data, int size){
+			this->put_header('$', size);
+			memcpy(p, data, size);
+			p += size;
+			*p++ = '\r';
+			*p++ = '\n';
+		}
+		void put_nil(){
+			memcpy(p, "$-1\r\n", 5);
+			p += 5;
+		}
+		void put_raw(const char *data, int size){
+			memcpy(p, data, size);
+			p += size;
+		}
+		void done(){
+			output->incr((int)(p - output->slot()));
+		}
+};
+
+/**
+ * Frames the requests a client sends and parses the responses it gets
+ * back, see Link::codec(). Responses are handed out in the ssdb form, a
+ * status code ("ok", "not_found", "error", ...) followed by the fields,
+ * so Client code does not depend on the protocol spoken.
+ */
+class LinkCodec{
+	public:
+		virtual ~LinkCodec(){}
+		virtual LinkCodec* clone() const = 0;
+		virtual const char* name() const = 0;
+
+		// append a request, fields[0] is the ssdb command
+		virtual int encode(Buffer *output, const Bytes *fields, int num) = 0;
+		/**
+		 * parse a response at the head of input, return -
+		 * -1: error
+		 * 0: response not complete, read more
+		 * 1: the response is in packet, valid until the next decode()
+		 */
+		virtual int decode(Buffer *input, std::vector<Bytes> *packet) = 0;
+};
+
+/**
+ * The ssdb protocol: every field as its length and data on lines of their
+ * own, an empty line ends the packet.
+ */
+class SsdbCodec : public LinkCodec{
+	public:
+		virtual LinkCodec* clone() const{
+			return new SsdbCodec();
+		}
+		virtual const char* name() const{
+			return "ssdb";
+		}
+		virtual int encode(Buffer *output, const Bytes *fields, int num);
+		virtual int decode(Buffer *input, std::vector<Bytes> *packet);
+
+		// the parser, shared with Link::recv()
+		static int parse(Buffer *input, std::vector<Bytes> *packet);
+};
+
+/**
+ * RESP2, to talk to the redis port of SSDB or to a Redis compatible
+ * server.
+ *
+ * The common ssdb commands are translated to their Redis equivalents
+ * (setx to SETEX, multi_get to MGET, hsize to HLEN, zrange to ZRANGE ...
+ * WITHSCORES, qpush to RPUSH, ...), and their replies back: an integer or
+ * bulk string becomes "ok" and its value, nil becomes "not_found", an
+ * error "error" and its message, an array "ok" and its elements, and the
+ * values of MGET/HMGET are paired with their keys again. Other commands
+ * are sent unchanged, ranges like keys, scan and hkeys have no Redis
+ * equivalent.
+ */
+class RespCodec : public LinkCodec{
+	private:
+		struct Pending{
+			int reply;
+			// the keys of MGET/HMGET, the decoded packet points to them
+			std::vector<std::string> keys;
+		};
+		// the requests sent, in the order their replies will come
+		std::deque<Pending> pending_;
+		Pending current_;
+		std::vector<bool> nils_;
+		std::vector<Bytes> args_;
+		std::string buf_;
+	public:
+		virtual LinkCodec* clone() const{
+			return new RespCodec();
+		}
+		virtual const char* name() const{
+			return "resp";
+		}
+		virtual int encode(Buffer *output, const Bytes *fields, int num);
+		virtual int decode(Buffer *input, std::vector<Bytes> *packet);
+};
+
+#endif
@@ -4,7 +4,8 @@ Use of this source code is governed by a BSD-style license that can be
 found in the LICENSE file.
 */
 #include "link_redis.h"
-#include <map>
+#include "link_codec.h"
+#include "ssdb_scan.h"
 
 enum REPLY{
 	REPLY_BULK = 0,
@@ -33,18 +34,7 @@ enum STRATEGY{
 	STRATEGY_NULL
 };
 
-static bool inited = false;
-static std::map<std::string, RedisRequestDesc> cmd_table;
-
-struct RedisCommand_raw
-{
-	int strategy;
-	const char *redis_cmd;
-	const char *ssdb_cmd;
-	int reply_type;
-};
-
-static RedisCommand_raw cmds_raw[] = {
+static constexpr RedisRequestDesc cmds_raw[] = {
 	{STRATEGY_AUTO, "auth",		"auth",			REPLY_STATUS},
 	{STRATEGY_PING, "ping",		"ping",			REPLY_STATUS},
 
@@ -117,34 +107,90 @@ static RedisCommand_raw cmds_raw[] = {
 	{STRATEGY_AUTO, 	NULL,			NULL,			0}
 };
 
-int RedisLink::convert_req(){
-	if(!inited){
-		inited = true;
-		
-		RedisCommand_raw *def = &cmds_raw[0];
-		while(def->redis_cmd != NULL){
-			RedisRequestDesc desc;
-			desc.strategy = def->strategy;
-			desc.redis_cmd = def->redis_cmd;
-			desc.ssdb_cmd = def->ssdb_cmd;
-			desc.reply_type = def->reply_type;
-			cmd_table[desc.redis_cmd] = desc;
-			def += 1;
+/**
+ * Commands are found through a perfect hash: FNV-1a over the lowercased
+ * name puts every entry of cmds_raw in a slot of its own, so a lookup is
+ * one hash and one comparison. The slot table is filled at compile time,
+ * and the build fails if a new command collides, pick another CMD_SEED.
+ */
+const static int CMD_SLOTS = 256;
+const static uint32_t CMD_SEED = 835;
+
+static constexpr char cmd_fold(char c){
+	return (c >= 'A' && c <= 'Z')? (char)(c + ('a' - 'A')) : c;
+}
+
+static constexpr uint32_t cmd_fnv(const char *s, uint32_t h){
+	return *s? cmd_fnv(s + 1, (uint32_t)((h ^ (unsigned char)cmd_fold(*s)) * 16777619ULL)) : h;
+}
+
+static constexpr int cmd_slot(uint32_t h){
+	return (int)((h ^ (h >> 16)) & (CMD_SLOTS - 1));
+}
+
+static constexpr int cmd_find(int slot, int i){
+	return cmds_raw[i].redis_cmd == NULL? -1
+		: cmd_slot(cmd_fnv(cmds_raw[i].redis_cmd, CMD_SEED)) == slot? i
+		: cmd_find(slot, i + 1);
+}
+
+static constexpr bool cmd_collides(int i, int j){
+	return cmds_raw[j].redis_cmd != NULL
+		&& (cmd_slot(cmd_fnv(cmds_raw[i].redis_cmd, CMD_SEED)) == cmd_slot(cmd_fnv(cmds_raw[j].redis_cmd, CMD_SEED))
+			|| cmd_collides(i, j + 1));
+}
+
+static constexpr bool cmd_perfect(int i){
+	return cmds_raw[i].redis_cmd == NULL || (!cmd_collides(i, i + 1) && cmd_perfect(i + 1));
+}
+
+static_assert(sizeof(cmds_raw) / sizeof(cmds_raw[0]) < 128, "too many commands for cmd_slots");
+static_assert(cmd_perfect(0), "commands collide in cmd_slots, change CMD_SEED");
+
+#define CMD_SLOTS_4(n)		cmd_find(n, 0), cmd_find(n + 1, 0), cmd_find(n + 2, 0), cmd_find(n + 3, 0)
+#define CMD_SLOTS_16(n)		CMD_SLOTS_4(n), CMD_SLOTS_4(n + 4), CMD_SLOTS_4(n + 8), CMD_SLOTS_4(n + 12)
+#define CMD_SLOTS_64(n)		CMD_SLOTS_16(n), CMD_SLOTS_16(n + 16), CMD_SLOTS_16(n + 32), CMD_SLOTS_16(n + 48)
+
+// index in cmds_raw of the command hashed to each slot, -1 for none
+static constexpr signed char cmd_slots[CMD_SLOTS] = {
+	CMD_SLOTS_64(0), CMD_SLOTS_64(64), CMD_SLOTS_64(128), CMD_SLOTS_64(192)
+};
+
+#undef CMD_SLOTS_4
+#undef CMD_SLOTS_16
+#undef CMD_SLOTS_64
+
+// case-insensitive, NULL if the command is not translated
+static const RedisRequestDesc* find_command(const Bytes &name){
+	const char *p = name.data();
+	int size = name.size();
+	uint32_t h = CMD_SEED;
+	for(int i=0; i<size; i++){
+		h = (uint32_t)((h ^ (unsigned char)cmd_fold(p[i])) * 16777619ULL);
+	}
+	int idx = cmd_slots[cmd_slot(h)];
+	if(idx == -1){
+		return NULL;
+	}
+	const char *cmd = cmds_raw[idx].redis_cmd;
+	for(int i=0; i<size; i++){
+		if(cmd[i] == '\0' || cmd[i] != cmd_fold(p[i])){
+			return NULL;
 		}
 	}
-	
-	this->req_desc = NULL;
-	
-	std::map<std::string, RedisRequestDesc>::iterator it;
-	it = cmd_table.find(cmd);
-	if(it == cmd_table.end()){
-		recv_string.push_back(cmd);
+	return cmd[size] == '\0'? &cmds_raw[idx] : NULL;
+}
+
+int RedisLink::convert_req(){
+	this->req_desc = find_command(recv_bytes[0]);
+	if(this->req_desc == NULL){
+		recv_string.push_back(recv_bytes[0].String());
+		strtolower(&recv_string[0]);
 		for(int i=1; i<recv_bytes.size(); i++){
 			recv_string.push_back(recv_bytes[i].String());
 		}
 		return 0;
 	}
-	this->req_desc = &(it->second);
 
 	if(this->req_desc->strategy == STRATEGY_HKEYS
 			||  this->req_desc->strategy == STRATEGY_HVALS
@@ -336,9 +382,6 @@ const std::vector<Bytes>* RedisLink::recv_req(Buffer *input){
 		return &recv_bytes;
 	}
 
-	cmd = recv_bytes[0].String();
-	strtolower(&cmd);
-	
 	recv_string.clear();
 	
 	this->convert_req();
@@ -354,23 +397,38 @@ const std::vector<Bytes>* RedisLink::recv_req(Buffer *input){
 	return &recv_bytes;
 }
 
+template<class T>
+static inline bool field_is(const T &field, const char *s){
+	int len = (int)strlen(s);
+	return (int)field.size() == len && memcmp(field.data(), s, len) == 0;
+}
+
 int RedisLink::send_resp(Buffer *output, const std::vector<std::string> &resp){
+	return this->write_resp(output, resp);
+}
+
+int RedisLink::send_resp(Buffer *output, const std::vector<Bytes> &resp){
+	return this->write_resp(output, resp);
+}
+
+template<class T>
+int RedisLink::write_resp(Buffer *output, const std::vector<T> &resp){
 	if(resp.empty()){
 		return 0;
 	}
-	if(resp[0] != "ok"){
-		if(resp[0] == "error" || resp[0] == "fail" || resp[0] == "client_error"){
+	if(!field_is(resp[0], "ok")){
+		if(field_is(resp[0], "error") || field_is(resp[0], "fail") || field_is(resp[0], "client_error")){
 			output->append("-ERR ");
 			if(resp.size() >= 2){
-				output->append(resp[1]);
+				output->append(resp[1].data(), (int)resp[1].size());
 			}
 			output->append("\r\n");
-		}else if(resp[0] == "not_found"){
+		}else if(field_is(resp[0], "not_found")){
 			output->append("$-1\r\n");
-		}else if(resp[0] == "noauth"){
+		}else if(field_is(resp[0], "noauth")){
 			output->append("-NOAUTH ");
 			if(resp.size() >= 2){
-				output->append(resp[1]);
+				output->append(resp[1].data(), (int)resp[1].size());
 			}
 			output->append("\r\n");
 		}else{
@@ -378,22 +436,23 @@ int RedisLink::send_resp(Buffer *output, const std::vector<std::string> &resp){
 		}
 		return 0;
 	}
+
+	RespWriter writer;
 	
 	// not supported command
 	if(req_desc == NULL){
-		{
-			char buf[32];
-			snprintf(buf, sizeof(buf), "*%d\r\n", (int)resp.size() - 1);
-			output->append(buf);
+		int size = RespWriter::header_size((int)resp.size() - 1);
+		for(int i=1; i<resp.size(); i++){
+			size += RespWriter::bulk_size((int)resp[i].size());
+		}
+		if(writer.reserve(output, size) == -1){
+			return -1;
 		}
+		writer.put_header('*', (int)resp.size() - 1);
 		for(int i=1; i<resp.size(); i++){
-			const std::string &val = resp[i];
-			char buf[32];
-			snprintf(buf, sizeof(buf), "$%d\r\n", (int)val.size());
-			output->append(buf);
-			output->append(val.data(), val.size());
-			output->append("\r\n");
+			writer.put_bulk(resp[i].data(), (int)resp[i].size());
 		}
+		writer.done();
 		return 0;
 	}
 	
@@ -407,12 +466,11 @@ int RedisLink::send_resp(Buffer *output, const std::vector<std::string> &resp){
 	}
 	if(req_desc->reply_type == REPLY_BULK){
 		if(resp.size() >= 2){
-			const std::string &val = resp[1];
-			char buf[32];
-			snprintf(buf, sizeof(buf), "$%d\r\n", (int)val.size());
-			output->append(buf);
-			output->append(val.data(), val.size());
-			output->append("\r\n");
+			if(writer.reserve(output, RespWriter::bulk_size((int)resp[1].size())) == -1){
+				return -1;
+			}
+			writer.put_bulk(resp[1].data(), (int)resp[1].size());
+			writer.done();
 		}else{
 			output->append("$0\r\n");
 		}
@@ -420,10 +478,14 @@ int RedisLink::send_resp(Buffer *output, const std::vector<std::string> &resp){
 	}
 	if(req_desc->reply_type == REPLY_INT){
 		if(resp.size() >= 2){
-			const std::string &val = resp[1];
-			output->append(":");
-			output->append(val.data(), val.size());
-			output->append("\r\n");
+			const T &val = resp[1];
+			if(writer.reserve(output, 1 + (int)val.size() + 2) == -1){
+				return -1;
+			}
+			writer.put_raw(":", 1);
+			writer.put_raw(val.data(), (int)val.size());
+			writer.put_raw("\r\n", 2);
+			writer.done();
 		}else{
 			output->append("$0\r\n");
 		}
@@ -435,44 +497,46 @@ int RedisLink::send_resp(Buffer *output, const std::vector<std::string> &resp){
 			//log_error("bad response for multi_(h)get");
 			return 0;
 		}
-		char buf[32];
-		std::vector<std::string>::const_iterator req_it, resp_it;
+		std::vector<std::string>::const_iterator req_it;
 		if(req_desc->strategy == STRATEGY_MGET){
 			req_it = recv_string.begin() + 1;
-			snprintf(buf, sizeof(buf), "*%d\r\n", (int)recv_string.size() - 1);
 		}else{
 			req_it = recv_string.begin() + 2;
-			snprintf(buf, sizeof(buf), "*%d\r\n", (int)recv_string.size() - 2);
 		}
-		output->append(buf);
-		
-		resp_it = resp.begin() + 1;
+		int num = (int)(recv_string.end() - req_it);
+
+		// every requested key is either nil or one of the values, at most once
+		int size = RespWriter::header_size(num) + num * 5;
+		for(int i=2; i<resp.size(); i+=2){
+			size += RespWriter::bulk_size((int)resp[i].size());
+		}
+		if(writer.reserve(output, size) == -1){
+			return -1;
+		}
+		writer.put_header('*', num);
 
+		typename std::vector<T>::const_iterator resp_it = resp.begin() + 1;
 		while(req_it != recv_string.end()){
 			const std::string &req_key = *req_it;
 			req_it ++;
 			if(resp_it == resp.end()){
-				output->append("$-1\r\n");
+				writer.put_nil();
 				continue;
 			}
-			const std::string &resp_key = *resp_it;
+			const T &resp_key = *resp_it;
 			//log_debug("%s %s", req_key.c_str(), resp_key.c_str());
-			if(req_key != resp_key){
-				output->append("$-1\r\n");
+			if(req_key.size() != resp_key.size() || memcmp(req_key.data(), resp_key.data(), req_key.size()) != 0){
+				writer.put_nil();
 				// loop until we find value to the requested key
 				continue;
 			}
 				
-			const std::string &val = *(resp_it + 1);
-			char buf[32];
-			snprintf(buf, sizeof(buf), "$%d\r\n", (int)val.size());
-			output->append(buf);
-			output->append(val.data(), val.size());
-			output->append("\r\n");
+			const T &val = *(resp_it + 1);
+			writer.put_bulk(val.data(), (int)val.size());
 				
 			resp_it += 2;
 		}
-
+		writer.done();
 		return 0;
 	}
 	
@@ -488,26 +552,20 @@ int RedisLink::send_resp(Buffer *output, const std::vector<std::string> &resp){
 				withscores = false;
 			}
 		}
-		{
-			char buf[32];
-			if(withscores){
-				snprintf(buf, sizeof(buf), "*%d\r\n", (int)resp.size() - 1);
-			}else{
-				snprintf(buf, sizeof(buf), "*%d\r\n", ((int)resp.size() - 1)/2);
-			}
-			output->append(buf);
+		int num = withscores? (int)resp.size() - 1 : ((int)resp.size() - 1)/2;
+		int step = withscores? 1 : 2;
+		int size = RespWriter::header_size(num);
+		for(int i=1; i<resp.size(); i+=step){
+			size += RespWriter::bulk_size((int)resp[i].size());
 		}
-		for(int i=1; i<resp.size(); i++){
-			const std::string &val = resp[i];
-			char buf[32];
-			snprintf(buf, sizeof(buf), "$%d\r\n", (int)val.size());
-			output->append(buf);
-			output->append(val.data(), val.size());
-			output->append("\r\n");
-			if(!withscores){
-				i += 1;
-			}
+		if(writer.reserve(output, size) == -1){
+			return -1;
 		}
+		writer.put_header('*', num);
+		for(int i=1; i<resp.size(); i+=step){
+			writer.put_bulk(resp[i].data(), (int)resp[i].size());
+		}
+		writer.done();
 		return 0;
 	}
 	
@@ -536,22 +594,21 @@ int RedisLink::parse_req(Buffer *input){
 
 	int num_args = 0;	
 	while(size > 0){
-		char *lf = (char *)memchr(ptr, '\n', size);
-		if(lf == NULL){
+		if(size < 2){
 			break;
 		}
-		lf += 1;
-		size -= (lf - ptr);
-		parsed += (lf - ptr);
-		
-		int len = (int)strtol(ptr + 1, NULL, 10); // ptr + 1: skip '$' or '*'
-		if(errno == EINVAL){
-			return -1;
+		int len;
+		int head_len = parse_header(ptr + 1, size - 1, &len); // ptr + 1: skip '$' or '*'
+		if(head_len == 0){
+			break;
 		}
-		ptr = lf;
-		if(len < 0){
+		if(head_len == -1){
 			return -1;
 		}
+		head_len += 1;
+		size -= head_len;
+		parsed += head_len;
+		ptr += head_len;
 		if(num_args == 0){
 			if(len <= 0){
 				return -1;
@@ -13,21 +13,22 @@ found in the LICENSE file.
 struct RedisRequestDesc
 {
 	int strategy;
-	std::string redis_cmd;
-	std::string ssdb_cmd;
+	const char *redis_cmd;
+	const char *ssdb_cmd;
 	int reply_type;
 };
 
 class RedisLink
 {
 private:
-	std::string cmd;
-	RedisRequestDesc *req_desc;
+	const RedisRequestDesc *req_desc;
 
 	std::vector<Bytes> recv_bytes;
 	std::vector<std::string> recv_string;
 	int parse_req(Buffer *input);
 	int convert_req();
+	template<class T>
+	int write_resp(Buffer *output, const std::vector<T> &resp);
 	
 public:
 	RedisLink(){
@@ -36,6 +37,8 @@ public:
 	
 	const std::vector<Bytes>* recv_req(Buffer *input);
 	int send_resp(Buffer *output, const std::vector<std::string> &resp);
+	// the same, reading the fields of a response still in the Link's buffer
+	int send_resp(Buffer *output, const std::vector<Bytes> &resp);
 };
 
 #endif
@@ -25,9 +25,12 @@ SOFTWARE.
 #include "lua_ssdb.h"
 #include <assert.h>
 #include "SSDB_client.h"
+#include "link.h"
+#include "ssdb_strings.h"
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
 #include <exception>
 
 #if defined(_WIN32)
@@ -37,6 +40,8 @@ SOFTWARE.
 		#define WIN32_LEAN_AND_MEAN
 		#include <WinSock2.h>
 	#endif
+#else
+	#include <sys/select.h>
 #endif
 
 /***
@@ -132,14 +137,15 @@ inline int convert_vectormap_to_table( const std::vector<std::string>& aList, lu
 	{
 		lua_pushvalue( l, -1 );
 		int iIndex = 0;
-		while ( iIndex < aList.size() )
+		while ( iIndex + 1 < aList.size() )
 		{
 			lua_pushstring( l, aList[ iIndex ].c_str() );
 			iIndex++;
 			if ( bNumber )
-				lua_pushnumber( l, std::atoll( aList[ iIndex ].c_str()) );
+				lua_pushnumber( l, (lua_Number)str_to_int64( aList[ iIndex ] ) );
 			else
 				lua_pushstring( l, aList[ iIndex ].c_str() );
+			iIndex++;
 			lua_settable( l, -3 );
 			iRes++;
 		}
@@ -148,6 +154,30 @@ inline int convert_vectormap_to_table( const std::vector<std::string>& aList, lu
 	return iRes;
 }
 
+/// internal, convert arena stored map to lua table
+// @function convert_vectormap_to_table
+// @param arena reply items, keys and values
+// @param l lua_state
+inline int convert_vectormap_to_table( const ssdb::ResultArena& aList, lua_State* l, bool bNumber = false )
+{
+	int iRes = 0;
+	lua_createtable( l, 0, aList.size() / 2 );
+	int iIndex = 0;
+	while ( iIndex + 1 < aList.size() )
+	{
+		ssdb::Slice sKey = aList[ iIndex++ ];
+		ssdb::Slice sValue = aList[ iIndex++ ];
+		lua_pushlstring( l, sKey.data, sKey.size );
+		if ( bNumber )
+			lua_pushnumber( l, (lua_Number)str_to_int64( sValue.data, sValue.size ) );
+		else
+			lua_pushlstring( l, sValue.data, sValue.size );
+		lua_settable( l, -3 );
+		iRes++;
+	}
+	return iRes;
+}
+
 /// internal, convert lua table to array list
 // @function conver_vectormap_to_table
 // @param array string vector, contains map
@@ -484,7 +514,7 @@ int ssdb_client_scan( lua_State* l )
 	std::string sNameStart = lua_tostring( l, 2 );
 	std::string sNameEnd = lua_tostring( l, 3 );
 	uint64_t iLimit = lua_tonumber( l, 4 );
-	std::vector<std::string> vResult;
+	ssdb::ResultArena vResult;
 	if ( error_status( l, pClient->scan( sNameStart, sNameEnd, iLimit, &vResult ) ) )
 		return 3;
 	else
@@ -514,7 +544,7 @@ int ssdb_client_rscan( lua_State* l )
 	std::string sNameStart = lua_tostring( l, 2 );
 	std::string sNameEnd = lua_tostring( l, 3 );
 	uint64_t iLimit = lua_tonumber( l, 4 );
-	std::vector<std::string> vResult;
+	ssdb::ResultArena vResult;
 	if ( error_status( l, pClient->rscan( sNameStart, sNameEnd, iLimit, &vResult ) ) )
 		return 3;
 	else
@@ -602,7 +632,8 @@ int ssdb_client_multi_get( lua_State* l )
 	LUA_ASSERTL( l, lua_gettop( l ) > 1 && lua_type( l, 2 ) == LUA_TTABLE );
 
 	ssdb::Client* pClient = SSDB_CHECK( l, 1 );
-	std::vector<std::string> aKeys, aResult;
+	std::vector<std::string> aKeys;
+	ssdb::ResultArena aResult;
 	convert_lua_table_vector( aKeys, l, -1 );
 	if ( error_status( l, pClient->multi_get( aKeys, &aResult ) ) )
 		return 3;
@@ -812,7 +843,7 @@ int ssdb_client_hgetall( lua_State* l )
 
 	ssdb::Client* pClient = SSDB_CHECK( l, 1 );
 	std::string sHashMap = lua_tostring( l, 2 );
-	std::vector<std::string> aResults;
+	ssdb::ResultArena aResults;
 
 	if ( error_status( l, pClient->hgetall( sHashMap, &aResults ) ) )
 		return 3;
@@ -847,7 +878,7 @@ int ssdb_client_hscan( lua_State* l )
 	std::string sStartKey = lua_tostring( l, 3 );
 	std::string sEndKey = lua_tostring( l, 4 );
 	uint64_t iLimit = lua_tonumber( l, 5 );
-	std::vector<std::string> aResults;
+	ssdb::ResultArena aResults;
 
 	if ( error_status( l, pClient->hscan( sHashMap, sStartKey, sEndKey, iLimit, &aResults ) ) )
 		return 3;
@@ -882,7 +913,7 @@ int ssdb_client_hrscan( lua_State* l )
 	std::string sStartKey = lua_tostring( l, 3 );
 	std::string sEndKey = lua_tostring( l, 4 );
 	uint64_t iLimit = lua_tonumber( l, 5 );
-	std::vector<std::string> aResults;
+	ssdb::ResultArena aResults;
 
 	if ( error_status( l, pClient->hrscan( sHashMap, sStartKey, sEndKey, iLimit, &aResults ) ) )
 		return 3;
@@ -908,7 +939,7 @@ int ssdb_client_multi_hget( lua_State* l )
 	ssdb::Client* pClient = SSDB_CHECK( l, 1 );
 	std::string sHashMap = lua_tostring( l, 2 );
 	std::vector<std::string> aKeys;
-	std::vector<std::string> aResults;
+	ssdb::ResultArena aResults;
 	convert_lua_table_vector( aKeys, l, -1 );
 
 	if ( error_status( l, pClient->multi_hget( sHashMap, aKeys, &aResults ) ) )
@@ -1363,7 +1394,7 @@ int ssdb_client_zscan( lua_State* l )
 	int64_t iEnd = lua_tonumber( l, 5 );
 	int64_t iLimit = lua_tonumber( l, 6 );
 
-	std::vector<std::string> aResult;
+	ssdb::ResultArena aResult;
 
 	if ( error_status( l, pClient->zscan( sKey, sKeyStart, &iStart, &iEnd, iLimit, &aResult ) ) )
 		return 3;
@@ -1396,7 +1427,7 @@ int ssdb_client_zrscan( lua_State* l )
 	int64_t iEnd = lua_tonumber( l, 5 );
 	int64_t iLimit = lua_tonumber( l, 6 );
 
-	std::vector<std::string> aResult;
+	ssdb::ResultArena aResult;
 
 	if ( error_status( l, pClient->zrscan( sKey, sKeyStart, &iStart, &iEnd, iLimit, &aResult ) ) )
 		return 3;
@@ -1484,6 +1515,702 @@ int ssdb_client_multi_zdel( lua_State* l )
 		return 1;
 }
 
+//--------------------------------------------------------
+// Scan iterators, fetch one page per request and hand out pairs one by one,
+// so large ranges never live in a single Lua table.
+//--------------------------------------------------------
+
+/// Internal, scan iterator state
+struct SSDBScanIter
+{
+	std::vector<std::string> aRequest; // next page request, start key ( and score ) are updated per page
+	int iKeyStart;                     // index of the start key in aRequest
+	int iScoreStart;                   // index of the start score in aRequest, -1 if none
+	int64_t iLimit;
+	bool bNumber;
+	bool bDone;
+	ssdb::ResultArena aPage;           // current page, key value pairs streamed from the reply
+	int iPos;
+};
+
+/// Internal, check userdata type and convert to scan iterator
+// @function SSDB_ITER_CHECK
+// @param l lua_state
+// @param int iIndex
+// @return SSDBScanIter
+SSDBScanIter* SSDB_ITER_CHECK( lua_State* l, int iIndex )
+{
+	#ifdef _DEBUG
+		SSDBScanIter* instance = *( SSDBScanIter** )luaL_checkudata( l, iIndex, DLUASSDBITERMETA );
+		if ( !instance )
+			luaL_error( l, "Invalid SSDB iterator meta at index : %d", iIndex );
+		return instance;
+	#else
+		return *( SSDBScanIter** )lua_touserdata( l, iIndex );
+	#endif
+}
+
+/// destroy iterator state
+// @function __gc
+// @param instance iterator
+int ssdb_iter_gc( lua_State* l )
+{
+	SSDBScanIter* pIter = SSDB_ITER_CHECK( l, 1 );
+	if ( pIter )
+		delete pIter;
+	return 0;
+}
+
+/// Internal, iterator function, upvalue 1 is the iterator state, upvalue 2 the client
+// @function ssdb_iter_next
+// @return key
+// @return value, number for zsets
+int ssdb_iter_next( lua_State* l )
+{
+	SSDBScanIter* pIter = SSDB_ITER_CHECK( l, lua_upvalueindex( 1 ) );
+	if ( pIter->iPos + 1 >= pIter->aPage.size() )
+	{
+		if ( pIter->bDone )
+			return 0;
+
+		// the arena keeps its memory across pages, fields are copied into it
+		// once, straight from the link's buffer
+		ssdb::Client* pClient = SSDB_CHECK( l, lua_upvalueindex( 2 ) );
+		pIter->aPage.clear();
+		ssdb::Status Status = pClient ? pClient->request_stream( pIter->aRequest, &pIter->aPage ) : ssdb::Status( "error" );
+		if ( !Status.ok() )
+			return luaL_error( l, "ssdb %s failed: %s", pIter->aRequest[ 0 ].c_str(), Status.code().c_str() );
+
+		pIter->iPos = 0;
+		int iPairs = pIter->aPage.size() / 2;
+		if ( iPairs == 0 || ( int64_t )iPairs < pIter->iLimit )
+			pIter->bDone = true;
+		if ( iPairs == 0 )
+			return 0;
+
+		// next page starts after the last key ( and score )
+		pIter->aRequest[ pIter->iKeyStart ] = pIter->aPage.str( iPairs * 2 - 2 );
+		if ( pIter->iScoreStart >= 0 )
+			pIter->aRequest[ pIter->iScoreStart ] = pIter->aPage.str( iPairs * 2 - 1 );
+	}
+
+	ssdb::Slice sKey = pIter->aPage[ pIter->iPos ];
+	ssdb::Slice sValue = pIter->aPage[ pIter->iPos + 1 ];
+	pIter->iPos += 2;
+	lua_pushlstring( l, sKey.data, sKey.size );
+	if ( pIter->bNumber )
+		lua_pushnumber( l, str_to_int64( sValue.data, sValue.size ) );
+	else
+		lua_pushlstring( l, sValue.data, sValue.size );
+	return 2;
+}
+
+/// Internal, push iterator function for request
+// @function push_iter
+// @param l lua_state
+// @param pIter iterator state, owned by lua afterwards
+// @return iterator function
+inline int push_iter( lua_State* l, SSDBScanIter* pIter )
+{
+	if ( pIter->iLimit <= 0 )
+		pIter->iLimit = 1000;
+	pIter->aRequest.push_back( str( pIter->iLimit ) );
+	pIter->bDone = false;
+	pIter->iPos = 0;
+
+	SSDBScanIter** ppIter = ( SSDBScanIter** )lua_newuserdata( l, sizeof( SSDBScanIter* ) );
+	*ppIter = pIter;
+	luaL_getmetatable( l, DLUASSDBITERMETA );
+	lua_setmetatable( l, -2 );
+	lua_pushvalue( l, 1 ); // keep the client alive while iterating
+	lua_pushcclosure( l, ssdb_iter_next, 2 );
+	return 1;
+}
+
+/// iterate key values in range, page by page
+// @function scan_iter
+// @param instance ssdb::client
+// @param key_start
+// @param key_end
+// @param page number of pairs per request [ optional ] default 1000
+// @return iterator function, raises error on failure
+// @usage for k, v in client:scan_iter( '', '', 500 ) do ... end
+int ssdb_client_scan_iter( lua_State* l )
+{
+	LUA_ASSERTL( l, lua_gettop( l ) > 2 && lua_type( l, 2 ) == LUA_TSTRING && lua_type( l, 3 ) == LUA_TSTRING );
+
+	SSDBScanIter* pIter = new SSDBScanIter();
+	pIter->aRequest.push_back( "scan" );
+	pIter->aRequest.push_back( lua_tostring( l, 2 ) );
+	pIter->aRequest.push_back( lua_tostring( l, 3 ) );
+	pIter->iKeyStart = 1;
+	pIter->iScoreStart = -1;
+	pIter->iLimit = lua_tonumber( l, 4 );
+	pIter->bNumber = false;
+	return push_iter( l, pIter );
+}
+
+/// iterate hashmap key values in range, page by page
+// @function hscan_iter
+// @param instance ssdb::client
+// @param hashmap
+// @param key_start
+// @param key_end
+// @param page number of pairs per request [ optional ] default 1000
+// @return iterator function, raises error on failure
+// @usage for k, v in client:hscan_iter( 'users', '', '' ) do ... end
+int ssdb_client_hscan_iter( lua_State* l )
+{
+	LUA_ASSERTL( l, lua_gettop( l ) > 3 && lua_type( l, 2 ) == LUA_TSTRING && lua_type( l, 3 ) == LUA_TSTRING && lua_type( l, 4 ) == LUA_TSTRING );
+
+	SSDBScanIter* pIter = new SSDBScanIter();
+	pIter->aRequest.push_back( "hscan" );
+	pIter->aRequest.push_back( lua_tostring( l, 2 ) );
+	pIter->aRequest.push_back( lua_tostring( l, 3 ) );
+	pIter->aRequest.push_back( lua_tostring( l, 4 ) );
+	pIter->iKeyStart = 2;
+	pIter->iScoreStart = -1;
+	pIter->iLimit = lua_tonumber( l, 5 );
+	pIter->bNumber = false;
+	return push_iter( l, pIter );
+}
+
+/// iterate all hashmap key values, page by page
+// @function hgetall_iter
+// @param instance ssdb::client
+// @param hashmap
+// @param page number of pairs per request [ optional ] default 1000
+// @return iterator function, raises error on failure
+int ssdb_client_hgetall_iter( lua_State* l )
+{
+	LUA_ASSERTL( l, lua_gettop( l ) > 1 && lua_type( l, 2 ) == LUA_TSTRING );
+
+	SSDBScanIter* pIter = new SSDBScanIter();
+	pIter->aRequest.push_back( "hscan" );
+	pIter->aRequest.push_back( lua_tostring( l, 2 ) );
+	pIter->aRequest.push_back( "" );
+	pIter->aRequest.push_back( "" );
+	pIter->iKeyStart = 2;
+	pIter->iScoreStart = -1;
+	pIter->iLimit = lua_tonumber( l, 3 );
+	pIter->bNumber = false;
+	return push_iter( l, pIter );
+}
+
+/// iterate zset keys and scores in range, page by page
+// @function zscan_iter
+// @param instance ssdb::client
+// @param key
+// @param key_start
+// @param score_start [ optional ] nil for no lower bound
+// @param score_end [ optional ] nil for no upper bound
+// @param page number of pairs per request [ optional ] default 1000
+// @return iterator function, raises error on failure
+int ssdb_client_zscan_iter( lua_State* l )
+{
+	LUA_ASSERTL( l, lua_gettop( l ) > 2 && lua_type( l, 2 ) == LUA_TSTRING && lua_type( l, 3 ) == LUA_TSTRING );
+
+	SSDBScanIter* pIter = new SSDBScanIter();
+	pIter->aRequest.push_back( "zscan" );
+	pIter->aRequest.push_back( lua_tostring( l, 2 ) );
+	pIter->aRequest.push_back( lua_tostring( l, 3 ) );
+	pIter->aRequest.push_back( lua_isnumber( l, 4 ) ? str( ( int64_t )lua_tonumber( l, 4 ) ) : std::string() );
+	pIter->aRequest.push_back( lua_isnumber( l, 5 ) ? str( ( int64_t )lua_tonumber( l, 5 ) ) : std::string() );
+	pIter->iKeyStart = 2;
+	pIter->iScoreStart = 3;
+	pIter->iLimit = lua_tonumber( l, 6 );
+	pIter->bNumber = true;
+	return push_iter( l, pIter );
+}
+
+//--------------------------------------------------------
+// Non-blocking client. Methods must be called from a coroutine, they send
+// the request and yield, ssdb.poll() resumes the coroutine with the same
+// results the blocking client returns once the response arrived.
+// Requests of one client are pipelined on its connection.
+// Async clients are tracked in a weak table in the registry, so every
+// lua_State polls its own clients only.
+//--------------------------------------------------------
+
+enum ESSDBAsyncReply
+{
+	EAsyncReplyStatus = 0,
+	EAsyncReplyString,
+	EAsyncReplyNumber,
+	EAsyncReplyList,
+	EAsyncReplyMap,
+	EAsyncReplyMapNumber
+};
+
+enum ESSDBAsyncArgs
+{
+	EAsyncArgsPlain = 0,
+	EAsyncArgsPairs // table arguments are flattened to key, value, key, value...
+};
+
+/// Internal, async command description
+struct SSDBAsyncCommand
+{
+	const char* sName;
+	const char* sCommand;
+	int iReply;
+	int iArgs;
+};
+
+/// Internal, request waiting for its response
+struct SSDBAsyncCall
+{
+	lua_State* pThread;
+	int iThreadRef;
+	int iClientRef;
+	int iReply;
+};
+
+/// Internal, non-blocking client
+struct SSDBAsyncClient
+{
+	Link* pLink;
+	std::deque<SSDBAsyncCall> aPending;
+};
+
+/// Internal, completed request ready to be resumed
+struct SSDBAsyncResult
+{
+	SSDBAsyncCall Call;
+	bool bFailed;
+	std::vector<std::string> aResponse;
+};
+
+/// Internal, push the table of the async clients of this lua_State, its keys are the client userdata
+// @function push_async_clients
+// @param l lua_state
+static void push_async_clients( lua_State* l )
+{
+	lua_getfield( l, LUA_REGISTRYINDEX, DLUASSDBASYNCLIST );
+	if ( !lua_isnil( l, -1 ) )
+		return;
+	lua_pop( l, 1 );
+	lua_newtable( l );
+	lua_newtable( l );
+	lua_pushstring( l, "k" );
+	lua_setfield( l, -2, "__mode" );
+	lua_setmetatable( l, -2 );
+	lua_pushvalue( l, -1 );
+	lua_setfield( l, LUA_REGISTRYINDEX, DLUASSDBASYNCLIST );
+}
+
+/// Internal, check userdata type and convert to async client
+// @function SSDB_ASYNC_CHECK
+// @param l lua_state
+// @param int iIndex
+// @return SSDBAsyncClient
+SSDBAsyncClient* SSDB_ASYNC_CHECK( lua_State* l, int iIndex )
+{
+	#ifdef _DEBUG
+		SSDBAsyncClient* instance = *( SSDBAsyncClient** )luaL_checkudata( l, iIndex, DLUASSDBASYNCMETA );
+		if ( !instance )
+			luaL_error( l, "Invalid SSDB async meta at index : %d", iIndex );
+		return instance;
+	#else
+		return *( SSDBAsyncClient** )lua_touserdata( l, iIndex );
+	#endif
+}
+
+/// create new non-blocking client, its methods must be called from a coroutine
+// @function connect_async
+// @param ip remote address
+// @param port remote port
+// @return client
+// @return bool connection success to server
+int ssdb_connect_async( lua_State* l )
+{
+	LUA_ASSERTL( l, lua_gettop( l ) > 1 && lua_type( l, 1 ) == LUA_TSTRING && lua_type( l, 2 ) == LUA_TNUMBER )
+	SSDBAsyncClient** ppClient = ( SSDBAsyncClient** )lua_newuserdata( l, sizeof( SSDBAsyncClient* ) );
+	*ppClient = NULL;
+	Link* pLink = Link::connect( lua_tostring( l, 1 ), lua_tointeger( l, 2 ) );
+	if ( pLink )
+	{
+		pLink->nodelay( true );
+		pLink->noblock( true );
+		*ppClient = new SSDBAsyncClient();
+		( *ppClient )->pLink = pLink;
+	}
+	luaL_getmetatable( l, DLUASSDBASYNCMETA );
+	lua_setmetatable( l, -2 );
+	if ( pLink )
+	{
+		push_async_clients( l );
+		lua_pushvalue( l, -2 );
+		lua_pushboolean( l, true );
+		lua_rawset( l, -3 );
+		lua_pop( l, 1 );
+	}
+	lua_pushboolean( l, pLink ? true : false );
+	return 2;
+}
+
+/// destroy async client instance
+// @function __gc
+// @param instance async client
+int ssdb_async_client_gc( lua_State* l )
+{
+	SSDBAsyncClient* pClient = SSDB_ASYNC_CHECK( l, 1 );
+	if ( pClient )
+	{
+		push_async_clients( l );
+		lua_pushvalue( l, 1 );
+		lua_pushnil( l );
+		lua_rawset( l, -3 );
+		lua_pop( l, 1 );
+		delete pClient->pLink;
+		delete pClient;
+		*( SSDBAsyncClient** )lua_touserdata( l, 1 ) = NULL;
+	}
+	return 0;
+}
+
+/// number of requests waiting for response
+// @function pending
+// @param instance async client
+// @return number
+int ssdb_async_client_pending( lua_State* l )
+{
+	SSDBAsyncClient* pClient = SSDB_ASYNC_CHECK( l, 1 );
+	lua_pushnumber( l, pClient ? pClient->aPending.size() : 0 );
+	return 1;
+}
+
+/// Internal, flatten table argument into the request
+// @function async_push_table
+// @param aArgs request
+// @param l lua_state
+// @param iIndex table index
+// @param iMode ESSDBAsyncArgs
+inline void async_push_table( std::vector<std::string>& aArgs, lua_State* l, int iIndex, int iMode )
+{
+	if ( iMode == EAsyncArgsPairs )
+	{
+		lua_pushnil( l );
+		while ( lua_next( l, iIndex ) )
+		{
+			lua_pushvalue( l, -2 ); // lua_tolstring would confuse lua_next on the original key
+			size_t iKeyLen, iValLen;
+			const char* sKey = lua_tolstring( l, -1, &iKeyLen );
+			const char* sVal = lua_tolstring( l, -2, &iValLen );
+			if ( sKey && sVal )
+			{
+				aArgs.push_back( std::string( sKey, iKeyLen ) );
+				aArgs.push_back( std::string( sVal, iValLen ) );
+			}
+			lua_pop( l, 2 );
+		}
+	}
+	else
+	{
+		int iSize = lua_objlen( l, iIndex );
+		for ( int iItem = 1; iItem <= iSize; iItem++ )
+		{
+			lua_rawgeti( l, iIndex, iItem );
+			size_t iLen;
+			const char* sVal = lua_tolstring( l, -1, &iLen );
+			if ( sVal )
+				aArgs.push_back( std::string( sVal, iLen ) );
+			lua_pop( l, 1 );
+		}
+	}
+}
+
+/// Internal, push converted response on the stack of the coroutine
+// @function async_push_reply
+// @return number of values pushed
+inline int async_push_reply( lua_State* l, int iReply, bool bFailed, const std::vector<std::string>& aResponse )
+{
+	ssdb::Status Status( bFailed ? NULL : &aResponse );
+	if ( error_status( l, Status ) )
+		return 3;
+
+	std::vector<std::string> aList;
+	if ( iReply == EAsyncReplyList || iReply == EAsyncReplyMap || iReply == EAsyncReplyMapNumber )
+		aList.assign( aResponse.begin() + 1, aResponse.end() );
+
+	switch ( iReply )
+	{
+	case EAsyncReplyString:
+		if ( aResponse.size() > 1 )
+			lua_pushlstring( l, aResponse[ 1 ].data(), aResponse[ 1 ].size() );
+		else
+			lua_pushnil( l );
+		return 2;
+	case EAsyncReplyNumber:
+		if ( aResponse.size() > 1 )
+			lua_pushnumber( l, str_to_int64( aResponse[ 1 ] ) );
+		else
+			lua_pushnil( l );
+		return 2;
+	case EAsyncReplyList:
+		convert_vector_to_table( aList, l );
+		return 2;
+	case EAsyncReplyMap:
+		convert_vectormap_to_table( aList, l );
+		return 2;
+	case EAsyncReplyMapNumber:
+		convert_vectormap_to_table( aList, l, true );
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+/// Internal, send request and yield the running coroutine
+// @function ssdb_async_call
+// @param instance async client
+// @param ... command arguments, tables are flattened
+// @return same values as the blocking client method, after ssdb.poll resumed the coroutine
+int ssdb_async_call( lua_State* l )
+{
+	const SSDBAsyncCommand* pCommand = ( const SSDBAsyncCommand* )lua_touserdata( l, lua_upvalueindex( 1 ) );
+	SSDBAsyncClient* pClient = SSDB_ASYNC_CHECK( l, 1 );
+	if ( !pClient || pClient->pLink->error() )
+	{
+		std::vector<std::string> aEmpty;
+		return async_push_reply( l, pCommand->iReply, true, aEmpty );
+	}
+	if ( lua_pushthread( l ) )
+		return luaL_error( l, "ssdb async %s must be called from a coroutine", pCommand->sName );
+	lua_pop( l, 1 );
+
+	// generic request has an empty command, the first argument is the command
+	std::vector<std::string> aArgs;
+	if ( pCommand->sCommand[ 0 ] )
+		aArgs.push_back( pCommand->sCommand );
+	int iTop = lua_gettop( l );
+	for ( int iArg = 2; iArg <= iTop; iArg++ )
+	{
+		if ( lua_type( l, iArg ) == LUA_TTABLE )
+			async_push_table( aArgs, l, iArg, pCommand->iArgs );
+		else
+		{
+			size_t iLen;
+			const char* sArg = lua_tolstring( l, iArg, &iLen );
+			aArgs.push_back( sArg ? std::string( sArg, iLen ) : std::string() );
+		}
+	}
+	LUA_ASSERTL( l, !aArgs.empty() )
+
+	Link* pLink = pClient->pLink;
+	pLink->send( aArgs );
+	if ( pLink->write() == -1 )
+	{
+		pLink->mark_error();
+		std::vector<std::string> aEmpty;
+		return async_push_reply( l, pCommand->iReply, true, aEmpty );
+	}
+
+	SSDBAsyncCall Call;
+	Call.iReply = pCommand->iReply;
+	Call.pThread = l;
+	lua_pushthread( l );
+	Call.iThreadRef = luaL_ref( l, LUA_REGISTRYINDEX );
+	lua_pushvalue( l, 1 );
+	Call.iClientRef = luaL_ref( l, LUA_REGISTRYINDEX );
+	pClient->aPending.push_back( Call );
+
+	lua_settop( l, 0 );
+	return lua_yield( l, 0 );
+}
+
+/// Internal, read responses of one client
+// @function async_client_io
+// @return -1 on connection error
+static int async_client_io( SSDBAsyncClient* pClient, bool bRead, bool bWrite, std::vector<SSDBAsyncResult>& aResults )
+{
+	Link* pLink = pClient->pLink;
+	bool bError = pLink->error();
+	if ( !bError && bWrite && pLink->write() == -1 )
+		bError = true;
+	if ( !bError && bRead )
+	{
+		if ( pLink->read() <= 0 )
+			bError = true;
+		while ( !bError && !pClient->aPending.empty() )
+		{
+			const std::vector<Bytes>* pPacket = pLink->recv();
+			if ( pPacket == NULL )
+			{
+				bError = true;
+				break;
+			}
+			if ( pPacket->empty() )
+				break;
+			aResults.push_back( SSDBAsyncResult() );
+			SSDBAsyncResult& Result = aResults.back();
+			Result.Call = pClient->aPending.front();
+			Result.bFailed = false;
+			for ( size_t iField = 0; iField < pPacket->size(); iField++ )
+				Result.aResponse.push_back( ( *pPacket )[ iField ].String() );
+			pClient->aPending.pop_front();
+		}
+	}
+	if ( bError )
+	{
+		pLink->mark_error();
+		while ( !pClient->aPending.empty() )
+		{
+			aResults.push_back( SSDBAsyncResult() );
+			aResults.back().Call = pClient->aPending.front();
+			aResults.back().bFailed = true;
+			pClient->aPending.pop_front();
+		}
+		return -1;
+	}
+	return 0;
+}
+
+/// wait for responses of async clients and resume the coroutines waiting for them
+// @function poll
+// @param timeout number milliseconds to wait, 0 returns at once
+// @return number count of resumed coroutines
+// @return string error message of the first resumed coroutine which failed [ optional ]
+int ssdb_poll( lua_State* l )
+{
+	int iTimeout = lua_gettop( l ) > 0 ? ( int )lua_tointeger( l, 1 ) : 0;
+	std::vector<SSDBAsyncResult> aResults;
+
+	std::vector<SSDBAsyncClient*> aClients;
+	push_async_clients( l );
+	lua_pushnil( l );
+	while ( lua_next( l, -2 ) != 0 )
+	{
+		lua_pop( l, 1 );
+		SSDBAsyncClient* pClient = *( SSDBAsyncClient** )lua_touserdata( l, -1 );
+		if ( pClient )
+			aClients.push_back( pClient );
+	}
+	lua_pop( l, 1 );
+
+	fd_set ReadSet, WriteSet;
+	FD_ZERO( &ReadSet );
+	FD_ZERO( &WriteSet );
+	int iMaxFd = -1;
+	for ( size_t i = 0; i < aClients.size(); i++ )
+	{
+		SSDBAsyncClient* pClient = aClients[ i ];
+		if ( pClient->aPending.empty() )
+			continue;
+		if ( pClient->pLink->error() )
+		{
+			async_client_io( pClient, false, false, aResults );
+			continue;
+		}
+		int iFd = pClient->pLink->fd();
+		FD_SET( iFd, &ReadSet );
+		if ( !pClient->pLink->output->empty() )
+			FD_SET( iFd, &WriteSet );
+		iMaxFd = iFd > iMaxFd ? iFd : iMaxFd;
+	}
+
+	if ( iMaxFd >= 0 )
+	{
+		struct timeval Timeout;
+		Timeout.tv_sec = aResults.empty() ? iTimeout / 1000 : 0;
+		Timeout.tv_usec = aResults.empty() ? ( iTimeout % 1000 ) * 1000 : 0;
+		if ( ::select( iMaxFd + 1, &ReadSet, &WriteSet, NULL, &Timeout ) > 0 )
+		{
+			for ( size_t i = 0; i < aClients.size(); i++ )
+			{
+				SSDBAsyncClient* pClient = aClients[ i ];
+				if ( pClient->aPending.empty() || pClient->pLink->error() )
+					continue;
+				int iFd = pClient->pLink->fd();
+				bool bRead = FD_ISSET( iFd, &ReadSet ) != 0;
+				bool bWrite = FD_ISSET( iFd, &WriteSet ) != 0;
+				if ( bRead || bWrite )
+					async_client_io( pClient, bRead, bWrite, aResults );
+			}
+		}
+	}
+
+	// clients are not touched any more, resumed coroutines may release them
+	int iResumed = 0;
+	bool bHasError = false;
+	for ( size_t i = 0; i < aResults.size(); i++ )
+	{
+		SSDBAsyncResult& Result = aResults[ i ];
+		lua_State* pThread = Result.Call.pThread;
+		lua_checkstack( pThread, LUA_MINSTACK );
+		int iResults = async_push_reply( pThread, Result.Call.iReply, Result.bFailed, Result.aResponse );
+		int iStatus = lua_resume( pThread, iResults );
+		if ( iStatus != 0 && iStatus != LUA_YIELD && !bHasError )
+		{
+			bHasError = true;
+			lua_xmove( pThread, l, 1 );
+		}
+		luaL_unref( l, LUA_REGISTRYINDEX, Result.Call.iThreadRef );
+		luaL_unref( l, LUA_REGISTRYINDEX, Result.Call.iClientRef );
+		iResumed++;
+	}
+
+	lua_pushnumber( l, iResumed );
+	if ( bHasError )
+	{
+		lua_insert( l, -2 );
+		return 2;
+	}
+	return 1;
+}
+
+static const SSDBAsyncCommand ssdb_async_commands[] = {
+	{ "request",      "",             EAsyncReplyList,      EAsyncArgsPlain },
+	{ "dbsize",       "dbsize",       EAsyncReplyNumber,    EAsyncArgsPlain },
+	{ "set",          "set",          EAsyncReplyStatus,    EAsyncArgsPlain },
+	{ "set_ttl",      "setx",         EAsyncReplyStatus,    EAsyncArgsPlain },
+	{ "get",          "get",          EAsyncReplyString,    EAsyncArgsPlain },
+	{ "del",          "del",          EAsyncReplyStatus,    EAsyncArgsPlain },
+	{ "inc",          "incr",         EAsyncReplyNumber,    EAsyncArgsPlain },
+	{ "keys",         "keys",         EAsyncReplyList,      EAsyncArgsPlain },
+	{ "scan",         "scan",         EAsyncReplyMap,       EAsyncArgsPlain },
+	{ "rscan",        "rscan",        EAsyncReplyMap,       EAsyncArgsPlain },
+	{ "multi_del",    "multi_del",    EAsyncReplyStatus,    EAsyncArgsPlain },
+	{ "multi_set",    "multi_set",    EAsyncReplyStatus,    EAsyncArgsPairs },
+	{ "multi_get",    "multi_get",    EAsyncReplyMap,       EAsyncArgsPlain },
+
+	{ "hget",         "hget",         EAsyncReplyString,    EAsyncArgsPlain },
+	{ "hset",         "hset",         EAsyncReplyStatus,    EAsyncArgsPlain },
+	{ "hdel",         "hdel",         EAsyncReplyStatus,    EAsyncArgsPlain },
+	{ "hincr",        "hincr",        EAsyncReplyNumber,    EAsyncArgsPlain },
+	{ "hsize",        "hsize",        EAsyncReplyNumber,    EAsyncArgsPlain },
+	{ "hclear",       "hclear",       EAsyncReplyStatus,    EAsyncArgsPlain },
+	{ "hkeys",        "hkeys",        EAsyncReplyList,      EAsyncArgsPlain },
+	{ "hgetall",      "hgetall",      EAsyncReplyMap,       EAsyncArgsPlain },
+	{ "hscan",        "hscan",        EAsyncReplyMap,       EAsyncArgsPlain },
+	{ "hrscan",       "hrscan",       EAsyncReplyMap,       EAsyncArgsPlain },
+	{ "multi_hget",   "multi_hget",   EAsyncReplyMap,       EAsyncArgsPlain },
+	{ "multi_hset",   "multi_hset",   EAsyncReplyStatus,    EAsyncArgsPairs },
+	{ "multi_hdel",   "multi_hdel",   EAsyncReplyStatus,    EAsyncArgsPlain },
+
+	{ "qpush",        "qpush",        EAsyncReplyNumber,    EAsyncArgsPlain },
+	{ "qpop",         "qpop",         EAsyncReplyList,      EAsyncArgsPlain },
+	{ "qclear",       "qclear",       EAsyncReplyStatus,    EAsyncArgsPlain },
+	{ "qslice",       "qslice",       EAsyncReplyList,      EAsyncArgsPlain },
+
+	{ "zset",         "zset",         EAsyncReplyStatus,    EAsyncArgsPlain },
+	{ "zget",         "zget",         EAsyncReplyNumber,    EAsyncArgsPlain },
+	{ "zinc",         "zincr",        EAsyncReplyNumber,    EAsyncArgsPlain },
+	{ "zdel",         "zdel",         EAsyncReplyStatus,    EAsyncArgsPlain },
+	{ "zsize",        "zsize",        EAsyncReplyNumber,    EAsyncArgsPlain },
+	{ "zclear",       "zclear",       EAsyncReplyStatus,    EAsyncArgsPlain },
+	{ "zrange",       "zrange",       EAsyncReplyMapNumber, EAsyncArgsPlain },
+	{ "zrrange",      "zrrange",      EAsyncReplyMapNumber, EAsyncArgsPlain },
+	{ "zkeys",        "zkeys",        EAsyncReplyList,      EAsyncArgsPlain },
+	{ "zscan",        "zscan",        EAsyncReplyMapNumber, EAsyncArgsPlain },
+	{ "zrscan",       "zrscan",       EAsyncReplyMapNumber, EAsyncArgsPlain },
+	{ "multi_zget",   "multi_zget",   EAsyncReplyMapNumber, EAsyncArgsPlain },
+	{ "multi_zset",   "multi_zset",   EAsyncReplyStatus,    EAsyncArgsPairs },
+	{ "multi_zdel",   "multi_zdel",   EAsyncReplyStatus,    EAsyncArgsPlain },
+
+	{ NULL, NULL, 0, 0 }
+};
+
 //--------------------------------------------------------
 static const luaL_Reg ssdb_metatable[] = {
 	{ "dbsize",       ssdb_client_dbsize },
@@ -1497,6 +2224,7 @@ static const luaL_Reg ssdb_metatable[] = {
 	{ "keys",         ssdb_client_keys },
 	{ "scan",         ssdb_client_scan },
 	{ "rscan",        ssdb_client_rscan },
+	{ "scan_iter",    ssdb_client_scan_iter },
 
 	{ "multi_del",    ssdb_client_multi_del },
 	{ "multi_set",    ssdb_client_multi_set },
@@ -1512,6 +2240,8 @@ static const luaL_Reg ssdb_metatable[] = {
 	{ "hgetall",    ssdb_client_hgetall },
 	{ "hscan",      ssdb_client_hscan },
 	{ "hrscan",     ssdb_client_hrscan },
+	{ "hscan_iter",   ssdb_client_hscan_iter },
+	{ "hgetall_iter", ssdb_client_hgetall_iter },
 	{ "multi_hget", ssdb_client_multi_hget },
 	{ "multi_hset", ssdb_client_multi_hset },
 	{ "multi_hdel", ssdb_client_multi_hdel },
@@ -1533,6 +2263,7 @@ static const luaL_Reg ssdb_metatable[] = {
 	{ "keys",       ssdb_client_zkeys },
 	{ "zscan",      ssdb_client_zscan },
 	{ "zrscan",     ssdb_client_zrscan },
+	{ "zscan_iter", ssdb_client_zscan_iter },
 
 	{ "multi_zget", ssdb_client_multi_zget },
 	{ "multi_zdel", ssdb_client_multi_zdel },
@@ -1546,6 +2277,8 @@ static const luaL_Reg ssdb_metatable[] = {
 //--------------------------------------------------------
 static const luaL_Reg ssdb_client[] = {
 	{ "connect", ssdb_connect },
+	{ "connect_async", ssdb_connect_async },
+	{ "poll", ssdb_poll },
 	{ NULL, NULL }
 };
 
@@ -1570,6 +2303,24 @@ int luaopen_ssdb( lua_State *l )
 	lua_pushcfunction( l, ssdb_client_gc );
 	lua_setfield( l, -2, "__gc" );
 
+	luaL_newmetatable( l, DLUASSDBITERMETA );
+	lua_pushcfunction( l, ssdb_iter_gc );
+	lua_setfield( l, -2, "__gc" );
+
+	luaL_newmetatable( l, DLUASSDBASYNCMETA );
+	lua_newtable( l );
+	for ( const SSDBAsyncCommand* pCommand = ssdb_async_commands; pCommand->sName; pCommand++ )
+	{
+		lua_pushlightuserdata( l, ( void* )pCommand );
+		lua_pushcclosure( l, ssdb_async_call, 1 );
+		lua_setfield( l, -2, pCommand->sName );
+	}
+	lua_pushcfunction( l, ssdb_async_client_pending );
+	lua_setfield( l, -2, "pending" );
+	lua_setfield( l, -2, "__index" );
+	lua_pushcfunction( l, ssdb_async_client_gc );
+	lua_setfield( l, -2, "__gc" );
+
 	luaL_register( l, DLUASSDBNAME, ssdb_client );
 	return 1;
 }
\ No newline at end of file
@@ -14,6 +14,9 @@ extern "C"
 
 #define DLUASSDBNAME "ssdb"
 #define DLUASSDBMETA ":ssdbmeta:"
+#define DLUASSDBASYNCMETA ":ssdbasyncmeta:"
+#define DLUASSDBITERMETA ":ssdbitermeta:"
+#define DLUASSDBASYNCLIST ":ssdbasyncclients:"
 
 EXTERNC int luaopen_ssdb(lua_State *l);
 
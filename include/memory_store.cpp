@@ -0,0 +1,1374 @@
+#include "memory_store.h"
+#include <stdlib.h>
+#include <chrono>
+#include <new>
+
+static inline int64_t now_ms(){
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/******************** SortedSet *************************/
+
+// (score, key) of node before (score, key)
+static inline bool node_less(const SortedSet::Node *node, int64_t score, const Bytes &key){
+	return node->score < score || (node->score == score && Bytes(node->key) < key);
+}
+
+SortedSet::SortedSet(){
+	level_ = 1;
+	length_ = 0;
+	random_ = 0x9e3779b97f4a7c15ULL ^ (uint64_t)(uintptr_t)this;
+	head_ = this->create_node(MAX_LEVEL, Bytes(), 0);
+	tail_ = NULL;
+}
+
+SortedSet::~SortedSet(){
+	Node *node = head_->level[0].forward;
+	while(node){
+		Node *next = node->level[0].forward;
+		this->free_node(node);
+		node = next;
+	}
+	this->free_node(head_);
+}
+
+SortedSet::Node* SortedSet::create_node(int level, const Bytes &key, int64_t score){
+	// the levels are allocated with the node
+	Node *node = (Node *)malloc(sizeof(Node) + (level - 1) * sizeof(Node::Level));
+	new (&node->key) std::string(key.data(), key.size());
+	node->score = score;
+	node->backward = NULL;
+	for(int i=0; i<level; i++){
+		node->level[i].forward = NULL;
+		node->level[i].span = 0;
+	}
+	return node;
+}
+
+void SortedSet::free_node(Node *node){
+	node->key.~basic_string();
+	free(node);
+}
+
+// a level above another with probability 1/4
+int SortedSet::random_level(){
+	// xorshift64*
+	random_ ^= random_ >> 12;
+	random_ ^= random_ << 25;
+	random_ ^= random_ >> 27;
+	uint64_t r = random_ * 0x2545f4914f6cdd1dULL;
+	int level = 1;
+	while(level < MAX_LEVEL && (r & 3) == 0){
+		level ++;
+		r >>= 2;
+	}
+	return level;
+}
+
+void SortedSet::insert_node(const Bytes &key, int64_t score){
+	Node *update[MAX_LEVEL];
+	int64_t rank[MAX_LEVEL];
+	Node *x = head_;
+	for(int i=level_-1; i>=0; i--){
+		rank[i] = (i == level_-1)? 0 : rank[i+1];
+		while(x->level[i].forward && node_less(x->level[i].forward, score, key)){
+			rank[i] += x->level[i].span;
+			x = x->level[i].forward;
+		}
+		update[i] = x;
+	}
+	int level = this->random_level();
+	if(level > level_){
+		for(int i=level_; i<level; i++){
+			rank[i] = 0;
+			update[i] = head_;
+			update[i]->level[i].span = length_;
+		}
+		level_ = level;
+	}
+	x = this->create_node(level, key, score);
+	for(int i=0; i<level; i++){
+		x->level[i].forward = update[i]->level[i].forward;
+		update[i]->level[i].forward = x;
+		x->level[i].span = update[i]->level[i].span - (rank[0] - rank[i]);
+		update[i]->level[i].span = (rank[0] - rank[i]) + 1;
+	}
+	for(int i=level; i<level_; i++){
+		update[i]->level[i].span ++;
+	}
+	x->backward = (update[0] == head_)? NULL : update[0];
+	if(x->level[0].forward){
+		x->level[0].forward->backward = x;
+	}else{
+		tail_ = x;
+	}
+	length_ ++;
+}
+
+void SortedSet::delete_node(const Bytes &key, int64_t score){
+	Node *update[MAX_LEVEL];
+	Node *x = head_;
+	for(int i=level_-1; i>=0; i--){
+		while(x->level[i].forward && node_less(x->level[i].forward, score, key)){
+			x = x->level[i].forward;
+		}
+		update[i] = x;
+	}
+	x = x->level[0].forward;
+	for(int i=0; i<level_; i++){
+		if(update[i]->level[i].forward == x){
+			update[i]->level[i].span += x->level[i].span - 1;
+			update[i]->level[i].forward = x->level[i].forward;
+		}else{
+			update[i]->level[i].span -= 1;
+		}
+	}
+	if(x->level[0].forward){
+		x->level[0].forward->backward = x->backward;
+	}else{
+		tail_ = x->backward;
+	}
+	while(level_ > 1 && head_->level[level_-1].forward == NULL){
+		level_ --;
+	}
+	length_ --;
+	this->free_node(x);
+}
+
+bool SortedSet::get(const Bytes &key, int64_t *score) const{
+	const int64_t *s = scores_.find(key);
+	if(s == NULL){
+		return false;
+	}
+	*score = *s;
+	return true;
+}
+
+bool SortedSet::set(const Bytes &key, int64_t score){
+	bool created;
+	int64_t *s = scores_.insert(key, &created);
+	if(!created){
+		if(*s == score){
+			return false;
+		}
+		this->delete_node(key, *s);
+	}
+	*s = score;
+	this->insert_node(key, score);
+	return created;
+}
+
+bool SortedSet::del(const Bytes &key){
+	const int64_t *s = scores_.find(key);
+	if(s == NULL){
+		return false;
+	}
+	this->delete_node(key, *s);
+	scores_.erase(key);
+	return true;
+}
+
+int64_t SortedSet::rank(const Bytes &key) const{
+	int64_t score;
+	if(!this->get(key, &score)){
+		return -1;
+	}
+	int64_t rank = 0;
+	const Node *x = head_;
+	for(int i=level_-1; i>=0; i--){
+		// up to and including (score, key)
+		while(x->level[i].forward && (node_less(x->level[i].forward, score, key)
+			|| (x->level[i].forward->score == score && Bytes(x->level[i].forward->key) == key)))
+		{
+			rank += x->level[i].span;
+			x = x->level[i].forward;
+		}
+		if(x != head_ && Bytes(x->key) == key){
+			return rank - 1;
+		}
+	}
+	return -1;
+}
+
+const SortedSet::Node* SortedSet::at(int64_t rank) const{
+	if(rank < 0 || rank >= length_){
+		return NULL;
+	}
+	// spans count from 1
+	int64_t target = rank + 1;
+	int64_t traversed = 0;
+	const Node *x = head_;
+	for(int i=level_-1; i>=0; i--){
+		while(x->level[i].forward && traversed + x->level[i].span <= target){
+			traversed += x->level[i].span;
+			x = x->level[i].forward;
+		}
+		if(traversed == target){
+			return x;
+		}
+	}
+	return NULL;
+}
+
+const SortedSet::Node* SortedSet::lower_bound(int64_t score, const Bytes &key) const{
+	const Node *x = head_;
+	for(int i=level_-1; i>=0; i--){
+		while(x->level[i].forward && node_less(x->level[i].forward, score, key)){
+			x = x->level[i].forward;
+		}
+	}
+	return x->level[0].forward;
+}
+
+/******************** MemoryStore *************************/
+
+typedef std::vector<std::string> Resp;
+
+const MemoryStore::Command MemoryStore::commands[] = {
+	{"ping",			&MemoryStore::proc_ping,			1},
+	{"dbsize",			&MemoryStore::proc_dbsize,			1},
+	{"flushdb",			&MemoryStore::proc_flushdb,			1},
+	{"get_kv_range",	&MemoryStore::proc_get_kv_range,	1},
+	{"set_kv_range",	&MemoryStore::proc_set_kv_range,	3},
+
+	{"get",				&MemoryStore::proc_get,				2},
+	{"set",				&MemoryStore::proc_set,				3},
+	{"setx",			&MemoryStore::proc_setx,			4},
+	{"setnx",			&MemoryStore::proc_setnx,			3},
+	{"getset",			&MemoryStore::proc_getset,			3},
+	{"del",				&MemoryStore::proc_del,				2},
+	{"incr",			&MemoryStore::proc_incr,			2},
+	{"decr",			&MemoryStore::proc_decr,			2},
+	{"exists",			&MemoryStore::proc_exists,			2},
+	{"expire",			&MemoryStore::proc_expire,			3},
+	{"ttl",				&MemoryStore::proc_ttl,				2},
+	{"keys",			&MemoryStore::proc_keys,			4},
+	{"rkeys",			&MemoryStore::proc_rkeys,			4},
+	{"scan",			&MemoryStore::proc_scan,			4},
+	{"rscan",			&MemoryStore::proc_rscan,			4},
+	{"multi_get",		&MemoryStore::proc_multi_get,		2},
+	{"multi_set",		&MemoryStore::proc_multi_set,		3},
+	{"multi_del",		&MemoryStore::proc_multi_del,		2},
+
+	{"hget",			&MemoryStore::proc_hget,			3},
+	{"hset",			&MemoryStore::proc_hset,			4},
+	{"hdel",			&MemoryStore::proc_hdel,			3},
+	{"hincr",			&MemoryStore::proc_hincr,			3},
+	{"hdecr",			&MemoryStore::proc_hdecr,			3},
+	{"hexists",			&MemoryStore::proc_hexists,			3},
+	{"hsize",			&MemoryStore::proc_hsize,			2},
+	{"hclear",			&MemoryStore::proc_hclear,			2},
+	{"hkeys",			&MemoryStore::proc_hkeys,			5},
+	{"hgetall",			&MemoryStore::proc_hgetall,			2},
+	{"hscan",			&MemoryStore::proc_hscan,			5},
+	{"hrscan",			&MemoryStore::proc_hrscan,			5},
+	{"hlist",			&MemoryStore::proc_hlist,			4},
+	{"hrlist",			&MemoryStore::proc_hrlist,			4},
+	{"multi_hget",		&MemoryStore::proc_multi_hget,		3},
+	{"multi_hset",		&MemoryStore::proc_multi_hset,		4},
+	{"multi_hdel",		&MemoryStore::proc_multi_hdel,		3},
+
+	{"zget",			&MemoryStore::proc_zget,			3},
+	{"zset",			&MemoryStore::proc_zset,			4},
+	{"zdel",			&MemoryStore::proc_zdel,			3},
+	{"zincr",			&MemoryStore::proc_zincr,			3},
+	{"zdecr",			&MemoryStore::proc_zdecr,			3},
+	{"zexists",			&MemoryStore::proc_zexists,			3},
+	{"zsize",			&MemoryStore::proc_zsize,			2},
+	{"zclear",			&MemoryStore::proc_zclear,			2},
+	{"zrank",			&MemoryStore::proc_zrank,			3},
+	{"zrrank",			&MemoryStore::proc_zrrank,			3},
+	{"zrange",			&MemoryStore::proc_zrange,			4},
+	{"zrrange",			&MemoryStore::proc_zrrange,			4},
+	{"zkeys",			&MemoryStore::proc_zkeys,			6},
+	{"zscan",			&MemoryStore::proc_zscan,			6},
+	{"zrscan",			&MemoryStore::proc_zrscan,			6},
+	{"zlist",			&MemoryStore::proc_zlist,			4},
+	{"zrlist",			&MemoryStore::proc_zrlist,			4},
+	{"multi_zget",		&MemoryStore::proc_multi_zget,		3},
+	{"multi_zset",		&MemoryStore::proc_multi_zset,		4},
+	{"multi_zdel",		&MemoryStore::proc_multi_zdel,		3},
+
+	{"qpush",			&MemoryStore::proc_qpush_back,		3},
+	{"qpush_back",		&MemoryStore::proc_qpush_back,		3},
+	{"qpush_front",		&MemoryStore::proc_qpush_front,		3},
+	{"qpop",			&MemoryStore::proc_qpop_front,		2},
+	{"qpop_front",		&MemoryStore::proc_qpop_front,		2},
+	{"qpop_back",		&MemoryStore::proc_qpop_back,		2},
+	{"qfront",			&MemoryStore::proc_qfront,			2},
+	{"qback",			&MemoryStore::proc_qback,			2},
+	{"qsize",			&MemoryStore::proc_qsize,			2},
+	{"qget",			&MemoryStore::proc_qget,			3},
+	{"qset",			&MemoryStore::proc_qset,			4},
+	{"qslice",			&MemoryStore::proc_qslice,			4},
+	{"qrange",			&MemoryStore::proc_qrange,			4},
+	{"qclear",			&MemoryStore::proc_qclear,			2},
+
+	{NULL,				NULL,								0}
+};
+
+static inline void reply_ok(Resp *resp){
+	resp->push_back("ok");
+}
+
+static inline void reply_int(Resp *resp, int64_t val){
+	resp->push_back("ok");
+	resp->push_back(str(val));
+}
+
+static inline void reply_str(Resp *resp, const std::string &val){
+	resp->push_back("ok");
+	resp->push_back(val);
+}
+
+static inline void reply_not_found(Resp *resp){
+	resp->push_back("not_found");
+}
+
+static inline void reply_error(Resp *resp, const char *code, const char *msg){
+	resp->push_back(code);
+	resp->push_back(msg);
+}
+
+static inline bool to_int64(const Bytes &b, int64_t *val){
+	return parse_int64(b.data(), b.size(), val) == 0;
+}
+
+// val + by, false on overflow
+static inline bool add_int64(int64_t val, int64_t by, int64_t *ret){
+	if((by > 0 && val > INT64_MAX - by) || (by < 0 && val < INT64_MIN - by)){
+		return false;
+	}
+	*ret = val + by;
+	return true;
+}
+
+MemoryStore::MemoryStore(){
+	for(const Command *cmd = commands; cmd->name; cmd++){
+		bool created;
+		*procs_.insert(Bytes(cmd->name), &created) = cmd;
+	}
+}
+
+MemoryStore::~MemoryStore(){
+	this->clear_all();
+}
+
+void MemoryStore::execute(const Bytes *req, int num, std::vector<std::string> *resp){
+	resp->clear();
+	if(num == 0){
+		reply_error(resp, "client_error", "empty request");
+		return;
+	}
+	const Command *const *cmd = procs_.find(req[0]);
+	if(cmd == NULL){
+		// commands are case insensitive
+		std::string name = req[0].String();
+		strtolower(&name);
+		cmd = procs_.find(Bytes(name));
+	}
+	if(cmd == NULL){
+		resp->push_back("client_error");
+		resp->push_back("Unknown Command: " + req[0].String());
+		return;
+	}
+	if(num < (*cmd)->min_args){
+		reply_error(resp, "client_error", "wrong number of arguments");
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	(this->*(*cmd)->proc)(req, num, resp);
+}
+
+void MemoryStore::clear(){
+	std::lock_guard<std::mutex> lock(mutex_);
+	this->clear_all();
+}
+
+void MemoryStore::clear_all(){
+	for(int i=0; i<hashes_.capacity(); i++){
+		if(hashes_.used(i)){
+			delete hashes_.val(i);
+		}
+	}
+	for(int i=0; i<zsets_.capacity(); i++){
+		if(zsets_.used(i)){
+			delete zsets_.val(i);
+		}
+	}
+	for(int i=0; i<queues_.capacity(); i++){
+		if(queues_.used(i)){
+			delete queues_.val(i);
+		}
+	}
+	kv_.clear();
+	hashes_.clear();
+	zsets_.clear();
+	queues_.clear();
+}
+
+MemoryStore::KvValue* MemoryStore::kv_find(const Bytes &key){
+	KvValue *v = kv_.find(key);
+	if(v && v->expire_ms && v->expire_ms <= now_ms()){
+		kv_.erase(key);
+		return NULL;
+	}
+	return v;
+}
+
+void MemoryStore::kv_expire(){
+	int64_t now = now_ms();
+	for(int i=0; i<kv_.capacity(); i++){
+		if(kv_.used(i)){
+			int64_t expire_ms = kv_.val(i).expire_ms;
+			if(expire_ms && expire_ms <= now){
+				kv_.erase_at(i);
+			}
+		}
+	}
+}
+
+MemoryStore::Hash* MemoryStore::hash_find(const Bytes &name, bool create){
+	Hash **hash = hashes_.find(name);
+	if(hash){
+		return *hash;
+	}
+	if(!create){
+		return NULL;
+	}
+	bool created;
+	hash = hashes_.insert(name, &created);
+	*hash = new Hash();
+	return *hash;
+}
+
+SortedSet* MemoryStore::zset_find(const Bytes &name, bool create){
+	SortedSet **zset = zsets_.find(name);
+	if(zset){
+		return *zset;
+	}
+	if(!create){
+		return NULL;
+	}
+	bool created;
+	zset = zsets_.insert(name, &created);
+	*zset = new SortedSet();
+	return *zset;
+}
+
+MemoryStore::Queue* MemoryStore::queue_find(const Bytes &name, bool create){
+	Queue **queue = queues_.find(name);
+	if(queue){
+		return *queue;
+	}
+	if(!create){
+		return NULL;
+	}
+	bool created;
+	queue = queues_.insert(name, &created);
+	*queue = new Queue();
+	return *queue;
+}
+
+// a container emptied is removed, as the server does not keep it either
+void MemoryStore::drop_empty(const Bytes &name, Hash *hash){
+	if(hash && hash->empty()){
+		delete hash;
+		hashes_.erase(name);
+	}
+}
+
+void MemoryStore::drop_empty(const Bytes &name, SortedSet *zset){
+	if(zset && zset->size() == 0){
+		delete zset;
+		zsets_.erase(name);
+	}
+}
+
+void MemoryStore::drop_empty(const Bytes &name, Queue *queue){
+	if(queue && queue->empty()){
+		delete queue;
+		queues_.erase(name);
+	}
+}
+
+// orders the slots of an OpenHash by key
+template<class V>
+struct SlotLess{
+	const OpenHash<V> *table;
+	bool reverse;
+
+	bool operator()(int a, int b) const{
+		int r = Bytes(table->key(a)).compare(Bytes(table->key(b)));
+		return reverse? r > 0 : r < 0;
+	}
+};
+
+/**
+ * The slots of the keys after start, up to and including end, in order,
+ * at most limit of them. Backwards from before start, down to end, if
+ * reverse is set. An empty start or end is no limit.
+ */
+template<class V>
+static void sorted_slots(const OpenHash<V> &table, const Bytes &start, const Bytes &end,
+	uint64_t limit, bool reverse, std::vector<int> *slots)
+{
+	slots->clear();
+	for(int i=0; i<table.capacity(); i++){
+		if(!table.used(i)){
+			continue;
+		}
+		Bytes key(table.key(i));
+		if(!reverse){
+			if((!start.empty() && key <= start) || (!end.empty() && key > end)){
+				continue;
+			}
+		}else{
+			if((!start.empty() && key >= start) || (!end.empty() && key < end)){
+				continue;
+			}
+		}
+		slots->push_back(i);
+	}
+	SlotLess<V> less;
+	less.table = &table;
+	less.reverse = reverse;
+	if(limit < (uint64_t)slots->size()){
+		std::partial_sort(slots->begin(), slots->begin() + (size_t)limit, slots->end(), less);
+		slots->resize((size_t)limit);
+	}else{
+		std::sort(slots->begin(), slots->end(), less);
+	}
+}
+
+// the names in table in the range of req, for hlist and zlist
+template<class V>
+static void reply_names(const OpenHash<V> &table, const Bytes *req, bool reverse, Resp *resp){
+	std::vector<int> slots;
+	sorted_slots(table, req[1], req[2], req[3].Uint64(), reverse, &slots);
+	reply_ok(resp);
+	for(int i=0; i<(int)slots.size(); i++){
+		resp->push_back(table.key(slots[i]));
+	}
+}
+
+/******************** misc *************************/
+
+void MemoryStore::proc_ping(const Bytes *, int, Resp *resp){
+	reply_ok(resp);
+}
+
+// the bytes of all keys and values
+void MemoryStore::proc_dbsize(const Bytes *, int, Resp *resp){
+	this->kv_expire();
+	int64_t size = 0;
+	for(int i=0; i<kv_.capacity(); i++){
+		if(kv_.used(i)){
+			size += kv_.key(i).size() + kv_.val(i).val.size();
+		}
+	}
+	for(int i=0; i<hashes_.capacity(); i++){
+		if(!hashes_.used(i)){
+			continue;
+		}
+		Hash *hash = hashes_.val(i);
+		for(int j=0; j<hash->capacity(); j++){
+			if(hash->used(j)){
+				size += hashes_.key(i).size() + hash->key(j).size() + hash->val(j).size();
+			}
+		}
+	}
+	for(int i=0; i<zsets_.capacity(); i++){
+		if(!zsets_.used(i)){
+			continue;
+		}
+		SortedSet *zset = zsets_.val(i);
+		for(const SortedSet::Node *node = zset->first(); node; node = SortedSet::next(node)){
+			size += zsets_.key(i).size() + node->key.size() + sizeof(int64_t);
+		}
+	}
+	for(int i=0; i<queues_.capacity(); i++){
+		if(!queues_.used(i)){
+			continue;
+		}
+		Queue *queue = queues_.val(i);
+		for(int64_t j=0; j<queue->size(); j++){
+			size += queues_.key(i).size() + queue->at(j).size();
+		}
+	}
+	reply_int(resp, size);
+}
+
+void MemoryStore::proc_flushdb(const Bytes *, int, Resp *resp){
+	this->clear_all();
+	reply_ok(resp);
+}
+
+void MemoryStore::proc_get_kv_range(const Bytes *, int, Resp *resp){
+	reply_ok(resp);
+	resp->push_back("");
+	resp->push_back("");
+}
+
+void MemoryStore::proc_set_kv_range(const Bytes *, int, Resp *resp){
+	reply_ok(resp);
+}
+
+/******************** KV *************************/
+
+void MemoryStore::proc_get(const Bytes *req, int, Resp *resp){
+	KvValue *v = this->kv_find(req[1]);
+	if(v){
+		reply_str(resp, v->val);
+	}else{
+		reply_not_found(resp);
+	}
+}
+
+void MemoryStore::proc_set(const Bytes *req, int, Resp *resp){
+	bool created;
+	KvValue *v = kv_.insert(req[1], &created);
+	v->val.assign(req[2].data(), req[2].size());
+	v->expire_ms = 0;
+	reply_int(resp, 1);
+}
+
+void MemoryStore::proc_setx(const Bytes *req, int, Resp *resp){
+	int64_t ttl;
+	if(!to_int64(req[3], &ttl) || ttl <= 0){
+		reply_error(resp, "client_error", "invalid ttl");
+		return;
+	}
+	bool created;
+	KvValue *v = kv_.insert(req[1], &created);
+	v->val.assign(req[2].data(), req[2].size());
+	v->expire_ms = now_ms() + ttl * 1000;
+	reply_int(resp, 1);
+}
+
+void MemoryStore::proc_setnx(const Bytes *req, int num, Resp *resp){
+	if(this->kv_find(req[1])){
+		reply_int(resp, 0);
+		return;
+	}
+	this->proc_set(req, num, resp);
+}
+
+void MemoryStore::proc_getset(const Bytes *req, int, Resp *resp){
+	KvValue *v = this->kv_find(req[1]);
+	if(v){
+		reply_str(resp, v->val);
+	}else{
+		reply_not_found(resp);
+		bool created;
+		v = kv_.insert(req[1], &created);
+	}
+	v->val.assign(req[2].data(), req[2].size());
+	v->expire_ms = 0;
+}
+
+void MemoryStore::proc_del(const Bytes *req, int, Resp *resp){
+	kv_.erase(req[1]);
+	reply_int(resp, 1);
+}
+
+void MemoryStore::kv_incr(const Bytes &key, int64_t by, Resp *resp){
+	int64_t val = 0;
+	KvValue *v = this->kv_find(key);
+	if(v && !to_int64(Bytes(v->val), &val)){
+		reply_error(resp, "error", "value is not an integer or out of range");
+		return;
+	}
+	if(!add_int64(val, by, &val)){
+		reply_error(resp, "error", "value is not an integer or out of range");
+		return;
+	}
+	if(v == NULL){
+		bool created;
+		v = kv_.insert(key, &created);
+	}
+	v->val = str(val);
+	reply_int(resp, val);
+}
+
+void MemoryStore::proc_incr(const Bytes *req, int num, Resp *resp){
+	int64_t by = 1;
+	if(num > 2 && !to_int64(req[2], &by)){
+		reply_error(resp, "client_error", "invalid increment");
+		return;
+	}
+	this->kv_incr(req[1], by, resp);
+}
+
+void MemoryStore::proc_decr(const Bytes *req, int num, Resp *resp){
+	int64_t by = 1;
+	if(num > 2 && !to_int64(req[2], &by)){
+		reply_error(resp, "client_error", "invalid increment");
+		return;
+	}
+	this->kv_incr(req[1], -by, resp);
+}
+
+void MemoryStore::proc_exists(const Bytes *req, int, Resp *resp){
+	reply_int(resp, this->kv_find(req[1])? 1 : 0);
+}
+
+void MemoryStore::proc_expire(const Bytes *req, int, Resp *resp){
+	int64_t ttl;
+	if(!to_int64(req[2], &ttl)){
+		reply_error(resp, "client_error", "invalid ttl");
+		return;
+	}
+	KvValue *v = this->kv_find(req[1]);
+	if(v == NULL){
+		reply_int(resp, 0);
+		return;
+	}
+	if(ttl > 0){
+		v->expire_ms = now_ms() + ttl * 1000;
+	}else{
+		kv_.erase(req[1]);
+	}
+	reply_int(resp, 1);
+}
+
+// seconds left, -1 if the key has no ttl or does not exist
+void MemoryStore::proc_ttl(const Bytes *req, int, Resp *resp){
+	KvValue *v = this->kv_find(req[1]);
+	if(v == NULL || v->expire_ms == 0){
+		reply_int(resp, -1);
+		return;
+	}
+	reply_int(resp, (v->expire_ms - now_ms() + 999) / 1000);
+}
+
+void MemoryStore::kv_range(const Bytes *req, bool reverse, bool with_vals, Resp *resp){
+	this->kv_expire();
+	std::vector<int> slots;
+	sorted_slots(kv_, req[1], req[2], req[3].Uint64(), reverse, &slots);
+	reply_ok(resp);
+	for(int i=0; i<(int)slots.size(); i++){
+		resp->push_back(kv_.key(slots[i]));
+		if(with_vals){
+			resp->push_back(kv_.val(slots[i]).val);
+		}
+	}
+}
+
+void MemoryStore::proc_keys(const Bytes *req, int, Resp *resp){
+	this->kv_range(req, false, false, resp);
+}
+
+void MemoryStore::proc_rkeys(const Bytes *req, int, Resp *resp){
+	this->kv_range(req, true, false, resp);
+}
+
+void MemoryStore::proc_scan(const Bytes *req, int, Resp *resp){
+	this->kv_range(req, false, true, resp);
+}
+
+void MemoryStore::proc_rscan(const Bytes *req, int, Resp *resp){
+	this->kv_range(req, true, true, resp);
+}
+
+void MemoryStore::proc_multi_get(const Bytes *req, int num, Resp *resp){
+	reply_ok(resp);
+	for(int i=1; i<num; i++){
+		KvValue *v = this->kv_find(req[i]);
+		if(v){
+			resp->push_back(req[i].String());
+			resp->push_back(v->val);
+		}
+	}
+}
+
+void MemoryStore::proc_multi_set(const Bytes *req, int num, Resp *resp){
+	if(num % 2 != 1){
+		reply_error(resp, "client_error", "wrong number of arguments");
+		return;
+	}
+	for(int i=1; i<num; i+=2){
+		bool created;
+		KvValue *v = kv_.insert(req[i], &created);
+		v->val.assign(req[i+1].data(), req[i+1].size());
+		v->expire_ms = 0;
+	}
+	reply_int(resp, (num - 1) / 2);
+}
+
+void MemoryStore::proc_multi_del(const Bytes *req, int num, Resp *resp){
+	for(int i=1; i<num; i++){
+		kv_.erase(req[i]);
+	}
+	reply_int(resp, num - 1);
+}
+
+/******************** hash *************************/
+
+void MemoryStore::proc_hget(const Bytes *req, int, Resp *resp){
+	Hash *hash = this->hash_find(req[1], false);
+	std::string *val = hash? hash->find(req[2]) : NULL;
+	if(val){
+		reply_str(resp, *val);
+	}else{
+		reply_not_found(resp);
+	}
+}
+
+void MemoryStore::proc_hset(const Bytes *req, int, Resp *resp){
+	Hash *hash = this->hash_find(req[1], true);
+	bool created;
+	hash->insert(req[2], &created)->assign(req[3].data(), req[3].size());
+	reply_int(resp, created? 1 : 0);
+}
+
+void MemoryStore::proc_hdel(const Bytes *req, int, Resp *resp){
+	Hash *hash = this->hash_find(req[1], false);
+	bool found = hash && hash->erase(req[2]);
+	this->drop_empty(req[1], hash);
+	reply_int(resp, found? 1 : 0);
+}
+
+void MemoryStore::hash_incr(const Bytes &name, const Bytes &key, int64_t by, Resp *resp){
+	int64_t val = 0;
+	Hash *hash = this->hash_find(name, false);
+	std::string *v = hash? hash->find(key) : NULL;
+	if(v && !to_int64(Bytes(*v), &val)){
+		reply_error(resp, "error", "value is not an integer or out of range");
+		return;
+	}
+	if(!add_int64(val, by, &val)){
+		reply_error(resp, "error", "value is not an integer or out of range");
+		return;
+	}
+	if(v == NULL){
+		bool created;
+		v = this->hash_find(name, true)->insert(key, &created);
+	}
+	*v = str(val);
+	reply_int(resp, val);
+}
+
+void MemoryStore::proc_hincr(const Bytes *req, int num, Resp *resp){
+	int64_t by = 1;
+	if(num > 3 && !to_int64(req[3], &by)){
+		reply_error(resp, "client_error", "invalid increment");
+		return;
+	}
+	this->hash_incr(req[1], req[2], by, resp);
+}
+
+void MemoryStore::proc_hdecr(const Bytes *req, int num, Resp *resp){
+	int64_t by = 1;
+	if(num > 3 && !to_int64(req[3], &by)){
+		reply_error(resp, "client_error", "invalid increment");
+		return;
+	}
+	this->hash_incr(req[1], req[2], -by, resp);
+}
+
+void MemoryStore::proc_hexists(const Bytes *req, int, Resp *resp){
+	Hash *hash = this->hash_find(req[1], false);
+	reply_int(resp, (hash && hash->find(req[2]))? 1 : 0);
+}
+
+void MemoryStore::proc_hsize(const Bytes *req, int, Resp *resp){
+	Hash *hash = this->hash_find(req[1], false);
+	reply_int(resp, hash? hash->size() : 0);
+}
+
+void MemoryStore::proc_hclear(const Bytes *req, int, Resp *resp){
+	Hash *hash = this->hash_find(req[1], false);
+	int64_t size = 0;
+	if(hash){
+		size = hash->size();
+		delete hash;
+		hashes_.erase(req[1]);
+	}
+	reply_int(resp, size);
+}
+
+void MemoryStore::hash_range(const Bytes &name, const Bytes &start, const Bytes &end,
+	uint64_t limit, bool reverse, bool with_vals, Resp *resp)
+{
+	reply_ok(resp);
+	Hash *hash = this->hash_find(name, false);
+	if(hash == NULL){
+		return;
+	}
+	std::vector<int> slots;
+	sorted_slots(*hash, start, end, limit, reverse, &slots);
+	for(int i=0; i<(int)slots.size(); i++){
+		resp->push_back(hash->key(slots[i]));
+		if(with_vals){
+			resp->push_back(hash->val(slots[i]));
+		}
+	}
+}
+
+void MemoryStore::proc_hkeys(const Bytes *req, int, Resp *resp){
+	this->hash_range(req[1], req[2], req[3], req[4].Uint64(), false, false, resp);
+}
+
+void MemoryStore::proc_hgetall(const Bytes *req, int, Resp *resp){
+	this->hash_range(req[1], Bytes(), Bytes(), UINT64_MAX, false, true, resp);
+}
+
+void MemoryStore::proc_hscan(const Bytes *req, int, Resp *resp){
+	this->hash_range(req[1], req[2], req[3], req[4].Uint64(), false, true, resp);
+}
+
+void MemoryStore::proc_hrscan(const Bytes *req, int, Resp *resp){
+	this->hash_range(req[1], req[2], req[3], req[4].Uint64(), true, true, resp);
+}
+
+void MemoryStore::proc_hlist(const Bytes *req, int, Resp *resp){
+	reply_names(hashes_, req, false, resp);
+}
+
+void MemoryStore::proc_hrlist(const Bytes *req, int, Resp *resp){
+	reply_names(hashes_, req, true, resp);
+}
+
+void MemoryStore::proc_multi_hget(const Bytes *req, int num, Resp *resp){
+	reply_ok(resp);
+	Hash *hash = this->hash_find(req[1], false);
+	if(hash == NULL){
+		return;
+	}
+	for(int i=2; i<num; i++){
+		std::string *val = hash->find(req[i]);
+		if(val){
+			resp->push_back(req[i].String());
+			resp->push_back(*val);
+		}
+	}
+}
+
+void MemoryStore::proc_multi_hset(const Bytes *req, int num, Resp *resp){
+	if(num % 2 != 0){
+		reply_error(resp, "client_error", "wrong number of arguments");
+		return;
+	}
+	Hash *hash = this->hash_find(req[1], true);
+	int64_t added = 0;
+	for(int i=2; i<num; i+=2){
+		bool created;
+		hash->insert(req[i], &created)->assign(req[i+1].data(), req[i+1].size());
+		added += created? 1 : 0;
+	}
+	reply_int(resp, added);
+}
+
+void MemoryStore::proc_multi_hdel(const Bytes *req, int num, Resp *resp){
+	Hash *hash = this->hash_find(req[1], false);
+	int64_t deleted = 0;
+	for(int i=2; hash && i<num; i++){
+		deleted += hash->erase(req[i])? 1 : 0;
+	}
+	this->drop_empty(req[1], hash);
+	reply_int(resp, deleted);
+}
+
+/******************** zset *************************/
+
+void MemoryStore::proc_zget(const Bytes *req, int, Resp *resp){
+	SortedSet *zset = this->zset_find(req[1], false);
+	int64_t score;
+	if(zset && zset->get(req[2], &score)){
+		reply_int(resp, score);
+	}else{
+		reply_not_found(resp);
+	}
+}
+
+void MemoryStore::proc_zset(const Bytes *req, int, Resp *resp){
+	int64_t score;
+	if(!to_int64(req[3], &score)){
+		reply_error(resp, "client_error", "invalid score");
+		return;
+	}
+	SortedSet *zset = this->zset_find(req[1], true);
+	reply_int(resp, zset->set(req[2], score)? 1 : 0);
+}
+
+void MemoryStore::proc_zdel(const Bytes *req, int, Resp *resp){
+	SortedSet *zset = this->zset_find(req[1], false);
+	bool found = zset && zset->del(req[2]);
+	this->drop_empty(req[1], zset);
+	reply_int(resp, found? 1 : 0);
+}
+
+void MemoryStore::zset_incr(const Bytes &name, const Bytes &key, int64_t by, Resp *resp){
+	SortedSet *zset = this->zset_find(name, true);
+	int64_t score = 0;
+	zset->get(key, &score);
+	if(!add_int64(score, by, &score)){
+		this->drop_empty(name, zset);
+		reply_error(resp, "error", "score out of range");
+		return;
+	}
+	zset->set(key, score);
+	reply_int(resp, score);
+}
+
+void MemoryStore::proc_zincr(const Bytes *req, int num, Resp *resp){
+	int64_t by = 1;
+	if(num > 3 && !to_int64(req[3], &by)){
+		reply_error(resp, "client_error", "invalid increment");
+		return;
+	}
+	this->zset_incr(req[1], req[2], by, resp);
+}
+
+void MemoryStore::proc_zdecr(const Bytes *req, int num, Resp *resp){
+	int64_t by = 1;
+	if(num > 3 && !to_int64(req[3], &by)){
+		reply_error(resp, "client_error", "invalid increment");
+		return;
+	}
+	this->zset_incr(req[1], req[2], -by, resp);
+}
+
+void MemoryStore::proc_zexists(const Bytes *req, int, Resp *resp){
+	SortedSet *zset = this->zset_find(req[1], false);
+	int64_t score;
+	reply_int(resp, (zset && zset->get(req[2], &score))? 1 : 0);
+}
+
+void MemoryStore::proc_zsize(const Bytes *req, int, Resp *resp){
+	SortedSet *zset = this->zset_find(req[1], false);
+	reply_int(resp, zset? zset->size() : 0);
+}
+
+void MemoryStore::proc_zclear(const Bytes *req, int, Resp *resp){
+	SortedSet *zset = this->zset_find(req[1], false);
+	int64_t size = 0;
+	if(zset){
+		size = zset->size();
+		delete zset;
+		zsets_.erase(req[1]);
+	}
+	reply_int(resp, size);
+}
+
+void MemoryStore::zset_rank(const Bytes &name, const Bytes &key, bool reverse, Resp *resp){
+	SortedSet *zset = this->zset_find(name, false);
+	int64_t rank = zset? zset->rank(key) : -1;
+	if(rank == -1){
+		reply_not_found(resp);
+		return;
+	}
+	reply_int(resp, reverse? zset->size() - 1 - rank : rank);
+}
+
+void MemoryStore::proc_zrank(const Bytes *req, int, Resp *resp){
+	this->zset_rank(req[1], req[2], false, resp);
+}
+
+void MemoryStore::proc_zrrank(const Bytes *req, int, Resp *resp){
+	this->zset_rank(req[1], req[2], true, resp);
+}
+
+// req is name, offset, limit
+void MemoryStore::zset_slice(const Bytes *req, bool reverse, Resp *resp){
+	reply_ok(resp);
+	SortedSet *zset = this->zset_find(req[1], false);
+	uint64_t offset = req[2].Uint64();
+	uint64_t limit = req[3].Uint64();
+	if(zset == NULL || offset >= (uint64_t)zset->size()){
+		return;
+	}
+	int64_t rank = reverse? zset->size() - 1 - (int64_t)offset : (int64_t)offset;
+	const SortedSet::Node *node = zset->at(rank);
+	for(uint64_t i=0; node && i<limit; i++){
+		resp->push_back(node->key);
+		resp->push_back(str(node->score));
+		node = reverse? SortedSet::prev(node) : SortedSet::next(node);
+	}
+}
+
+void MemoryStore::proc_zrange(const Bytes *req, int, Resp *resp){
+	this->zset_slice(req, false, resp);
+}
+
+void MemoryStore::proc_zrrange(const Bytes *req, int, Resp *resp){
+	this->zset_slice(req, true, resp);
+}
+
+/**
+ * req is name, key_start, score_start, score_end, limit. The members from
+ * score_start, after key_start when given, up to score_end. Backwards if
+ * reverse is set. An empty score is no limit.
+ */
+void MemoryStore::zset_range(const Bytes *req, bool reverse, bool with_scores, Resp *resp){
+	reply_ok(resp);
+	SortedSet *zset = this->zset_find(req[1], false);
+	if(zset == NULL){
+		return;
+	}
+	const Bytes &key_start = req[2];
+	bool has_start = !req[3].empty();
+	bool has_end = !req[4].empty();
+	int64_t score_start = req[3].Int64();
+	int64_t score_end = req[4].Int64();
+	uint64_t limit = req[5].Uint64();
+
+	const SortedSet::Node *node;
+	if(!reverse){
+		node = zset->first();
+		if(has_start){
+			node = zset->lower_bound(score_start, key_start);
+			if(node && !key_start.empty() && node->score == score_start && Bytes(node->key) == key_start){
+				node = SortedSet::next(node);
+			}
+		}
+	}else{
+		node = zset->last();
+		if(has_start){
+			// the last member before (score_start, key_start), or with
+			// score_start itself when key_start is empty
+			const SortedSet::Node *bound;
+			if(!key_start.empty()){
+				bound = zset->lower_bound(score_start, key_start);
+			}else if(score_start < INT64_MAX){
+				bound = zset->lower_bound(score_start + 1, Bytes());
+			}else{
+				bound = NULL;
+			}
+			if(bound){
+				node = SortedSet::prev(bound);
+			}
+		}
+	}
+
+	for(uint64_t i=0; node && i<limit; i++){
+		if(has_end && (reverse? node->score < score_end : node->score > score_end)){
+			break;
+		}
+		resp->push_back(node->key);
+		if(with_scores){
+			resp->push_back(str(node->score));
+		}
+		node = reverse? SortedSet::prev(node) : SortedSet::next(node);
+	}
+}
+
+void MemoryStore::proc_zkeys(const Bytes *req, int, Resp *resp){
+	this->zset_range(req, false, false, resp);
+}
+
+void MemoryStore::proc_zscan(const Bytes *req, int, Resp *resp){
+	this->zset_range(req, false, true, resp);
+}
+
+void MemoryStore::proc_zrscan(const Bytes *req, int, Resp *resp){
+	this->zset_range(req, true, true, resp);
+}
+
+void MemoryStore::proc_zlist(const Bytes *req, int, Resp *resp){
+	reply_names(zsets_, req, false, resp);
+}
+
+void MemoryStore::proc_zrlist(const Bytes *req, int, Resp *resp){
+	reply_names(zsets_, req, true, resp);
+}
+
+void MemoryStore::proc_multi_zget(const Bytes *req, int num, Resp *resp){
+	reply_ok(resp);
+	SortedSet *zset = this->zset_find(req[1], false);
+	for(int i=2; zset && i<num; i++){
+		int64_t score;
+		if(zset->get(req[i], &score)){
+			resp->push_back(req[i].String());
+			resp->push_back(str(score));
+		}
+	}
+}
+
+void MemoryStore::proc_multi_zset(const Bytes *req, int num, Resp *resp){
+	if(num % 2 != 0){
+		reply_error(resp, "client_error", "wrong number of arguments");
+		return;
+	}
+	for(int i=3; i<num; i+=2){
+		int64_t score;
+		if(!to_int64(req[i], &score)){
+			reply_error(resp, "client_error", "invalid score");
+			return;
+		}
+	}
+	SortedSet *zset = this->zset_find(req[1], true);
+	int64_t added = 0;
+	for(int i=2; i<num; i+=2){
+		added += zset->set(req[i], req[i+1].Int64())? 1 : 0;
+	}
+	reply_int(resp, added);
+}
+
+void MemoryStore::proc_multi_zdel(const Bytes *req, int num, Resp *resp){
+	SortedSet *zset = this->zset_find(req[1], false);
+	int64_t deleted = 0;
+	for(int i=2; zset && i<num; i++){
+		deleted += zset->del(req[i])? 1 : 0;
+	}
+	this->drop_empty(req[1], zset);
+	reply_int(resp, deleted);
+}
+
+/******************** queue *************************/
+
+void MemoryStore::queue_push(const Bytes *req, int num, bool front, Resp *resp){
+	Queue *queue = this->queue_find(req[1], true);
+	for(int i=2; i<num; i++){
+		if(front){
+			queue->push_front(req[i].String());
+		}else{
+			queue->push_back(req[i].String());
+		}
+	}
+	reply_int(resp, queue->size());
+}
+
+void MemoryStore::proc_qpush_back(const Bytes *req, int num, Resp *resp){
+	this->queue_push(req, num, false, resp);
+}
+
+void MemoryStore::proc_qpush_front(const Bytes *req, int num, Resp *resp){
+	this->queue_push(req, num, true, resp);
+}
+
+// with a limit, up to that many items, otherwise one item or not_found
+void MemoryStore::queue_pop(const Bytes *req, int num, bool front, Resp *resp){
+	Queue *queue = this->queue_find(req[1], false);
+	if(num <= 2 && (queue == NULL || queue->empty())){
+		reply_not_found(resp);
+		return;
+	}
+	int64_t limit = num > 2? req[2].Int64() : 1;
+	reply_ok(resp);
+	std::string item;
+	for(int64_t i=0; queue && i<limit && !queue->empty(); i++){
+		if(front){
+			queue->pop_front(&item);
+		}else{
+			queue->pop_back(&item);
+		}
+		resp->push_back(std::string());
+		resp->back().swap(item);
+	}
+	this->drop_empty(req[1], queue);
+}
+
+void MemoryStore::proc_qpop_front(const Bytes *req, int num, Resp *resp){
+	this->queue_pop(req, num, true, resp);
+}
+
+void MemoryStore::proc_qpop_back(const Bytes *req, int num, Resp *resp){
+	this->queue_pop(req, num, false, resp);
+}
+
+void MemoryStore::proc_qfront(const Bytes *req, int, Resp *resp){
+	Queue *queue = this->queue_find(req[1], false);
+	if(queue){
+		reply_str(resp, queue->at(0));
+	}else{
+		reply_not_found(resp);
+	}
+}
+
+void MemoryStore::proc_qback(const Bytes *req, int, Resp *resp){
+	Queue *queue = this->queue_find(req[1], false);
+	if(queue){
+		reply_str(resp, queue->at(queue->size() - 1));
+	}else{
+		reply_not_found(resp);
+	}
+}
+
+void MemoryStore::proc_qsize(const Bytes *req, int, Resp *resp){
+	Queue *queue = this->queue_find(req[1], false);
+	reply_int(resp, queue? queue->size() : 0);
+}
+
+void MemoryStore::proc_qget(const Bytes *req, int, Resp *resp){
+	Queue *queue = this->queue_find(req[1], false);
+	int64_t index = req[2].Int64();
+	int64_t size = queue? queue->size() : 0;
+	if(index < 0){
+		index += size;
+	}
+	if(index < 0 || index >= size){
+		reply_not_found(resp);
+		return;
+	}
+	reply_str(resp, queue->at(index));
+}
+
+void MemoryStore::proc_qset(const Bytes *req, int, Resp *resp){
+	Queue *queue = this->queue_find(req[1], false);
+	int64_t index = req[2].Int64();
+	int64_t size = queue? queue->size() : 0;
+	if(index < 0){
+		index += size;
+	}
+	if(index < 0 || index >= size){
+		reply_error(resp, "error", "index out of range");
+		return;
+	}
+	queue->at(index).assign(req[3].data(), req[3].size());
+	reply_int(resp, 1);
+}
+
+// items from begin to end inclusive, negative indexes count from the back
+void MemoryStore::queue_slice(Queue *queue, int64_t begin, int64_t end, Resp *resp){
+	reply_ok(resp);
+	int64_t size = queue? queue->size() : 0;
+	if(begin < 0){
+		begin += size;
+	}
+	if(end < 0){
+		end += size;
+	}
+	if(begin < 0){
+		begin = 0;
+	}
+	if(end >= size){
+		end = size - 1;
+	}
+	for(int64_t i=begin; i<=end; i++){
+		resp->push_back(queue->at(i));
+	}
+}
+
+void MemoryStore::proc_qslice(const Bytes *req, int, Resp *resp){
+	Queue *queue = this->queue_find(req[1], false);
+	this->queue_slice(queue, req[2].Int64(), req[3].Int64(), resp);
+}
+
+// limit items from offset, a negative limit is an end index
+void MemoryStore::proc_qrange(const Bytes *req, int, Resp *resp){
+	Queue *queue = this->queue_find(req[1], false);
+	int64_t begin = req[2].Int64();
+	int64_t limit = req[3].Int64();
+	int64_t end = limit;
+	if(limit >= 0){
+		end = begin + limit - 1;
+		if(begin < 0 && end >= 0){
+			end = -1;
+		}
+	}
+	this->queue_slice(queue, begin, end, resp);
+}
+
+void MemoryStore::proc_qclear(const Bytes *req, int, Resp *resp){
+	Queue *queue = this->queue_find(req[1], false);
+	int64_t size = 0;
+	if(queue){
+		size = queue->size();
+		delete queue;
+		queues_.erase(req[1]);
+	}
+	reply_int(resp, size);
+}
@@ -0,0 +1,475 @@
+#ifndef UTIL_MEMORY_STORE_H_
+#define UTIL_MEMORY_STORE_H_
+
+#include <inttypes.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ssdb_bytes.h"
+#include "bloom_filter.h"
+
+/**
+ * Open addressing hash table from byte string keys to V, with linear
+ * probing over a power of two number of slots.
+ *
+ * Probing only reads tags_, 32 bits of the key's hash per slot, the keys
+ * and values are in a parallel array and are compared on a tag match
+ * only. Erased slots are marked deleted, they are reclaimed when the
+ * table is rebuilt, which also shrinks it once most entries are gone.
+ *
+ * Slots may be walked with capacity(), used(), key() and val(), in no
+ * particular order. Pointers to values are valid until the next insert().
+ */
+template<class V>
+class OpenHash{
+	private:
+		enum{
+			EMPTY = 0,
+			DELETED = 1
+		};
+		struct Entry{
+			std::string key;
+			V val;
+		};
+		std::vector<uint32_t> tags_;
+		std::vector<Entry> entries_;
+		int size_;
+		// size_ plus the deleted slots
+		int used_;
+
+		static uint64_t hash(const char *key, int size){
+			return BloomFilter::hash(key, size);
+		}
+		static uint32_t tag_of(uint64_t h){
+			uint32_t tag = (uint32_t)(h >> 32);
+			return tag < 2? tag + 2 : tag;
+		}
+		bool equals(int slot, const char *key, int size) const{
+			const std::string &k = entries_[slot].key;
+			return (int)k.size() == size && memcmp(k.data(), key, size) == 0;
+		}
+		// the slot of key, or -1
+		int lookup(const char *key, int size) const{
+			if(tags_.empty()){
+				return -1;
+			}
+			uint64_t h = hash(key, size);
+			uint32_t tag = tag_of(h);
+			uint32_t mask = (uint32_t)tags_.size() - 1;
+			for(uint32_t i = (uint32_t)h & mask; ; i = (i + 1) & mask){
+				if(tags_[i] == EMPTY){
+					return -1;
+				}
+				if(tags_[i] == tag && equals(i, key, size)){
+					return (int)i;
+				}
+			}
+		}
+		void rehash(int capacity){
+			std::vector<uint32_t> tags(capacity, (uint32_t)EMPTY);
+			std::vector<Entry> entries(capacity);
+			uint32_t mask = (uint32_t)capacity - 1;
+			for(int i=0; i<(int)tags_.size(); i++){
+				if(tags_[i] < 2){
+					continue;
+				}
+				Entry &e = entries_[i];
+				uint32_t j = (uint32_t)hash(e.key.data(), (int)e.key.size()) & mask;
+				while(tags[j] != EMPTY){
+					j = (j + 1) & mask;
+				}
+				tags[j] = tags_[i];
+				entries[j].key.swap(e.key);
+				std::swap(entries[j].val, e.val);
+			}
+			tags_.swap(tags);
+			entries_.swap(entries);
+			used_ = size_;
+		}
+	public:
+		OpenHash(){
+			size_ = 0;
+			used_ = 0;
+		}
+
+		int size() const{
+			return size_;
+		}
+		bool empty() const{
+			return size_ == 0;
+		}
+
+		V* find(const Bytes &key){
+			int slot = this->lookup(key.data(), key.size());
+			return slot == -1? NULL : &entries_[slot].val;
+		}
+		const V* find(const Bytes &key) const{
+			int slot = this->lookup(key.data(), key.size());
+			return slot == -1? NULL : &entries_[slot].val;
+		}
+		// the value of key, a default constructed one if *created is set
+		V* insert(const Bytes &key, bool *created){
+			int slot = this->lookup(key.data(), key.size());
+			if(slot != -1){
+				*created = false;
+				return &entries_[slot].val;
+			}
+			*created = true;
+			// at most 3/4 of the slots used, rebuilt to at most 1/2
+			if((used_ + 1) * 4 > (int)tags_.size() * 3){
+				int capacity = 8;
+				while((size_ + 1) * 2 > capacity){
+					capacity *= 2;
+				}
+				this->rehash(capacity);
+			}
+			uint64_t h = hash(key.data(), key.size());
+			uint32_t mask = (uint32_t)tags_.size() - 1;
+			uint32_t i = (uint32_t)h & mask;
+			while(tags_[i] >= 2){
+				i = (i + 1) & mask;
+			}
+			if(tags_[i] == EMPTY){
+				used_ ++;
+			}
+			size_ ++;
+			tags_[i] = tag_of(h);
+			entries_[i].key.assign(key.data(), key.size());
+			entries_[i].val = V();
+			return &entries_[i].val;
+		}
+		bool erase(const Bytes &key){
+			int slot = this->lookup(key.data(), key.size());
+			if(slot == -1){
+				return false;
+			}
+			this->erase_at(slot);
+			return true;
+		}
+		void clear(){
+			tags_.clear();
+			entries_.clear();
+			size_ = 0;
+			used_ = 0;
+		}
+
+		int capacity() const{
+			return (int)tags_.size();
+		}
+		bool used(int slot) const{
+			return tags_[slot] >= 2;
+		}
+		const std::string& key(int slot) const{
+			return entries_[slot].key;
+		}
+		V& val(int slot){
+			return entries_[slot].val;
+		}
+		void erase_at(int slot){
+			tags_[slot] = DELETED;
+			std::string().swap(entries_[slot].key);
+			entries_[slot].val = V();
+			size_ --;
+		}
+};
+
+/**
+ * Members ordered by (score, key), with the key's score in an OpenHash.
+ *
+ * A skiplist whose links also count the members they skip, so rank() and
+ * at() take O(log n) like a lookup by score does.
+ */
+class SortedSet{
+	public:
+		struct Node{
+			std::string key;
+			int64_t score;
+			Node *backward;
+			struct Level{
+				Node *forward;
+				int64_t span;
+			} level[1];
+		};
+	private:
+		enum{
+			MAX_LEVEL = 32
+		};
+		Node *head_;
+		Node *tail_;
+		int level_;
+		int64_t length_;
+		uint64_t random_;
+		OpenHash<int64_t> scores_;
+
+		Node* create_node(int level, const Bytes &key, int64_t score);
+		void free_node(Node *node);
+		int random_level();
+		void insert_node(const Bytes &key, int64_t score);
+		void delete_node(const Bytes &key, int64_t score);
+		// SortedSet is not copyable
+		SortedSet(const SortedSet&);
+		void operator=(const SortedSet&);
+	public:
+		SortedSet();
+		~SortedSet();
+
+		int64_t size() const{
+			return length_;
+		}
+		bool get(const Bytes &key, int64_t *score) const;
+		// return true if key is new
+		bool set(const Bytes &key, int64_t score);
+		bool del(const Bytes &key);
+		// rank of key from 0 in ascending order, -1 if not found
+		int64_t rank(const Bytes &key) const;
+
+		// the member at rank, NULL if out of range
+		const Node* at(int64_t rank) const;
+		const Node* first() const{
+			return head_->level[0].forward;
+		}
+		const Node* last() const{
+			return tail_;
+		}
+		// the first member not less than (score, key), NULL if none
+		const Node* lower_bound(int64_t score, const Bytes &key) const;
+		static const Node* next(const Node *node){
+			return node->level[0].forward;
+		}
+		static const Node* prev(const Node *node){
+			return node->backward;
+		}
+};
+
+/**
+ * A double-ended queue in one power of two array, indexed modulo its
+ * size. Items are moved into a larger array when it is full.
+ */
+template<class T>
+class RingQueue{
+	private:
+		std::vector<T> items_;
+		int64_t head_;
+		int64_t size_;
+
+		int64_t slot(int64_t index) const{
+			return (head_ + index) & ((int64_t)items_.size() - 1);
+		}
+		void grow(){
+			std::vector<T> items(items_.empty()? 8 : items_.size() * 2);
+			for(int64_t i=0; i<size_; i++){
+				std::swap(items[i], items_[this->slot(i)]);
+			}
+			items_.swap(items);
+			head_ = 0;
+		}
+	public:
+		RingQueue(){
+			head_ = 0;
+			size_ = 0;
+		}
+
+		int64_t size() const{
+			return size_;
+		}
+		bool empty() const{
+			return size_ == 0;
+		}
+		// 0 is the front
+		T& at(int64_t index){
+			return items_[this->slot(index)];
+		}
+		void push_back(const T &item){
+			if(size_ == (int64_t)items_.size()){
+				this->grow();
+			}
+			items_[this->slot(size_)] = item;
+			size_ ++;
+		}
+		void push_front(const T &item){
+			if(size_ == (int64_t)items_.size()){
+				this->grow();
+			}
+			head_ = this->slot(items_.size() - 1);
+			items_[head_] = item;
+			size_ ++;
+		}
+		void pop_front(T *item){
+			T &front = items_[head_];
+			std::swap(*item, front);
+			front = T();
+			head_ = this->slot(1);
+			size_ --;
+		}
+		void pop_back(T *item){
+			T &back = items_[this->slot(size_ - 1)];
+			std::swap(*item, back);
+			back = T();
+			size_ --;
+		}
+};
+
+/**
+ * The kv, hash, zset and queue data of an SSDB server in process memory,
+ * see InMemoryClient in SSDB_memory.h.
+ *
+ * execute() takes a request as a Client would send it and gives the
+ * response the server would reply, so every command implemented behaves
+ * the same whether it is run here or over a Link. Keys written with a ttl
+ * expire when they are next read.
+ *
+ * Point commands are O(1), zset ranks and ranges O(log n), queue ends
+ * O(1). Hash tables keep no order, so keys, scan, hkeys, hscan, hlist,
+ * zlist and their reverse versions walk the whole table, O(n) plus the
+ * sort of the items returned.
+ *
+ * All methods are thread-safe, one store may back several clients.
+ */
+class MemoryStore{
+	private:
+		struct KvValue{
+			std::string val;
+			// steady clock milliseconds, 0 for none
+			int64_t expire_ms;
+			KvValue(){
+				expire_ms = 0;
+			}
+		};
+		typedef OpenHash<std::string> Hash;
+		typedef RingQueue<std::string> Queue;
+		typedef std::vector<std::string> Resp;
+		typedef void (MemoryStore::*Proc)(const Bytes *req, int num, Resp *resp);
+		struct Command{
+			const char *name;
+			Proc proc;
+			// including the command name
+			int min_args;
+		};
+		static const Command commands[];
+
+		std::mutex mutex_;
+		OpenHash<const Command *> procs_;
+		OpenHash<KvValue> kv_;
+		OpenHash<Hash *> hashes_;
+		OpenHash<SortedSet *> zsets_;
+		OpenHash<Queue *> queues_;
+
+		// the value of key if it has not expired
+		KvValue* kv_find(const Bytes &key);
+		void kv_expire();
+		Hash* hash_find(const Bytes &name, bool create);
+		SortedSet* zset_find(const Bytes &name, bool create);
+		Queue* queue_find(const Bytes &name, bool create);
+		void drop_empty(const Bytes &name, Hash *hash);
+		void drop_empty(const Bytes &name, SortedSet *zset);
+		void drop_empty(const Bytes &name, Queue *queue);
+
+		void proc_ping(const Bytes *req, int num, Resp *resp);
+		void proc_dbsize(const Bytes *req, int num, Resp *resp);
+		void proc_flushdb(const Bytes *req, int num, Resp *resp);
+		void proc_get_kv_range(const Bytes *req, int num, Resp *resp);
+		void proc_set_kv_range(const Bytes *req, int num, Resp *resp);
+
+		void proc_get(const Bytes *req, int num, Resp *resp);
+		void proc_set(const Bytes *req, int num, Resp *resp);
+		void proc_setx(const Bytes *req, int num, Resp *resp);
+		void proc_setnx(const Bytes *req, int num, Resp *resp);
+		void proc_getset(const Bytes *req, int num, Resp *resp);
+		void proc_del(const Bytes *req, int num, Resp *resp);
+		void proc_incr(const Bytes *req, int num, Resp *resp);
+		void proc_decr(const Bytes *req, int num, Resp *resp);
+		void proc_exists(const Bytes *req, int num, Resp *resp);
+		void proc_expire(const Bytes *req, int num, Resp *resp);
+		void proc_ttl(const Bytes *req, int num, Resp *resp);
+		void proc_keys(const Bytes *req, int num, Resp *resp);
+		void proc_rkeys(const Bytes *req, int num, Resp *resp);
+		void proc_scan(const Bytes *req, int num, Resp *resp);
+		void proc_rscan(const Bytes *req, int num, Resp *resp);
+		void proc_multi_get(const Bytes *req, int num, Resp *resp);
+		void proc_multi_set(const Bytes *req, int num, Resp *resp);
+		void proc_multi_del(const Bytes *req, int num, Resp *resp);
+
+		void proc_hget(const Bytes *req, int num, Resp *resp);
+		void proc_hset(const Bytes *req, int num, Resp *resp);
+		void proc_hdel(const Bytes *req, int num, Resp *resp);
+		void proc_hincr(const Bytes *req, int num, Resp *resp);
+		void proc_hdecr(const Bytes *req, int num, Resp *resp);
+		void proc_hexists(const Bytes *req, int num, Resp *resp);
+		void proc_hsize(const Bytes *req, int num, Resp *resp);
+		void proc_hclear(const Bytes *req, int num, Resp *resp);
+		void proc_hkeys(const Bytes *req, int num, Resp *resp);
+		void proc_hgetall(const Bytes *req, int num, Resp *resp);
+		void proc_hscan(const Bytes *req, int num, Resp *resp);
+		void proc_hrscan(const Bytes *req, int num, Resp *resp);
+		void proc_hlist(const Bytes *req, int num, Resp *resp);
+		void proc_hrlist(const Bytes *req, int num, Resp *resp);
+		void proc_multi_hget(const Bytes *req, int num, Resp *resp);
+		void proc_multi_hset(const Bytes *req, int num, Resp *resp);
+		void proc_multi_hdel(const Bytes *req, int num, Resp *resp);
+
+		void proc_zget(const Bytes *req, int num, Resp *resp);
+		void proc_zset(const Bytes *req, int num, Resp *resp);
+		void proc_zdel(const Bytes *req, int num, Resp *resp);
+		void proc_zincr(const Bytes *req, int num, Resp *resp);
+		void proc_zdecr(const Bytes *req, int num, Resp *resp);
+		void proc_zexists(const Bytes *req, int num, Resp *resp);
+		void proc_zsize(const Bytes *req, int num, Resp *resp);
+		void proc_zclear(const Bytes *req, int num, Resp *resp);
+		void proc_zrank(const Bytes *req, int num, Resp *resp);
+		void proc_zrrank(const Bytes *req, int num, Resp *resp);
+		void proc_zrange(const Bytes *req, int num, Resp *resp);
+		void proc_zrrange(const Bytes *req, int num, Resp *resp);
+		void proc_zkeys(const Bytes *req, int num, Resp *resp);
+		void proc_zscan(const Bytes *req, int num, Resp *resp);
+		void proc_zrscan(const Bytes *req, int num, Resp *resp);
+		void proc_zlist(const Bytes *req, int num, Resp *resp);
+		void proc_zrlist(const Bytes *req, int num, Resp *resp);
+		void proc_multi_zget(const Bytes *req, int num, Resp *resp);
+		void proc_multi_zset(const Bytes *req, int num, Resp *resp);
+		void proc_multi_zdel(const Bytes *req, int num, Resp *resp);
+
+		void proc_qpush_back(const Bytes *req, int num, Resp *resp);
+		void proc_qpush_front(const Bytes *req, int num, Resp *resp);
+		void proc_qpop_front(const Bytes *req, int num, Resp *resp);
+		void proc_qpop_back(const Bytes *req, int num, Resp *resp);
+		void proc_qfront(const Bytes *req, int num, Resp *resp);
+		void proc_qback(const Bytes *req, int num, Resp *resp);
+		void proc_qsize(const Bytes *req, int num, Resp *resp);
+		void proc_qget(const Bytes *req, int num, Resp *resp);
+		void proc_qset(const Bytes *req, int num, Resp *resp);
+		void proc_qslice(const Bytes *req, int num, Resp *resp);
+		void proc_qrange(const Bytes *req, int num, Resp *resp);
+		void proc_qclear(const Bytes *req, int num, Resp *resp);
+
+		void kv_range(const Bytes *req, bool reverse, bool with_vals, Resp *resp);
+		void hash_range(const Bytes &name, const Bytes &start, const Bytes &end,
+			uint64_t limit, bool reverse, bool with_vals, Resp *resp);
+		void zset_range(const Bytes *req, bool reverse, bool with_scores, Resp *resp);
+		void zset_slice(const Bytes *req, bool reverse, Resp *resp);
+		void kv_incr(const Bytes &key, int64_t by, Resp *resp);
+		void hash_incr(const Bytes &name, const Bytes &key, int64_t by, Resp *resp);
+		void zset_incr(const Bytes &name, const Bytes &key, int64_t by, Resp *resp);
+		void zset_rank(const Bytes &name, const Bytes &key, bool reverse, Resp *resp);
+		void queue_push(const Bytes *req, int num, bool front, Resp *resp);
+		void queue_pop(const Bytes *req, int num, bool front, Resp *resp);
+		void queue_slice(Queue *queue, int64_t begin, int64_t end, Resp *resp);
+		void clear_all();
+
+		// MemoryStore is not copyable
+		MemoryStore(const MemoryStore&);
+		void operator=(const MemoryStore&);
+	public:
+		MemoryStore();
+		~MemoryStore();
+
+		/**
+		 * Run the request in req[0..num), req[0] is the command. resp is
+		 * cleared and filled with the response, the status code first.
+		 */
+		void execute(const Bytes *req, int num, std::vector<std::string> *resp);
+		void clear();
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef SSDB_MPSC_QUEUE_H_
+#define SSDB_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <stddef.h>
+
+// Intrusive node, embed it in the object to be queued.
+class MpscNode{
+	public:
+		std::atomic<MpscNode *> mpsc_next;
+		MpscNode(){
+			mpsc_next.store(NULL, std::memory_order_relaxed);
+		}
+};
+
+// Lock-free multi-producer single-consumer queue (Vyukov's intrusive
+// algorithm). push() is wait-free and may be called from any thread,
+// pop() must only be called from the single consumer thread.
+// Nodes are not owned by the queue.
+class MpscQueue{
+	private:
+		std::atomic<MpscNode *> head_;
+		MpscNode *tail_;
+		MpscNode stub_;
+		// No copying allowed
+		MpscQueue(const MpscQueue&);
+		void operator=(const MpscQueue&);
+	public:
+		MpscQueue(){
+			head_.store(&stub_);
+			tail_ = &stub_;
+		}
+
+		void push(MpscNode *node){
+			node->mpsc_next.store(NULL, std::memory_order_relaxed);
+			MpscNode *prev = head_.exchange(node);
+			prev->mpsc_next.store(node);
+		}
+
+		/**
+		 * return NULL if queue is empty, or a producer is in the middle
+		 * of push(), in which case the node will be seen by next pop().
+		 */
+		MpscNode* pop(){
+			MpscNode *tail = tail_;
+			MpscNode *next = tail->mpsc_next.load();
+			if(tail == &stub_){
+				if(next == NULL){
+					return NULL;
+				}
+				tail_ = next;
+				tail = next;
+				next = next->mpsc_next.load();
+			}
+			if(next){
+				tail_ = next;
+				return tail;
+			}
+			if(tail != head_.load()){
+				return NULL;
+			}
+			push(&stub_);
+			next = tail->mpsc_next.load();
+			if(next){
+				tail_ = next;
+				return tail;
+			}
+			return NULL;
+		}
+};
+
+#endif
@@ -4,16 +4,19 @@ Use of this source code is governed by a BSD-style license that can be
 found in the LICENSE file.
 */
 #include "ssdb_bytes.h"
+#include "buffer_pool.h"
+#include "ssdb_scan.h"
 
 Buffer::Buffer(int total){
 	size_ = 0;
 	total_ = total;
-	buf = (char *)malloc(total);
+	buf = BufferPool::alloc(&total_);
 	data_ = buf;
+	policy_ = NULL;
 }
 
 Buffer::~Buffer(){
-	free(buf);
+	BufferPool::free(buf, total_);
 }
 
 void Buffer::nice(){
@@ -26,6 +29,15 @@ void Buffer::nice(){
 	}
 }
 
+void Buffer::compact(){
+	if(data_ != buf){
+		if(size_ > 0){
+			memmove(buf, data_, size_);
+		}
+		data_ = buf;
+	}
+}
+
 void Buffer::shrink(int total){
 	if(total <= 0){
 		total = 8 * 1024;
@@ -35,14 +47,29 @@ void Buffer::shrink(int total){
 		return;
 	}
 	
-	total_ = total;
-	buf = (char *)realloc(buf, total);
+	char *p = BufferPool::alloc(&total);
+	if(p == NULL){
+		return;
+	}
+	if(total >= total_){ // same size class, nothing to gain
+		BufferPool::free(p, total);
+		return;
+	}
+	memcpy(p + offset, data_, size_);
+	BufferPool::free(buf, total_);
+	buf = p;
 	data_ = buf + offset;
+	total_ = total;
 }
 
 int Buffer::grow(){ // 扩大缓冲区
 	int n;
-	if(total_ < 8 * 1024){
+	if(policy_){
+		n = policy_->grow_size(total_, size_);
+		if(n <= total_){
+			n = 2 * total_;
+		}
+	}else if(total_ < 8 * 1024){
 		n = 8 * 1024;
 	}else if(total_ < 512 * 1024){
 		n = 8 * total_;
@@ -50,11 +77,14 @@ int Buffer::grow(){ // 扩大缓冲区
 		n = 2 * total_;
 	}
 	//log_debug("Buffer resize %d => %d", total_, n);
-	char *p = (char *)realloc(buf, n);
+	char *p = BufferPool::alloc(&n);
 	if(p == NULL){
 		return -1;
 	}
-	data_ = p + (data_ - buf);
+	int offset = data_ - buf;
+	memcpy(p + offset, data_, size_);
+	BufferPool::free(buf, total_);
+	data_ = p + offset;
 	buf = p;
 	total_ = n;
 	return total_;
@@ -70,28 +100,12 @@ std::string Buffer::stats() const{
 
 int Buffer::read_record(Bytes *s){
 	char *head = this->data();
-	char *body = (char *)memchr(head, '\n', this->size_);
-	if(body == NULL){
-		return 0;
-	}
-	body ++;
-
-	int head_len = body - head;
-	if(head[0] < '0' || head[0] > '9'){
-		return -1;
-	}
-
-	char head_str[20];
-	if(head_len + 1 > (int)sizeof(head_str)){
-		return -1;
-	}
-	memcpy(head_str, head, head_len - 1); // no '\n'
-	head_str[head_len - 1] = '\0';
-
-	int body_len = atoi(head_str);
-	if(body_len < 0){
-		return -1;
+	int body_len;
+	int head_len = parse_header(head, this->size_, &body_len);
+	if(head_len <= 0){
+		return head_len;
 	}
+	char *body = head + head_len;
 
 	char *p = body + body_len;
 	if(this->size_ >= head_len + body_len + 1){
@@ -125,12 +139,11 @@ int Buffer::append_record(const Bytes &s){
 		}
 	}
 
-	char len[16];
-	int num = snprintf(len, sizeof(len), "%d\n", (int)s.size());
-
 	char *p = this->slot();
-	memcpy(p, len, num);
+	int num = uint64_to_str(p, (uint64_t)s.size());
 	p += num;
+	*p++ = '\n';
+	num += 1;
 
 	memcpy(p, s.data(), s.size());
 	p += s.size();
@@ -7,6 +7,7 @@ found in the LICENSE file.
 #define UTIL_BYTES_H_
 
 #include "ssdb_strings.h"
+#include "buffer_policy.h"
 
 // readonly
 // to replace std::string
@@ -122,10 +123,19 @@ class Buffer{
 		char *data_;
 		int size_;
 		int total_;
+		BufferPolicy *policy_;
 	public:
 		Buffer(int total);
 		~Buffer();
 
+		// not owned, NULL for the built-in growth ladder
+		void policy(BufferPolicy *policy){
+			policy_ = policy;
+		}
+		BufferPolicy* policy() const{
+			return policy_;
+		}
+
 		// 缓冲区大小
 		int total() const{
 			return total_;
@@ -165,6 +175,8 @@ class Buffer{
 
 		// 保证不改变后半段的数据, 以便使已生成的 Bytes 不失效.
 		void nice();
+		// move data to the head of the buffer, invalidates Bytes pointing into it
+		void compact();
 		// 扩大缓冲区
 		int grow();
 		// 缩小缓冲区, 如果指定的 total 太小超过数据范围, 或者不合理, 则不会缩小
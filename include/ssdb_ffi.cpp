@@ -0,0 +1,283 @@
+#include "ssdb_ffi.h"
+#include "SSDB_impl.h"
+#include <string>
+#include <vector>
+
+using ssdb::ClientImpl;
+using ssdb::ReplyHandler;
+using ssdb::Slice;
+using ssdb::Status;
+
+struct ssdb_ffi_client{
+	ClientImpl *client;
+	// created by ssdb_ffi_connect(), not borrowed by ssdb_ffi_wrap()
+	bool owned;
+	std::string status;
+	std::vector<Slice> keys;
+	// values of the last truncated response, packed
+	std::string truncated;
+	bool has_truncated;
+};
+
+// set the status from s, return the matching code
+static int check_status(ssdb_ffi_client *c, Status s){
+	c->status = s.code();
+	if(s.ok()){
+		return SSDB_FFI_OK;
+	}
+	if(s.not_found()){
+		return SSDB_FFI_NOT_FOUND;
+	}
+	return c->client->broken()? SSDB_FFI_ERROR : SSDB_FFI_FAILED;
+}
+
+static inline Slice literal(const char *s){
+	return Slice(s, (int)strlen(s));
+}
+
+// copies the single item of a reply into the caller buffer, or keeps it
+// aside when the buffer is too small
+class ValueHandler : public ReplyHandler{
+public:
+	ssdb_ffi_client *c;
+	char *buf;
+	int size;
+	int *len;
+	int count;
+
+	ValueHandler(ssdb_ffi_client *c, char *buf, int size, int *len){
+		this->c = c;
+		this->buf = buf;
+		this->size = size;
+		this->len = len;
+		this->count = 0;
+	}
+	virtual int item(const char *data, int size){
+		if(count++ == 0){
+			*len = size;
+			if(size > this->size){
+				c->truncated.assign(data, size);
+				c->has_truncated = true;
+			}else{
+				memcpy(buf, data, size);
+			}
+		}
+		return 0;
+	}
+};
+
+// packs the values of found keys into the caller buffer in the order of
+// keys, and moves them aside once the buffer is too small
+class MultiHandler : public ReplyHandler{
+public:
+	ssdb_ffi_client *c;
+	int num;
+	const char **keys;
+	const int *key_lens;
+	char *buf;
+	int size;
+	int *val_lens;
+	int total;
+	int next;
+	int found;
+	bool is_key;
+
+	MultiHandler(ssdb_ffi_client *c, int num, const char **keys, const int *key_lens,
+		char *buf, int size, int *val_lens)
+	{
+		this->c = c;
+		this->num = num;
+		this->keys = keys;
+		this->key_lens = key_lens;
+		this->buf = buf;
+		this->size = size;
+		this->val_lens = val_lens;
+		this->total = 0;
+		this->next = 0;
+		this->found = -1;
+		this->is_key = true;
+	}
+	// found keys come back as key-value pairs in request order
+	virtual int item(const char *data, int size){
+		if(is_key){
+			is_key = false;
+			found = -1;
+			while(next < num){
+				int i = next++;
+				if(key_lens[i] == size && memcmp(keys[i], data, size) == 0){
+					found = i;
+					break;
+				}
+				val_lens[i] = -1;
+			}
+			return 0;
+		}
+		is_key = true;
+		if(found == -1){
+			return 0;
+		}
+		val_lens[found] = size;
+		if(!c->has_truncated && total + size > this->size){
+			c->truncated.assign(buf, total);
+			c->has_truncated = true;
+		}
+		if(c->has_truncated){
+			c->truncated.append(data, size);
+		}else{
+			memcpy(buf + total, data, size);
+		}
+		total += size;
+		return 0;
+	}
+	void finish(){
+		while(next < num){
+			val_lens[next++] = -1;
+		}
+	}
+};
+
+// keeps the single item of a reply as an integer
+class IntHandler : public ReplyHandler{
+public:
+	int64_t *ret;
+	int count;
+
+	IntHandler(int64_t *ret){
+		this->ret = ret;
+		this->count = 0;
+	}
+	virtual int item(const char *data, int size){
+		if(count++ == 0){
+			*ret = str_to_int64(data, size);
+		}
+		return 0;
+	}
+};
+
+static ssdb_ffi_client* new_client(ClientImpl *client, bool owned){
+	ssdb_ffi_client *c = new ssdb_ffi_client();
+	c->client = client;
+	c->owned = owned;
+	c->status = "ok";
+	c->has_truncated = false;
+	return c;
+}
+
+// every request drops the values of a previous truncated one
+static inline void begin(ssdb_ffi_client *c){
+	c->truncated.clear();
+	c->has_truncated = false;
+}
+
+ssdb_ffi_client* ssdb_ffi_connect(const char *ip, int port){
+	ssdb::Client *client = ssdb::Client::connect(ip, port);
+	if(client == NULL){
+		return NULL;
+	}
+	return new_client(static_cast<ClientImpl *>(client), true);
+}
+
+ssdb_ffi_client* ssdb_ffi_wrap(void *client){
+	if(client == NULL){
+		return NULL;
+	}
+	return new_client(static_cast<ClientImpl *>((ssdb::Client *)client), false);
+}
+
+void ssdb_ffi_close(ssdb_ffi_client *c){
+	if(c){
+		if(c->owned){
+			delete c->client;
+		}
+		delete c;
+	}
+}
+
+const char* ssdb_ffi_status(ssdb_ffi_client *c){
+	return c->status.c_str();
+}
+
+int ssdb_ffi_get(ssdb_ffi_client *c, const char *key, int key_len,
+	char *buf, int buf_size, int *val_len)
+{
+	begin(c);
+	Slice req[] = {literal("get"), Slice(key, key_len)};
+	ValueHandler handler(c, buf, buf_size, val_len);
+	int ret = check_status(c, c->client->request_stream(req, 2, &handler));
+	if(ret != SSDB_FFI_OK){
+		begin(c);
+		return ret;
+	}
+	if(handler.count != 1){
+		begin(c);
+		c->status = "server_error";
+		return SSDB_FFI_FAILED;
+	}
+	return c->has_truncated? SSDB_FFI_TRUNCATED : SSDB_FFI_OK;
+}
+
+int ssdb_ffi_set(ssdb_ffi_client *c, const char *key, int key_len,
+	const char *val, int val_len)
+{
+	begin(c);
+	return check_status(c, c->client->set(Slice(key, key_len), Slice(val, val_len)));
+}
+
+int ssdb_ffi_setx(ssdb_ffi_client *c, const char *key, int key_len,
+	const char *val, int val_len, int ttl)
+{
+	begin(c);
+	return check_status(c, c->client->setx(Slice(key, key_len), Slice(val, val_len), ttl));
+}
+
+int ssdb_ffi_del(ssdb_ffi_client *c, const char *key, int key_len){
+	begin(c);
+	return check_status(c, c->client->del(Slice(key, key_len)));
+}
+
+int ssdb_ffi_incr(ssdb_ffi_client *c, const char *key, int key_len,
+	int64_t incrby, int64_t *ret)
+{
+	begin(c);
+	char buf[21];
+	Slice req[] = {literal("incr"), Slice(key, key_len), Slice(buf, int64_to_str(buf, incrby))};
+	IntHandler handler(ret);
+	int code = check_status(c, c->client->request_stream(req, 3, &handler));
+	if(code == SSDB_FFI_OK && handler.count != 1){
+		c->status = "server_error";
+		return SSDB_FFI_FAILED;
+	}
+	return code;
+}
+
+int ssdb_ffi_multi_get(ssdb_ffi_client *c, int num,
+	const char **keys, const int *key_lens,
+	char *buf, int buf_size, int *val_lens, int *total)
+{
+	begin(c);
+	c->keys.resize(num);
+	for(int i=0; i<num; i++){
+		c->keys[i] = Slice(keys[i], key_lens[i]);
+	}
+	MultiHandler handler(c, num, keys, key_lens, buf, buf_size, val_lens);
+	int ret = check_status(c, c->client->multi_get(num? &c->keys[0] : NULL, num, &handler));
+	if(ret != SSDB_FFI_OK){
+		begin(c);
+		return ret;
+	}
+	handler.finish();
+	*total = handler.total;
+	return c->has_truncated? SSDB_FFI_TRUNCATED : SSDB_FFI_OK;
+}
+
+int ssdb_ffi_take_last(ssdb_ffi_client *c, char *buf, int buf_size){
+	if(!c->has_truncated){
+		return SSDB_FFI_FAILED;
+	}
+	if((int)c->truncated.size() > buf_size){
+		return SSDB_FFI_TRUNCATED;
+	}
+	memcpy(buf, c->truncated.data(), c->truncated.size());
+	begin(c);
+	return SSDB_FFI_OK;
+}
@@ -0,0 +1,91 @@
+#ifndef SSDB_API_FFI_H
+#define SSDB_API_FFI_H
+
+/**
+ * Plain C ABI for LuaJIT FFI (see lua/ssdb_ffi.lua) and other foreign callers.
+ *
+ * Keys and values are passed as pointer and length, results are copied into
+ * buffers owned by the caller, nothing is allocated per call but to keep
+ * the values of a reply too big for the buffer, see ssdb_ffi_take_last().
+ * A client must not be used by more than one thread at a time.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+	#define SSDB_FFI_EXTERN extern "C"
+#else
+	#define SSDB_FFI_EXTERN
+#endif
+
+#if defined(_WIN32)
+	#if defined(SSDB_EXPORTS)
+		#define SSDB_FFI_API SSDB_FFI_EXTERN __declspec(dllexport)
+	#else
+		#define SSDB_FFI_API SSDB_FFI_EXTERN __declspec(dllimport)
+	#endif
+#else
+	#define SSDB_FFI_API SSDB_FFI_EXTERN __attribute__((visibility("default")))
+#endif
+
+// return codes
+#define SSDB_FFI_OK          0
+#define SSDB_FFI_NOT_FOUND   1
+// connection error, the client is unusable
+#define SSDB_FFI_ERROR      -1
+// server replied with another status, see ssdb_ffi_status()
+#define SSDB_FFI_FAILED     -2
+// caller buffer too small, the required size is reported, fetch the values
+// with ssdb_ffi_take_last() into a bigger one
+#define SSDB_FFI_TRUNCATED  -3
+
+typedef struct ssdb_ffi_client ssdb_ffi_client;
+
+// return NULL if connection failed
+SSDB_FFI_API ssdb_ffi_client* ssdb_ffi_connect(const char *ip, int port);
+/**
+ * Use the connection of client, an ssdb::Client* returned by
+ * ssdb::Client::connect(), which must outlive the handle. Requests through
+ * the handle and the client are sent in the order they are made.
+ */
+SSDB_FFI_API ssdb_ffi_client* ssdb_ffi_wrap(void *client);
+// closes the connection unless the handle came from ssdb_ffi_wrap()
+SSDB_FFI_API void ssdb_ffi_close(ssdb_ffi_client *c);
+// status code of the last response, e.g. "ok", "not_found", "error"
+SSDB_FFI_API const char* ssdb_ffi_status(ssdb_ffi_client *c);
+
+/**
+ * *val_len receives the value length, also when SSDB_FFI_TRUNCATED
+ * is returned, in which case nothing is copied.
+ */
+SSDB_FFI_API int ssdb_ffi_get(ssdb_ffi_client *c, const char *key, int key_len,
+	char *buf, int buf_size, int *val_len);
+SSDB_FFI_API int ssdb_ffi_set(ssdb_ffi_client *c, const char *key, int key_len,
+	const char *val, int val_len);
+SSDB_FFI_API int ssdb_ffi_setx(ssdb_ffi_client *c, const char *key, int key_len,
+	const char *val, int val_len, int ttl);
+SSDB_FFI_API int ssdb_ffi_del(ssdb_ffi_client *c, const char *key, int key_len);
+SSDB_FFI_API int ssdb_ffi_incr(ssdb_ffi_client *c, const char *key, int key_len,
+	int64_t incrby, int64_t *ret);
+
+/**
+ * Values are packed back to back into buf, in the order of keys,
+ * val_lens[i] is -1 if keys[i] does not exist.
+ * *total receives the number of bytes used, or the size buf needs
+ * when SSDB_FFI_TRUNCATED is returned.
+ */
+SSDB_FFI_API int ssdb_ffi_multi_get(ssdb_ffi_client *c, int num,
+	const char **keys, const int *key_lens,
+	char *buf, int buf_size, int *val_lens, int *total);
+
+/**
+ * Copy the values of the last get or multi_get that returned
+ * SSDB_FFI_TRUNCATED into buf, packed as that call would have, without
+ * sending the request again. The handle keeps the values until its next
+ * request. Returns SSDB_FFI_FAILED if there is nothing to take,
+ * SSDB_FFI_TRUNCATED if buf is still too small, in which case the values
+ * are kept.
+ */
+SSDB_FFI_API int ssdb_ffi_take_last(ssdb_ffi_client *c, char *buf, int buf_size);
+
+#endif
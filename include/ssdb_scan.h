@@ -0,0 +1,140 @@
+#ifndef UTIL_SCAN_H_
+#define UTIL_SCAN_H_
+
+/**
+ * Framing helpers for the ssdb and RESP protocols.
+ *
+ * find_newline() and scan_newlines() use SSE2 (AVX2 when the compiler
+ * targets it) on x86, and fall back to memchr() elsewhere.
+ * parse_header() reads a length line in place, without copying it.
+ */
+
+#include <string.h>
+
+#if defined(__AVX2__)
+	#define SSDB_SCAN_AVX2 1
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SSDB_SCAN_SSE2 1
+	#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+static inline
+int scan_ctz(unsigned int mask){
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward(&idx, mask);
+	return (int)idx;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+/**
+ * return the offset of the first '\n' in p[0, size), -1 if there is none.
+ */
+static inline
+int find_newline(const char *p, int size){
+	int i = 0;
+#if defined(SSDB_SCAN_AVX2)
+	const __m256i nl32 = _mm256_set1_epi8('\n');
+	for(; i + 32 <= size; i += 32){
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl32));
+		if(mask){
+			return i + scan_ctz(mask);
+		}
+	}
+#endif
+#if defined(SSDB_SCAN_AVX2) || defined(SSDB_SCAN_SSE2)
+	const __m128i nl16 = _mm_set1_epi8('\n');
+	for(; i + 16 <= size; i += 16){
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl16));
+		if(mask){
+			return i + scan_ctz(mask);
+		}
+	}
+	for(; i < size; i++){
+		if(p[i] == '\n'){
+			return i;
+		}
+	}
+	return -1;
+#else
+	const char *lf = (const char *)memchr(p, '\n', size);
+	return lf? (int)(lf - p) : -1;
+#endif
+}
+
+/**
+ * store the offsets of up to max '\n' found in p[0, size) into pos.
+ * return the number stored, stops early once max is reached.
+ */
+static inline
+int scan_newlines(const char *p, int size, int *pos, int max){
+	int num = 0;
+	int i = 0;
+#if defined(SSDB_SCAN_AVX2) || defined(SSDB_SCAN_SSE2)
+	const __m128i nl16 = _mm_set1_epi8('\n');
+	for(; i + 16 <= size && num < max; i += 16){
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl16));
+		while(mask && num < max){
+			pos[num++] = i + scan_ctz(mask);
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for(; i < size && num < max; i++){
+		if(p[i] == '\n'){
+			pos[num++] = i;
+		}
+	}
+	return num;
+}
+
+/**
+ * parse a length line, digits followed by "\n" or "\r\n".
+ * return the bytes of the line including its end and store the value in *len,
+ * 0 if the line is not complete yet, -1 on bad format.
+ */
+static inline
+int parse_header(const char *p, int size, int *len){
+	long long val = 0;
+	int i = 0;
+	// more than 10 digits does not fit in int, bad format anyway
+	for(; i < size && i < 11; i++){
+		unsigned int d = (unsigned char)p[i] - '0';
+		if(d > 9){
+			break;
+		}
+		val = val * 10 + d;
+	}
+	if(i == 0 || val > 0x7fffffff){
+		return (size == 0)? 0 : -1;
+	}
+	if(i == size){
+		return 0;
+	}
+	if(p[i] == '\n'){
+		*len = (int)val;
+		return i + 1;
+	}
+	if(p[i] == '\r'){
+		if(i + 1 == size){
+			return 0;
+		}
+		if(p[i + 1] == '\n'){
+			*len = (int)val;
+			return i + 2;
+		}
+	}
+	return -1;
+}
+
+#endif
@@ -12,8 +12,17 @@ found in the LICENSE file.
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <ctype.h>
 #include <string>
 #include <algorithm>
+// integer to_chars() is only trusted from C++17 compilers that ship it
+#if defined(__has_include)
+	#if __has_include(<charconv>) && ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+		#include <charconv>
+		#define SSDB_HAVE_TO_CHARS 1
+	#endif
+#endif
 #if defined(_WIN32)
 	#include "win_unistd.h"
 #else
@@ -257,31 +266,155 @@ std::string str(const char *s){
 	return std::string(s);
 }
 
+/**
+ * number of decimal digits of v.
+ */
+static inline
+int uint64_digits(uint64_t v){
+	int n = 1;
+	while(1){
+		if(v < 10) return n;
+		if(v < 100) return n + 1;
+		if(v < 1000) return n + 2;
+		if(v < 10000) return n + 3;
+		v /= 10000;
+		n += 4;
+	}
+}
+
+/**
+ * write v in decimal into buf, which must hold 20 bytes, NOT null-terminated.
+ * return the number of bytes written.
+ */
+static inline
+int uint64_to_str(char *buf, uint64_t v){
+#if defined(SSDB_HAVE_TO_CHARS)
+	return (int)(std::to_chars(buf, buf + 20, v).ptr - buf);
+#else
+	static const char digits[] =
+		"00010203040506070809"
+		"10111213141516171819"
+		"20212223242526272829"
+		"30313233343536373839"
+		"40414243444546474849"
+		"50515253545556575859"
+		"60616263646566676869"
+		"70717273747576777879"
+		"80818283848586878889"
+		"90919293949596979899";
+	int len = uint64_digits(v);
+	// two digits at a time, from the end
+	char *p = buf + len;
+	while(v >= 100){
+		int i = (int)(v % 100) * 2;
+		v /= 100;
+		*--p = digits[i + 1];
+		*--p = digits[i];
+	}
+	if(v >= 10){
+		int i = (int)v * 2;
+		*--p = digits[i + 1];
+		*--p = digits[i];
+	}else{
+		*--p = (char)('0' + v);
+	}
+	return len;
+#endif
+}
+
+/**
+ * buf must hold 21 bytes, NOT null-terminated.
+ */
+static inline
+int int64_to_str(char *buf, int64_t v){
+	if(v < 0){
+		buf[0] = '-';
+		return 1 + uint64_to_str(buf + 1, 0 - (uint64_t)v);
+	}
+	return uint64_to_str(buf, (uint64_t)v);
+}
+
+/**
+ * parse a decimal integer from p[0, size), the way strtoll() does (leading
+ * spaces and a sign are accepted), except that the WHOLE input must be used.
+ * return 0, EINVAL if there are bytes left, or ERANGE with *out clamped.
+ * An empty input is 0, as it has always been with strtoll().
+ */
+static inline
+int parse_int64(const char *p, int size, int64_t *out){
+	int i = 0;
+	while(i < size && isspace((unsigned char)p[i])){
+		i++;
+	}
+	bool neg = false;
+	if(i < size && (p[i] == '-' || p[i] == '+')){
+		neg = (p[i] == '-');
+		i++;
+	}
+	const int start = i;
+	uint64_t val = 0;
+	// 19 digits never overflow uint64_t, no check needed
+	const int fast_end = (size - i > 19)? i + 19 : size;
+	for(; i < fast_end; i++){
+		unsigned int d = (unsigned char)p[i] - '0';
+		if(d > 9){
+			break;
+		}
+		val = val * 10 + d;
+	}
+	bool range = false;
+	for(; i < size; i++){
+		unsigned int d = (unsigned char)p[i] - '0';
+		if(d > 9){
+			break;
+		}
+		if(val > (UINT64_MAX - d) / 10){
+			range = true;
+		}else{
+			val = val * 10 + d;
+		}
+	}
+	const uint64_t limit = neg? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+	if(range || val > limit){
+		*out = neg? INT64_MIN : INT64_MAX;
+		return ERANGE;
+	}
+	*out = neg? (int64_t)(0 - val) : (int64_t)val;
+	if(size == 0){
+		return 0;
+	}
+	if(i == start || i != size){
+		return EINVAL;
+	}
+	return 0;
+}
+
 static inline
 std::string str(int v){
-	char buf[21] = {0};
-	snprintf(buf, sizeof(buf), "%d", v);
-	return std::string(buf);
+	char buf[21];
+	return std::string(buf, int64_to_str(buf, v));
 }
 
 static inline
 std::string str(int64_t v){
-	char buf[21] = {0};
-	snprintf(buf, sizeof(buf), "%" PRId64 "", v);
-	return std::string(buf);
+	char buf[21];
+	return std::string(buf, int64_to_str(buf, v));
 }
 
 static inline
 std::string str(uint64_t v){
-	char buf[21] = {0};
-	snprintf(buf, sizeof(buf), "%" PRIu64 "", v);
-	return std::string(buf);
+	char buf[21];
+	return std::string(buf, uint64_to_str(buf, v));
 }
 
 static inline
 std::string str(double v){
 	char buf[21] = {0};
 	if(v - floor(v) == 0){
+		// integral scores are the common case, -0 is left to snprintf
+		if(v > -9.2e18 && v < 9.2e18 && !(v == 0 && signbit(v))){
+			return std::string(buf, int64_to_str(buf, (int64_t)v));
+		}
 		snprintf(buf, sizeof(buf), "%.0f", v);
 	}else{
 		snprintf(buf, sizeof(buf), "%f", v);
@@ -297,47 +430,35 @@ std::string str(float v){
 // all str_to_xx methods set errno on error
 
 static inline
-int str_to_int(const std::string &str){
-	const char *start = str.c_str();
-	char *end;
-	int ret = (int)strtol(start, &end, 10);
-	// the WHOLE string must be string represented integer
-	if(*end == '\0' && size_t(end - start) == str.size()){
-		errno = 0;
-	}else{
-		// strtoxx do not set errno all the time!
-		if(errno == 0){
-			errno = EINVAL;
-		}
-	}
+int64_t str_to_int64(const char *p, int size){
+	int64_t ret;
+	errno = parse_int64(p, size, &ret);
 	return ret;
 }
 
 static inline
-int str_to_int(const char *p, int size){
-	return str_to_int(std::string(p, size));
+int64_t str_to_int64(const std::string &str){
+	return str_to_int64(str.data(), (int)str.size());
 }
 
 static inline
-int64_t str_to_int64(const std::string &str){
-	const char *start = str.c_str();
-	char *end;
-	int64_t ret = (int64_t)strtoll(start, &end, 10);
-	// the WHOLE string must be string represented integer
-	if(*end == '\0' && size_t(end - start) == str.size()){
-		errno = 0;
-	}else{
-		// strtoxx do not set errno all the time!
-		if(errno == 0){
-			errno = EINVAL;
-		}
+int str_to_int(const char *p, int size){
+	int64_t ret;
+	errno = parse_int64(p, size, &ret);
+	if(ret > INT_MAX){
+		errno = ERANGE;
+		return INT_MAX;
 	}
-	return ret;
+	if(ret < INT_MIN){
+		errno = ERANGE;
+		return INT_MIN;
+	}
+	return (int)ret;
 }
 
 static inline
-int64_t str_to_int64(const char *p, int size){
-	return str_to_int64(std::string(p, size));
+int str_to_int(const std::string &str){
+	return str_to_int(str.data(), (int)str.size());
 }
 
 static inline
@@ -364,6 +485,11 @@ uint64_t str_to_uint64(const char *p, int size){
 
 static inline
 double str_to_double(const char *p, int size){
+	// most scores are integers, skip the copy and atof() for them
+	int64_t v;
+	if(size > 0 && parse_int64(p, size, &v) == 0){
+		return (double)v;
+	}
 	return atof(std::string(p, size).c_str());
 }
 
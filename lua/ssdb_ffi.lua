@@ -0,0 +1,248 @@
+--[[
+Lua ssdb module, LuaJIT FFI fast path.
+
+Under LuaJIT get, set, set_ttl, del, inc and multi_get call the plain C ABI
+of the ssdb library (include/ssdb_ffi.h) through the FFI, so the JIT can
+compile the call sites. Every other method, and every method on other Lua
+implementations, goes to the classic ssdb module. Results are the same as
+the classic client returns.
+
+Both paths share the connection of one classic client, so requests are
+sent in the order they are made, whichever path they take.
+
+	local ssdb = require 'ssdb_ffi'
+	local client, ok = ssdb.connect( '127.0.0.1', 8888 )
+	local ok, value = client:get( 'key' )
+
+@module ssdb_ffi
+]]
+
+local classic = require 'ssdb'
+
+local ok, ffi = pcall( require, 'ffi' )
+if not ok or not jit then
+	return classic
+end
+
+ffi.cdef[[
+typedef struct ssdb_ffi_client ssdb_ffi_client;
+ssdb_ffi_client* ssdb_ffi_wrap(void *client);
+void ssdb_ffi_close(ssdb_ffi_client *c);
+const char* ssdb_ffi_status(ssdb_ffi_client *c);
+int ssdb_ffi_get(ssdb_ffi_client *c, const char *key, int key_len, char *buf, int buf_size, int *val_len);
+int ssdb_ffi_set(ssdb_ffi_client *c, const char *key, int key_len, const char *val, int val_len);
+int ssdb_ffi_setx(ssdb_ffi_client *c, const char *key, int key_len, const char *val, int val_len, int ttl);
+int ssdb_ffi_del(ssdb_ffi_client *c, const char *key, int key_len);
+int ssdb_ffi_incr(ssdb_ffi_client *c, const char *key, int key_len, int64_t incrby, int64_t *ret);
+int ssdb_ffi_multi_get(ssdb_ffi_client *c, int num, const char **keys, const int *key_lens, char *buf, int buf_size, int *val_lens, int *total);
+int ssdb_ffi_take_last(ssdb_ffi_client *c, char *buf, int buf_size);
+]]
+
+-- the ssdb library is already loaded by require 'ssdb', load it again by path to reach its symbols
+local lib = ffi.load( package.searchpath( 'ssdb', package.cpath ) )
+
+local OK, TRUNCATED = 0, -3
+
+local int1 = ffi.typeof( 'int[1]' )
+local int64_1 = ffi.typeof( 'int64_t[1]' )
+local char_buf = ffi.typeof( 'char[?]' )
+local int_array = ffi.typeof( 'int[?]' )
+local str_array = ffi.typeof( 'const char*[?]' )
+
+local client = {}
+local client_meta = {}
+
+--- Internal, same error results as the classic client, where Status::error()
+-- holds for every status but ok, so only the code tells failures apart
+local function error_status( self )
+	return false, 'connection', ffi.string( lib.ssdb_ffi_status( self.pClient ) )
+end
+
+--- Internal, grow the value buffer to iSize bytes and copy the values of the truncated reply into it
+local function take_last( self, iSize )
+	local iNewSize = self.iBufSize
+	while iNewSize < iSize do
+		iNewSize = iNewSize * 2
+	end
+	self.pBuf = char_buf( iNewSize )
+	self.iBufSize = iNewSize
+	return lib.ssdb_ffi_take_last( self.pClient, self.pBuf, self.iBufSize )
+end
+
+--- create new ssdb client
+-- @function connect
+-- @param ip remote address
+-- @param port remote port
+-- @return client
+-- @return bool connection success to server
+local function connect( sHost, iPort )
+	local pClassic, bOk = classic.connect( sHost, iPort )
+	local self = setmetatable( {
+		pClassic = pClassic,
+		pBuf = char_buf( 4096 ),
+		iBufSize = 4096,
+		pLen = int1(),
+		pTotal = int1(),
+		pInt64 = int64_1(),
+		iKeys = 0,
+		pClient = false,
+	}, client_meta )
+	if bOk then
+		-- the classic userdata holds its ssdb::Client*, which self keeps alive through pClassic
+		local pClient = lib.ssdb_ffi_wrap( ffi.cast( 'void**', pClassic )[ 0 ] )
+		self.pClient = ffi.gc( pClient, lib.ssdb_ffi_close )
+	end
+	return self, bOk
+end
+
+--- get value
+-- @function get
+-- @param key
+-- @return success true is success
+-- @return string value
+function client:get( sKey )
+	if not self.pClient then
+		return false, 'connection', 'error'
+	end
+	local iRes = lib.ssdb_ffi_get( self.pClient, sKey, #sKey, self.pBuf, self.iBufSize, self.pLen )
+	if iRes == TRUNCATED then
+		iRes = take_last( self, self.pLen[ 0 ] )
+	end
+	if iRes ~= OK then
+		return error_status( self )
+	end
+	return true, ffi.string( self.pBuf, self.pLen[ 0 ] )
+end
+
+--- set value
+-- @function set
+-- @param key
+-- @param value
+-- @return success true is success
+function client:set( sKey, sValue )
+	if not self.pClient then
+		return false, 'connection', 'error'
+	end
+	sValue = tostring( sValue )
+	local iRes = lib.ssdb_ffi_set( self.pClient, sKey, #sKey, sValue, #sValue )
+	if iRes ~= OK then
+		return error_status( self )
+	end
+	return true
+end
+
+--- set value with time to live
+-- @function set_ttl
+-- @param key
+-- @param value
+-- @param ttl seconds
+-- @return success true is success
+function client:set_ttl( sKey, sValue, iTTL )
+	if not self.pClient then
+		return false, 'connection', 'error'
+	end
+	sValue = tostring( sValue )
+	local iRes = lib.ssdb_ffi_setx( self.pClient, sKey, #sKey, sValue, #sValue, iTTL )
+	if iRes ~= OK then
+		return error_status( self )
+	end
+	return true
+end
+
+--- delete value
+-- @function del
+-- @param key
+-- @return success true is success
+function client:del( sKey )
+	if not self.pClient then
+		return false, 'connection', 'error'
+	end
+	local iRes = lib.ssdb_ffi_del( self.pClient, sKey, #sKey )
+	if iRes ~= OK then
+		return error_status( self )
+	end
+	return true
+end
+
+--- increment value
+-- @function inc
+-- @param key
+-- @param number increment
+-- @return success true is success
+-- @return number new value
+function client:inc( sKey, iInc )
+	if not self.pClient then
+		return false, 'connection', 'error'
+	end
+	local iRes = lib.ssdb_ffi_incr( self.pClient, sKey, #sKey, iInc or 1, self.pInt64 )
+	if iRes ~= OK then
+		return error_status( self )
+	end
+	return true, tonumber( self.pInt64[ 0 ] )
+end
+
+--- get multiple values
+-- @function multi_get
+-- @param keys table
+-- @return success true is success
+-- @return table key, value pairs of existing keys
+function client:multi_get( aKeys )
+	if not self.pClient then
+		return false, 'connection', 'error'
+	end
+	local iNum = #aKeys
+	if iNum > self.iKeys then
+		self.pKeys = str_array( iNum )
+		self.pKeyLens = int_array( iNum )
+		self.pValLens = int_array( iNum )
+		self.iKeys = iNum
+	end
+	local pKeys, pKeyLens, pValLens = self.pKeys, self.pKeyLens, self.pValLens
+	for i = 1, iNum do
+		local sKey = aKeys[ i ]
+		pKeys[ i - 1 ] = sKey
+		pKeyLens[ i - 1 ] = #sKey
+	end
+	-- aKeys keeps the key strings alive during the call
+	local iRes = lib.ssdb_ffi_multi_get( self.pClient, iNum, pKeys, pKeyLens, self.pBuf, self.iBufSize, pValLens, self.pTotal )
+	if iRes == TRUNCATED then
+		iRes = take_last( self, self.pTotal[ 0 ] )
+	end
+	if iRes ~= OK then
+		return error_status( self )
+	end
+	local aResult = {}
+	local iPos = 0
+	for i = 0, iNum - 1 do
+		local iLen = pValLens[ i ]
+		if iLen >= 0 then
+			aResult[ aKeys[ i + 1 ] ] = ffi.string( self.pBuf + iPos, iLen )
+			iPos = iPos + iLen
+		end
+	end
+	return true, aResult
+end
+
+--- Internal, methods without fast path run the classic method on the shared classic client
+local classic_methods = debug.getregistry()[ ':ssdbmeta:' ].__index
+client_meta.__index = function( _, sName )
+	local fMethod = client[ sName ]
+	local fClassic = classic_methods[ sName ]
+	if fMethod or not fClassic then
+		return fMethod
+	end
+	fMethod = function( self, ... )
+		return fClassic( self.pClassic, ... )
+	end
+	client[ sName ] = fMethod
+	return fMethod
+end
+
+local module = {}
+for sName, fFunc in pairs( classic ) do
+	module[ sName ] = fFunc
+end
+module.connect = connect
+module.classic = classic
+
+return module
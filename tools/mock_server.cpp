@@ -0,0 +1,221 @@
+/*
+Mock SSDB server, for benchmarks and client tests without a real SSDB.
+It answers every command the client library sends from a MemoryStore
+shared by all connections, and can inject the faults a network and a
+busy server cause.
+
+	g++ -O2 -std=c++11 -I../include mock_server.cpp ../include/memory_store.cpp \
+		../include/bloom_filter.cpp ../include/link.cpp ../include/ssdb_bytes.cpp \
+		../include/buffer_pool.cpp ../include/buffer_policy.cpp -lpthread -o mock_server
+	./mock_server [-l ip:port] [-d ms] [-j ms] [-f bytes] [-r bytes] [-s ms]
+
+-l  address to listen on, default 127.0.0.1:8888
+-d  latency added before the replies are written, in milliseconds
+-j  jitter, a random 0 to this many milliseconds more latency
+-f  write replies this many bytes per write call, 1 sends every byte in
+    a packet of its own, default 0 writes them at once
+-r  read requests this many bytes per read call, default 0 reads all
+    that has arrived
+-s  slow reader, sleep this many milliseconds before every read
+
+Every connection is served by a thread of its own with blocking IO.
+Requests a client pipelines and which arrive together are answered
+together, after one latency, the way a round trip to a server costs it
+once. Redis clients are answered too, Link reads their requests and
+replies in the Redis protocol.
+*/
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "link.h"
+#include "memory_store.h"
+
+struct Config{
+	std::string listen_ip;
+	int listen_port;
+	int latency;
+	int jitter;
+	int write_bytes;
+	int read_bytes;
+	int read_delay;
+};
+
+static Config conf;
+static MemoryStore store;
+
+static void sleep_ms(int ms){
+	if(ms > 0){
+		std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	}
+}
+
+// read at most conf.read_bytes, after conf.read_delay
+static int read_link(Link *link){
+	sleep_ms(conf.read_delay);
+	if(conf.read_bytes <= 0){
+		return link->read();
+	}
+	Buffer *input = link->input;
+	input->nice();
+	if(input->space() == 0 && input->grow() == -1){
+		return -1;
+	}
+	int want = input->space() < conf.read_bytes? input->space() : conf.read_bytes;
+	int len;
+	while((len = ::read(link->fd(), input->slot(), want)) == -1){
+		if(errno != EINTR){
+			return -1;
+		}
+	}
+	input->incr(len);
+	return len;
+}
+
+// write the output buffer conf.write_bytes at a time
+static int flush_link(Link *link){
+	if(conf.write_bytes <= 0){
+		return link->flush();
+	}
+	Buffer *output = link->output;
+	while(!output->empty()){
+		int want = output->size() < conf.write_bytes? output->size() : conf.write_bytes;
+		int len = ::write(link->fd(), output->data(), want);
+		if(len == -1){
+			if(errno == EINTR){
+				continue;
+			}
+			return -1;
+		}
+		output->decr(len);
+	}
+	output->nice();
+	return 0;
+}
+
+static void serve(Link *link){
+	std::mt19937 rand((unsigned)(size_t)link ^ (unsigned)time(NULL));
+	std::vector<std::string> resp;
+	link->nodelay(true);
+	while(1){
+		int len = read_link(link);
+		if(len <= 0){
+			break;
+		}
+		bool answered = false;
+		bool failed = false;
+		while(1){
+			const std::vector<Bytes> *req = link->recv();
+			if(req == NULL){
+				failed = true;
+				break;
+			}
+			if(req->empty()){
+				break;
+			}
+			store.execute(&(*req)[0], (int)req->size(), &resp);
+			link->send(resp);
+			answered = true;
+		}
+		if(answered){
+			int delay = conf.latency;
+			if(conf.jitter > 0){
+				delay += (int)(rand() % (conf.jitter + 1));
+			}
+			sleep_ms(delay);
+			if(flush_link(link) == -1){
+				break;
+			}
+		}
+		if(failed){
+			break;
+		}
+	}
+	delete link;
+}
+
+static bool parse_addr(const char *s, std::string *ip, int *port){
+	const char *p = strrchr(s, ':');
+	if(p == NULL || p == s){
+		return false;
+	}
+	ip->assign(s, p - s);
+	*port = atoi(p + 1);
+	return *port > 0;
+}
+
+static void usage(const char *prog){
+	fprintf(stderr, "usage: %s [-l ip:port] [-d ms] [-j ms] [-f bytes] [-r bytes] [-s ms]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv){
+	conf.listen_ip = "127.0.0.1";
+	conf.listen_port = 8888;
+	conf.latency = 0;
+	conf.jitter = 0;
+	conf.write_bytes = 0;
+	conf.read_bytes = 0;
+	conf.read_delay = 0;
+
+	int opt;
+	while((opt = getopt(argc, argv, "l:d:j:f:r:s:")) != -1){
+		switch(opt){
+			case 'l':
+				if(!parse_addr(optarg, &conf.listen_ip, &conf.listen_port)){
+					usage(argv[0]);
+				}
+				break;
+			case 'd':
+				conf.latency = atoi(optarg);
+				break;
+			case 'j':
+				conf.jitter = atoi(optarg);
+				break;
+			case 'f':
+				conf.write_bytes = atoi(optarg);
+				break;
+			case 'r':
+				conf.read_bytes = atoi(optarg);
+				break;
+			case 's':
+				conf.read_delay = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	Link *listen_link = Link::listen(conf.listen_ip.c_str(), conf.listen_port);
+	if(listen_link == NULL){
+		fprintf(stderr, "error: unable to listen on %s:%d, %s\n",
+			conf.listen_ip.c_str(), conf.listen_port, strerror(errno));
+		return 1;
+	}
+	printf("mock ssdb %s:%d, latency %d+%d ms, write %d, read %d bytes, read delay %d ms\n",
+		conf.listen_ip.c_str(), conf.listen_port, conf.latency, conf.jitter,
+		conf.write_bytes, conf.read_bytes, conf.read_delay);
+	fflush(stdout);
+
+	while(1){
+		Link *link = listen_link->accept();
+		if(link == NULL){
+			if(errno == EMFILE || errno == ENFILE){
+				sleep_ms(100);
+			}
+			continue;
+		}
+		std::thread(serve, link).detach();
+	}
+	delete listen_link;
+	return 0;
+}
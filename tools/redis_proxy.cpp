@@ -0,0 +1,547 @@
+/*
+Redis to SSDB proxy. Redis clients connect to it, every request is
+translated by RedisLink and sent to SSDB over a few pipelined backend
+connections per worker thread, and the reply translated back.
+
+	g++ -O2 -std=c++11 -I../include redis_proxy.cpp ../include/link.cpp \
+		../include/ssdb_bytes.cpp ../include/buffer_pool.cpp ../include/buffer_policy.cpp \
+		-lpthread -o redis_proxy
+	./redis_proxy [-l ip:port] [-s ssdb_ip:port] [-t threads] [-c backends]
+
+-l  address to accept Redis clients on, default 127.0.0.1:6380
+-s  the SSDB server, default 127.0.0.1:8888
+-t  worker threads, default the number of cores
+-c  backend connections per worker, default 2
+
+Every worker runs its own epoll loop, accepts from the shared listening
+socket and owns its backends, so workers share nothing. A client is
+bound to the backend with the fewest clients when it sends its first
+request, and keeps it while it lives, so its requests reach
+SSDB in the order sent. Clients may pipeline, and requests read in one
+loop iteration are flushed to the backends together.
+
+Linux only, it needs epoll.
+*/
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include "link.h"
+
+// a client stops being read while this many of its requests are unanswered
+const static int MAX_PENDING = 1024;
+const static int MAX_EVENTS = 256;
+
+enum{
+	CONN_LISTEN,
+	CONN_CLIENT,
+	CONN_BACKEND
+};
+
+struct Client;
+
+struct Conn{
+	int type;
+	Link *link;
+	bool dirty;
+	bool want_write;
+	// not polled for input
+	bool paused;
+	Conn(int type){
+		this->type = type;
+		this->link = NULL;
+		this->dirty = false;
+		this->want_write = false;
+		this->paused = false;
+	}
+};
+
+// a request of a client, its RedisLink keeps what the reply is converted with
+struct Pending{
+	Client *client;
+	RedisLink redis;
+	bool done;
+	std::vector<std::string> resp;
+};
+
+struct Backend;
+
+struct Client : public Conn{
+	std::deque<Pending> pending;
+	int inflight;
+	bool closed;
+	Backend *backend;
+	Client() : Conn(CONN_CLIENT){
+		inflight = 0;
+		closed = false;
+		backend = NULL;
+	}
+};
+
+struct Backend : public Conn{
+	// requests sent, in the order their replies will come
+	std::deque<Pending *> waiting;
+	int clients;
+	time_t last_connect;
+	Backend() : Conn(CONN_BACKEND){
+		clients = 0;
+		last_connect = 0;
+	}
+};
+
+struct Config{
+	std::string listen_ip;
+	int listen_port;
+	std::string ssdb_ip;
+	int ssdb_port;
+	int threads;
+	int backends;
+};
+
+class Worker{
+private:
+	const Config &conf;
+	int epfd;
+	Conn listener;
+	std::vector<Backend *> backends;
+	std::vector<Conn *> dirty;
+	std::vector<Client *> closing;
+
+	void watch(Conn *conn, int op, bool want_write);
+	void mark_dirty(Conn *conn);
+	bool connect_backend(Backend *backend);
+	void fail_backend(Backend *backend, const char *msg);
+	Backend* pick_backend();
+	void bind(Client *client, Backend *backend);
+	void accept_clients();
+	void close_client(Client *client);
+	void read_client(Client *client);
+	void parse_requests(Client *client);
+	void deliver(Client *client);
+	void read_backend(Backend *backend);
+	void flush();
+public:
+	Worker(const Config &conf, Link *listen_link);
+	~Worker();
+	void run();
+};
+
+Worker::Worker(const Config &conf, Link *listen_link) : conf(conf), listener(CONN_LISTEN){
+	epfd = epoll_create(1024);
+	listener.link = listen_link;
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+#ifdef EPOLLEXCLUSIVE
+	// wake one worker per connection
+	ev.events |= EPOLLEXCLUSIVE;
+#endif
+	ev.data.ptr = &listener;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, listen_link->fd(), &ev);
+
+	for(int i=0; i<conf.backends; i++){
+		Backend *backend = new Backend();
+		this->connect_backend(backend);
+		backends.push_back(backend);
+	}
+}
+
+Worker::~Worker(){
+	for(int i=0; i<(int)backends.size(); i++){
+		delete backends[i]->link;
+		delete backends[i];
+	}
+	::close(epfd);
+}
+
+void Worker::watch(Conn *conn, int op, bool want_write){
+	struct epoll_event ev;
+	ev.events = 0;
+	if(!conn->paused){
+		ev.events |= EPOLLIN;
+	}
+	if(want_write){
+		ev.events |= EPOLLOUT;
+	}
+	ev.data.ptr = conn;
+	epoll_ctl(epfd, op, conn->link->fd(), &ev);
+	conn->want_write = want_write;
+}
+
+void Worker::mark_dirty(Conn *conn){
+	if(!conn->dirty){
+		conn->dirty = true;
+		dirty.push_back(conn);
+	}
+}
+
+bool Worker::connect_backend(Backend *backend){
+	backend->last_connect = time(NULL);
+	Link *link = Link::connect(conf.ssdb_ip.c_str(), conf.ssdb_port);
+	if(link == NULL){
+		fprintf(stderr, "error: unable to connect to ssdb %s:%d\n", conf.ssdb_ip.c_str(), conf.ssdb_port);
+		return false;
+	}
+	link->nodelay(true);
+	link->noblock(true);
+	backend->link = link;
+	this->watch(backend, EPOLL_CTL_ADD, false);
+	return true;
+}
+
+// answer everything sent on a broken backend with an error
+void Worker::fail_backend(Backend *backend, const char *msg){
+	fprintf(stderr, "error: %s, %d requests failed\n", msg, (int)backend->waiting.size());
+	epoll_ctl(epfd, EPOLL_CTL_DEL, backend->link->fd(), NULL);
+	delete backend->link;
+	backend->link = NULL;
+	backend->want_write = false;
+	std::deque<Pending *> waiting;
+	waiting.swap(backend->waiting);
+	for(int i=0; i<(int)waiting.size(); i++){
+		Pending *req = waiting[i];
+		req->resp.clear();
+		req->resp.push_back("error");
+		req->resp.push_back(msg);
+		req->done = true;
+		Client *client = req->client;
+		client->inflight --;
+		this->deliver(client);
+		if(client->paused && !client->closed){
+			this->parse_requests(client);
+		}
+	}
+}
+
+// the live backend with the fewest clients, reconnecting at most once a second
+Backend* Worker::pick_backend(){
+	Backend *ret = NULL;
+	time_t now = time(NULL);
+	for(int i=0; i<(int)backends.size(); i++){
+		Backend *backend = backends[i];
+		if(backend->link == NULL){
+			if(backend->last_connect == now || !this->connect_backend(backend)){
+				continue;
+			}
+		}
+		if(ret == NULL || backend->clients < ret->clients){
+			ret = backend;
+		}
+	}
+	return ret;
+}
+
+void Worker::bind(Client *client, Backend *backend){
+	if(client->backend){
+		client->backend->clients --;
+	}
+	client->backend = backend;
+	if(backend){
+		backend->clients ++;
+	}
+}
+
+void Worker::accept_clients(){
+	while(1){
+		Link *link = listener.link->accept();
+		if(link == NULL){
+			break;
+		}
+		link->nodelay(true);
+		link->noblock(true);
+		Client *client = new Client();
+		client->link = link;
+		this->watch(client, EPOLL_CTL_ADD, false);
+	}
+}
+
+// the Client is freed once the replies it waits for came back
+void Worker::close_client(Client *client){
+	if(client->closed){
+		return;
+	}
+	client->closed = true;
+	epoll_ctl(epfd, EPOLL_CTL_DEL, client->link->fd(), NULL);
+	delete client->link;
+	client->link = NULL;
+	closing.push_back(client);
+}
+
+// -1 once the peer closed or failed, a wakeup without data reads 0
+static int read_link(Link *link){
+	errno = 0;
+	int len = link->read();
+	if(len == 0 && errno == EWOULDBLOCK){
+		return 0;
+	}
+	return len > 0? len : -1;
+}
+
+void Worker::read_client(Client *client){
+	if(read_link(client->link) == -1){
+		this->close_client(client);
+		return;
+	}
+	this->parse_requests(client);
+}
+
+void Worker::parse_requests(Client *client){
+	Buffer *input = client->link->input;
+	while(!input->empty() && (int)client->pending.size() < MAX_PENDING){
+		client->pending.push_back(Pending());
+		Pending *req = &client->pending.back();
+		req->client = client;
+		req->done = false;
+		const std::vector<Bytes> *packet = req->redis.recv_req(input);
+		if(packet == NULL){
+			client->pending.pop_back();
+			this->close_client(client);
+			return;
+		}
+		if(packet->empty()){
+			client->pending.pop_back();
+			break;
+		}
+		// the requests lost by a failed backend have been answered, move on
+		if(client->backend == NULL || client->backend->link == NULL){
+			this->bind(client, this->pick_backend());
+		}
+		Backend *backend = client->backend;
+		if(backend == NULL || backend->link == NULL){
+			req->resp.push_back("error");
+			req->resp.push_back("ssdb not connected");
+			req->done = true;
+			continue;
+		}
+		backend->link->send(*packet);
+		backend->waiting.push_back(req);
+		client->inflight ++;
+		this->mark_dirty(backend);
+	}
+	this->deliver(client);
+
+	bool full = (int)client->pending.size() >= MAX_PENDING;
+	if(full != client->paused && !client->closed){
+		client->paused = full;
+		this->watch(client, EPOLL_CTL_MOD, client->want_write);
+	}
+}
+
+// write the replies which are next in order
+void Worker::deliver(Client *client){
+	bool sent = false;
+	while(!client->pending.empty() && client->pending.front().done){
+		Pending &req = client->pending.front();
+		if(!client->closed){
+			req.redis.send_resp(client->link->output, req.resp);
+			sent = true;
+		}
+		client->pending.pop_front();
+	}
+	if(sent){
+		this->mark_dirty(client);
+	}
+}
+
+void Worker::read_backend(Backend *backend){
+	if(read_link(backend->link) == -1){
+		this->fail_backend(backend, "ssdb connection lost");
+		return;
+	}
+	while(1){
+		const std::vector<Bytes> *packet = backend->link->recv();
+		if(packet == NULL){
+			this->fail_backend(backend, "bad response from ssdb");
+			return;
+		}
+		if(packet->empty()){
+			break;
+		}
+		if(backend->waiting.empty()){
+			this->fail_backend(backend, "unexpected response from ssdb");
+			return;
+		}
+		Pending *req = backend->waiting.front();
+		backend->waiting.pop_front();
+		Client *client = req->client;
+		client->inflight --;
+		if(req == &client->pending.front()){
+			// next in order, converted straight from the backend's buffer
+			if(!client->closed){
+				req->redis.send_resp(client->link->output, *packet);
+				this->mark_dirty(client);
+			}
+			client->pending.pop_front();
+		}else{
+			req->resp.clear();
+			for(int i=0; i<(int)packet->size(); i++){
+				req->resp.push_back(packet->at(i).String());
+			}
+			req->done = true;
+		}
+		this->deliver(client);
+		if(client->paused && !client->closed){
+			this->parse_requests(client);
+		}
+	}
+}
+
+void Worker::flush(){
+	for(int i=0; i<(int)dirty.size(); i++){
+		Conn *conn = dirty[i];
+		conn->dirty = false;
+		if(conn->link == NULL){
+			continue;
+		}
+		if(conn->link->write() == -1){
+			if(conn->type == CONN_BACKEND){
+				this->fail_backend((Backend *)conn, "ssdb connection lost");
+			}else{
+				this->close_client((Client *)conn);
+			}
+			continue;
+		}
+		bool want_write = !conn->link->output->empty();
+		if(want_write != conn->want_write){
+			this->watch(conn, EPOLL_CTL_MOD, want_write);
+		}
+	}
+	dirty.clear();
+
+	for(int i=0; i<(int)closing.size(); ){
+		Client *client = closing[i];
+		if(client->inflight == 0 && !client->dirty){
+			closing[i] = closing.back();
+			closing.pop_back();
+			this->bind(client, NULL);
+			delete client;
+		}else{
+			i ++;
+		}
+	}
+}
+
+void Worker::run(){
+	struct epoll_event events[MAX_EVENTS];
+	while(1){
+		int num = epoll_wait(epfd, events, MAX_EVENTS, 1000);
+		if(num == -1){
+			if(errno == EINTR){
+				continue;
+			}
+			fprintf(stderr, "error: epoll_wait: %s\n", strerror(errno));
+			break;
+		}
+		for(int i=0; i<num; i++){
+			Conn *conn = (Conn *)events[i].data.ptr;
+			if(conn->type == CONN_LISTEN){
+				this->accept_clients();
+				continue;
+			}
+			// a Client closed earlier in this batch
+			if(conn->link == NULL){
+				continue;
+			}
+			if(events[i].events & EPOLLOUT){
+				this->mark_dirty(conn);
+			}
+			if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)){
+				if(conn->type == CONN_CLIENT){
+					this->read_client((Client *)conn);
+				}else{
+					this->read_backend((Backend *)conn);
+				}
+			}
+		}
+		this->flush();
+	}
+}
+
+static bool parse_addr(const char *s, std::string *ip, int *port){
+	const char *p = strrchr(s, ':');
+	if(p == NULL || p == s){
+		return false;
+	}
+	ip->assign(s, p - s);
+	*port = atoi(p + 1);
+	return *port > 0;
+}
+
+static void usage(const char *prog){
+	fprintf(stderr, "usage: %s [-l ip:port] [-s ssdb_ip:port] [-t threads] [-c backends]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv){
+	Config conf;
+	conf.listen_ip = "127.0.0.1";
+	conf.listen_port = 6380;
+	conf.ssdb_ip = "127.0.0.1";
+	conf.ssdb_port = 8888;
+	conf.threads = (int)std::thread::hardware_concurrency();
+	conf.backends = 2;
+
+	int opt;
+	while((opt = getopt(argc, argv, "l:s:t:c:")) != -1){
+		switch(opt){
+			case 'l':
+				if(!parse_addr(optarg, &conf.listen_ip, &conf.listen_port)){
+					usage(argv[0]);
+				}
+				break;
+			case 's':
+				if(!parse_addr(optarg, &conf.ssdb_ip, &conf.ssdb_port)){
+					usage(argv[0]);
+				}
+				break;
+			case 't':
+				conf.threads = atoi(optarg);
+				break;
+			case 'c':
+				conf.backends = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if(conf.threads < 1){
+		conf.threads = 1;
+	}
+	if(conf.backends < 1){
+		conf.backends = 1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	Link *listen_link = Link::listen(conf.listen_ip.c_str(), conf.listen_port);
+	if(listen_link == NULL){
+		fprintf(stderr, "error: unable to listen on %s:%d, %s\n",
+			conf.listen_ip.c_str(), conf.listen_port, strerror(errno));
+		return 1;
+	}
+	listen_link->noblock(true);
+	printf("proxy %s:%d -> ssdb %s:%d, %d threads, %d backends each\n",
+		conf.listen_ip.c_str(), conf.listen_port, conf.ssdb_ip.c_str(), conf.ssdb_port,
+		conf.threads, conf.backends);
+
+	std::vector<Worker *> workers;
+	std::vector<std::thread> threads;
+	for(int i=0; i<conf.threads; i++){
+		workers.push_back(new Worker(conf, listen_link));
+	}
+	for(int i=0; i<conf.threads; i++){
+		threads.push_back(std::thread(&Worker::run, workers[i]));
+	}
+	for(int i=0; i<conf.threads; i++){
+		threads[i].join();
+		delete workers[i];
+	}
+	delete listen_link;
+	return 0;
+}
@@ -0,0 +1,614 @@
+/*
+Load generator for SSDB, in the manner of redis-benchmark, driving the
+client library the way an application does.
+
+	g++ -O2 -std=c++11 -I../include ssdb_benchmark.cpp ../include/SSDB_impl.cpp \
+		../include/SSDB_shared.cpp ../include/link.cpp ../include/ssdb_bytes.cpp \
+		../include/buffer_pool.cpp ../include/buffer_policy.cpp -lpthread -o ssdb_benchmark
+	./ssdb_benchmark [-s ip:port] [-c connections] [-P depth] [-t tests]
+		[-n requests | -T seconds] [-r keyspace] [-z theta] [-d bytes] [-j file]
+
+-s  the SSDB server, default 127.0.0.1:8888
+-c  connections, each driven by a thread of its own, default 50
+-P  requests in flight per connection, default 1 sends each request on a
+    Client and waits for it, more pipelines them on a SharedClient
+-t  comma separated tests to run, in order, default all of
+    ping,set,get,incr,hset,hget,zset,zget,zrange,qpush,qpop,multi_set,multi_get
+-n  requests per test, default 100000
+-T  run every test this many seconds instead of a number of requests
+-r  keys chosen from, default 100000
+-z  pick keys by a Zipf distribution of exponent theta, 0 < theta < 1,
+    key 0 the hottest, default 0 picks them uniformly
+-d  value size in bytes, default 32
+-j  write the results as JSON to file, - for stdout
+
+Tests read what earlier tests wrote, run set before get. The latency
+of a request is from when it is handed to the client to when its reply
+is, so with -P it includes the time queued behind others.
+*/
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SSDB_impl.h"
+#include "SSDB_shared.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static int64_t now_ns(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		Clock::now().time_since_epoch()).count();
+}
+
+/*
+Latencies in nanoseconds, as an HDR histogram: values below 128 are
+counted exactly, above that every power of two is split into 64
+buckets, so a value is reported at most 1.6% above what it was.
+*/
+class Histogram{
+	private:
+		const static int SUB_BITS = 7;
+		const static int HALF = 1 << (SUB_BITS - 1);
+		std::vector<int64_t> counts_;
+		int64_t total_;
+		int64_t min_;
+		int64_t max_;
+		double sum_;
+
+		static int index(int64_t v){
+			if(v < 2 * HALF){
+				return (int)v;
+			}
+			int shift = 63 - __builtin_clzll((uint64_t)v) - (SUB_BITS - 1);
+			return 2 * HALF + (shift - 1) * HALF + (int)((v >> shift) - HALF);
+		}
+		// the largest value counted in bucket idx
+		static int64_t value(int idx){
+			if(idx < 2 * HALF){
+				return idx;
+			}
+			int shift = (idx - 2 * HALF) / HALF + 1;
+			int64_t sub = (idx - 2 * HALF) % HALF + HALF;
+			return ((sub + 1) << shift) - 1;
+		}
+	public:
+		Histogram(){
+			counts_.resize(2 * HALF + (64 - SUB_BITS) * HALF);
+			total_ = 0;
+			min_ = INT64_MAX;
+			max_ = 0;
+			sum_ = 0;
+		}
+		void record(int64_t v){
+			if(v < 0){
+				v = 0;
+			}
+			counts_[index(v)] ++;
+			total_ ++;
+			sum_ += v;
+			if(v < min_){
+				min_ = v;
+			}
+			if(v > max_){
+				max_ = v;
+			}
+		}
+		void merge(const Histogram &h){
+			for(int i=0; i<(int)counts_.size(); i++){
+				counts_[i] += h.counts_[i];
+			}
+			total_ += h.total_;
+			sum_ += h.sum_;
+			if(h.min_ < min_){
+				min_ = h.min_;
+			}
+			if(h.max_ > max_){
+				max_ = h.max_;
+			}
+		}
+		int64_t total() const{
+			return total_;
+		}
+		int64_t min() const{
+			return total_? min_ : 0;
+		}
+		int64_t max() const{
+			return max_;
+		}
+		double mean() const{
+			return total_? sum_ / total_ : 0;
+		}
+		int64_t percentile(double p) const{
+			int64_t want = (int64_t)ceil(total_ * p / 100);
+			if(want < 1){
+				want = 1;
+			}
+			int64_t seen = 0;
+			for(int i=0; i<(int)counts_.size(); i++){
+				seen += counts_[i];
+				if(seen >= want){
+					int64_t v = value(i);
+					return v < max_? v : max_;
+				}
+			}
+			return max_;
+		}
+};
+
+/*
+Zipf distributed ranks in [0, n), the method of Gray et al., "Quickly
+Generating Billion-Record Synthetic Databases", as YCSB uses it. Setup
+is O(n), every draw O(1).
+*/
+class Zipf{
+	private:
+		int64_t n_;
+		double alpha_;
+		double zetan_;
+		double eta_;
+		double zeta2_;
+	public:
+		Zipf(int64_t n, double theta){
+			n_ = n;
+			zeta2_ = 1 + pow(0.5, theta);
+			zetan_ = 0;
+			for(int64_t i=1; i<=n; i++){
+				zetan_ += 1 / pow((double)i, theta);
+			}
+			alpha_ = 1 / (1 - theta);
+			eta_ = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2_ / zetan_);
+		}
+		// u uniform in [0, 1)
+		int64_t next(double u) const{
+			double uz = u * zetan_;
+			if(uz < 1){
+				return 0;
+			}
+			if(uz < zeta2_){
+				return 1;
+			}
+			int64_t r = (int64_t)(n_ * pow(eta_ * u - eta_ + 1, alpha_));
+			return r < n_? r : n_ - 1;
+		}
+};
+
+struct Config{
+	std::string ip;
+	int port;
+	int connections;
+	int depth;
+	std::vector<std::string> tests;
+	int64_t requests;
+	int seconds;
+	int64_t keyspace;
+	double theta;
+	int value_size;
+	std::string json;
+};
+
+static Config conf;
+static Zipf *zipf = NULL;
+static std::string value;
+
+static const char *all_tests[] = {
+	"ping", "set", "get", "incr", "hset", "hget", "zset", "zget", "zrange",
+	"qpush", "qpop", "multi_set", "multi_get",
+};
+// keys of a multi_set or multi_get
+const static int MULTI_KEYS = 10;
+
+class Worker{
+	private:
+		ssdb::Client *client;
+		ssdb::SharedClient *shared;
+		std::mt19937_64 rand;
+		std::uniform_real_distribution<double> unit;
+		std::vector<std::string> req;
+		char buf[32];
+
+		const char* key(const char *prefix);
+		void build(const std::string &test);
+		bool claim();
+		void check(const std::vector<std::string> *resp, int64_t start);
+		void run_blocking(const std::string &test);
+		void run_pipelined(const std::string &test);
+	public:
+		std::atomic<int64_t> *remaining;
+		std::atomic<bool> *stop;
+		Histogram hist;
+		int64_t errors;
+		bool broken;
+
+		Worker(int seed);
+		~Worker();
+		bool connect();
+		void run(const std::string &test);
+};
+
+Worker::Worker(int seed) : rand(seed), unit(0, 1){
+	client = NULL;
+	shared = NULL;
+	remaining = NULL;
+	stop = NULL;
+	errors = 0;
+	broken = false;
+}
+
+Worker::~Worker(){
+	delete client;
+}
+
+bool Worker::connect(){
+	if(conf.depth > 1){
+		shared = ssdb::SharedClient::connect(conf.ip, conf.port);
+		if(shared){
+			shared->max_inflight(conf.depth);
+		}
+		client = shared;
+	}else{
+		client = ssdb::Client::connect(conf.ip, conf.port);
+	}
+	return client != NULL;
+}
+
+const char* Worker::key(const char *prefix){
+	int64_t k;
+	if(zipf){
+		k = zipf->next(unit(rand));
+	}else{
+		k = (int64_t)(rand() % (uint64_t)conf.keyspace);
+	}
+	snprintf(buf, sizeof(buf), "%s%012" PRId64, prefix, k);
+	return buf;
+}
+
+void Worker::build(const std::string &test){
+	req.resize(1);
+	req[0] = test;
+	// ping takes no arguments
+	if(test == "set"){
+		req.push_back(key("key:"));
+		req.push_back(value);
+	}else if(test == "get"){
+		req.push_back(key("key:"));
+	}else if(test == "incr"){
+		req.push_back(key("counter:"));
+		req.push_back("1");
+	}else if(test == "hset"){
+		req.push_back("bench:hash");
+		req.push_back(key("field:"));
+		req.push_back(value);
+	}else if(test == "hget"){
+		req.push_back("bench:hash");
+		req.push_back(key("field:"));
+	}else if(test == "zset"){
+		req.push_back("bench:zset");
+		req.push_back(key("member:"));
+		snprintf(buf, sizeof(buf), "%d", (int)(rand() % 1000000));
+		req.push_back(buf);
+	}else if(test == "zget"){
+		req.push_back("bench:zset");
+		req.push_back(key("member:"));
+	}else if(test == "zrange"){
+		req.push_back("bench:zset");
+		snprintf(buf, sizeof(buf), "%d", (int)(rand() % (uint64_t)conf.keyspace));
+		req.push_back(buf);
+		req.push_back("10");
+	}else if(test == "qpush"){
+		req.push_back("bench:queue");
+		req.push_back(value);
+	}else if(test == "qpop"){
+		req.push_back("bench:queue");
+	}else if(test == "multi_set"){
+		for(int i=0; i<MULTI_KEYS; i++){
+			req.push_back(key("key:"));
+			req.push_back(value);
+		}
+	}else if(test == "multi_get"){
+		for(int i=0; i<MULTI_KEYS; i++){
+			req.push_back(key("key:"));
+		}
+	}
+}
+
+bool Worker::claim(){
+	if(broken){
+		return false;
+	}
+	if(conf.seconds > 0){
+		return !stop->load();
+	}
+	return remaining->fetch_sub(1) > 0;
+}
+
+void Worker::check(const std::vector<std::string> *resp, int64_t start){
+	hist.record(now_ns() - start);
+	if(resp == NULL || resp->empty()){
+		errors ++;
+		broken = true;
+		return;
+	}
+	const std::string &code = resp->at(0);
+	if(code != "ok" && code != "not_found"){
+		errors ++;
+	}
+}
+
+void Worker::run_blocking(const std::string &test){
+	while(this->claim()){
+		this->build(test);
+		int64_t start = now_ns();
+		this->check(client->request(req), start);
+	}
+}
+
+// keep conf.depth requests in flight, replies come back in order
+void Worker::run_pipelined(const std::string &test){
+	int depth = conf.depth;
+	std::vector<ssdb::Future> futures(depth);
+	std::vector<int64_t> starts(depth);
+	int head = 0;
+	int inflight = 0;
+	while(1){
+		while(inflight < depth && this->claim()){
+			int slot = (head + inflight) % depth;
+			this->build(test);
+			starts[slot] = now_ns();
+			if(!shared->submit(req, &futures[slot])){
+				this->check(NULL, starts[slot]);
+				break;
+			}
+			inflight ++;
+		}
+		if(inflight == 0){
+			break;
+		}
+		this->check(futures[head].wait(), starts[head]);
+		head = (head + 1) % depth;
+		inflight --;
+	}
+}
+
+void Worker::run(const std::string &test){
+	if(shared){
+		this->run_pipelined(test);
+	}else{
+		this->run_blocking(test);
+	}
+}
+
+struct Result{
+	std::string test;
+	double seconds;
+	int64_t errors;
+	Histogram hist;
+};
+
+static Result run_test(std::vector<Worker *> &workers, const std::string &test){
+	std::atomic<int64_t> remaining(conf.requests);
+	std::atomic<bool> stop(false);
+	for(int i=0; i<(int)workers.size(); i++){
+		workers[i]->hist = Histogram();
+		workers[i]->errors = 0;
+		workers[i]->remaining = &remaining;
+		workers[i]->stop = &stop;
+	}
+
+	int64_t start = now_ns();
+	std::vector<std::thread> threads;
+	for(int i=0; i<(int)workers.size(); i++){
+		if(!workers[i]->broken){
+			threads.push_back(std::thread(&Worker::run, workers[i], test));
+		}
+	}
+	if(conf.seconds > 0){
+		std::this_thread::sleep_for(std::chrono::seconds(conf.seconds));
+		stop.store(true);
+	}
+	for(int i=0; i<(int)threads.size(); i++){
+		threads[i].join();
+	}
+
+	Result res;
+	res.test = test;
+	res.seconds = (now_ns() - start) / 1e9;
+	res.errors = 0;
+	for(int i=0; i<(int)workers.size(); i++){
+		res.hist.merge(workers[i]->hist);
+		res.errors += workers[i]->errors;
+	}
+	return res;
+}
+
+static void print_result(FILE *out, const Result &res){
+	const Histogram &h = res.hist;
+	fprintf(out, "====== %s ======\n", res.test.c_str());
+	fprintf(out, "  %" PRId64 " requests in %.2f seconds, %" PRId64 " errors\n",
+		h.total(), res.seconds, res.errors);
+	fprintf(out, "  %.0f requests per second\n", res.seconds > 0? h.total() / res.seconds : 0);
+	fprintf(out, "  latency us: min %.1f, mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, p99.99 %.1f, max %.1f\n\n",
+		h.min() / 1e3, h.mean() / 1e3, h.percentile(50) / 1e3, h.percentile(90) / 1e3,
+		h.percentile(99) / 1e3, h.percentile(99.9) / 1e3, h.percentile(99.99) / 1e3,
+		h.max() / 1e3);
+}
+
+static bool write_json(const std::vector<Result> &results){
+	FILE *fp = conf.json == "-"? stdout : fopen(conf.json.c_str(), "w");
+	if(fp == NULL){
+		return false;
+	}
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"server\": \"%s:%d\",\n", conf.ip.c_str(), conf.port);
+	fprintf(fp, "  \"connections\": %d,\n", conf.connections);
+	fprintf(fp, "  \"pipeline\": %d,\n", conf.depth);
+	fprintf(fp, "  \"keyspace\": %" PRId64 ",\n", conf.keyspace);
+	fprintf(fp, "  \"distribution\": \"%s\",\n", conf.theta > 0? "zipf" : "uniform");
+	fprintf(fp, "  \"zipf_theta\": %g,\n", conf.theta);
+	fprintf(fp, "  \"value_size\": %d,\n", conf.value_size);
+	fprintf(fp, "  \"tests\": [");
+	for(int i=0; i<(int)results.size(); i++){
+		const Result &res = results[i];
+		const Histogram &h = res.hist;
+		fprintf(fp, "%s\n    {\"test\": \"%s\", \"requests\": %" PRId64 ", \"errors\": %" PRId64 ","
+			" \"seconds\": %.3f, \"rps\": %.1f,\n",
+			i? "," : "", res.test.c_str(), h.total(), res.errors,
+			res.seconds, res.seconds > 0? h.total() / res.seconds : 0);
+		fprintf(fp, "     \"latency_us\": {\"min\": %.1f, \"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f,"
+			" \"p99\": %.1f, \"p99_9\": %.1f, \"p99_99\": %.1f, \"max\": %.1f}}",
+			h.min() / 1e3, h.mean() / 1e3, h.percentile(50) / 1e3, h.percentile(90) / 1e3,
+			h.percentile(99) / 1e3, h.percentile(99.9) / 1e3, h.percentile(99.99) / 1e3,
+			h.max() / 1e3);
+	}
+	fprintf(fp, "\n  ]\n}\n");
+	if(fp != stdout){
+		fclose(fp);
+	}
+	return true;
+}
+
+static bool parse_addr(const char *s, std::string *ip, int *port){
+	const char *p = strrchr(s, ':');
+	if(p == NULL || p == s){
+		return false;
+	}
+	ip->assign(s, p - s);
+	*port = atoi(p + 1);
+	return *port > 0;
+}
+
+static bool parse_tests(const char *s, std::vector<std::string> *tests){
+	tests->clear();
+	std::string list(s);
+	size_t pos = 0;
+	while(pos <= list.size()){
+		size_t end = list.find(',', pos);
+		if(end == std::string::npos){
+			end = list.size();
+		}
+		std::string name = list.substr(pos, end - pos);
+		bool known = false;
+		for(int i=0; i<(int)(sizeof(all_tests)/sizeof(all_tests[0])); i++){
+			if(name == all_tests[i]){
+				known = true;
+			}
+		}
+		if(!known){
+			fprintf(stderr, "error: unknown test '%s'\n", name.c_str());
+			return false;
+		}
+		tests->push_back(name);
+		pos = end + 1;
+	}
+	return true;
+}
+
+static void usage(const char *prog){
+	fprintf(stderr, "usage: %s [-s ip:port] [-c connections] [-P depth] [-t tests]\n"
+		"\t[-n requests | -T seconds] [-r keyspace] [-z theta] [-d bytes] [-j file]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv){
+	conf.ip = "127.0.0.1";
+	conf.port = 8888;
+	conf.connections = 50;
+	conf.depth = 1;
+	conf.tests.assign(all_tests, all_tests + sizeof(all_tests)/sizeof(all_tests[0]));
+	conf.requests = 100000;
+	conf.seconds = 0;
+	conf.keyspace = 100000;
+	conf.theta = 0;
+	conf.value_size = 32;
+
+	int opt;
+	while((opt = getopt(argc, argv, "s:c:P:t:n:T:r:z:d:j:")) != -1){
+		switch(opt){
+			case 's':
+				if(!parse_addr(optarg, &conf.ip, &conf.port)){
+					usage(argv[0]);
+				}
+				break;
+			case 'c':
+				conf.connections = atoi(optarg);
+				break;
+			case 'P':
+				conf.depth = atoi(optarg);
+				break;
+			case 't':
+				if(!parse_tests(optarg, &conf.tests)){
+					usage(argv[0]);
+				}
+				break;
+			case 'n':
+				conf.requests = atoll(optarg);
+				break;
+			case 'T':
+				conf.seconds = atoi(optarg);
+				break;
+			case 'r':
+				conf.keyspace = atoll(optarg);
+				break;
+			case 'z':
+				conf.theta = atof(optarg);
+				break;
+			case 'd':
+				conf.value_size = atoi(optarg);
+				break;
+			case 'j':
+				conf.json = optarg;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if(conf.connections < 1 || conf.depth < 1 || conf.keyspace < 1 || conf.value_size < 0
+		|| conf.theta < 0 || conf.theta >= 1)
+	{
+		usage(argv[0]);
+	}
+	value.assign(conf.value_size, 'x');
+	if(conf.theta > 0){
+		zipf = new Zipf(conf.keyspace, conf.theta);
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	std::vector<Worker *> workers;
+	for(int i=0; i<conf.connections; i++){
+		Worker *worker = new Worker(i + 1);
+		if(!worker->connect()){
+			fprintf(stderr, "error: unable to connect to %s:%d, %s\n",
+				conf.ip.c_str(), conf.port, strerror(errno));
+			delete worker;
+			return 1;
+		}
+		workers.push_back(worker);
+	}
+	// the summary goes to stderr when the JSON takes stdout
+	FILE *out = conf.json == "-"? stderr : stdout;
+
+	std::vector<Result> results;
+	for(int i=0; i<(int)conf.tests.size(); i++){
+		results.push_back(run_test(workers, conf.tests[i]));
+		print_result(out, results.back());
+		fflush(out);
+	}
+	for(int i=0; i<(int)workers.size(); i++){
+		delete workers[i];
+	}
+	delete zipf;
+
+	if(!conf.json.empty() && !write_json(results)){
+		fprintf(stderr, "error: unable to write %s, %s\n", conf.json.c_str(), strerror(errno));
+		return 1;
+	}
+	return 0;
+}
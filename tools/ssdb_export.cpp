@@ -0,0 +1,951 @@
+/*
+Exports the kv pairs, hashes and zsets of an SSDB server into files,
+scanning in parallel over several connections.
+
+	g++ -O2 -std=c++11 -I../include ssdb_export.cpp ../include/SSDB_impl.cpp \
+		../include/link.cpp ../include/ssdb_bytes.cpp ../include/buffer_pool.cpp \
+		../include/buffer_policy.cpp -lpthread -o ssdb_export
+	./ssdb_export [-s ip:port] [-t types] [-f tsv|bin] [-c connections]
+		[-p page] [-b KB] [-m buffers] [-D] prefix
+
+-s  the SSDB server, default 127.0.0.1:8888
+-t  comma separated types to export, default kv,hash,zset, each into a
+    file of its own, prefix.kv.tsv, prefix.hash.tsv, prefix.zset.tsv
+-f  tsv, default, lines in the layout ssdb_load reads
+        kv    key, value
+        hash  name, key, value
+        zset  name, key, score
+    with tab, newline, carriage return and backslash escaped as \t, \n,
+    \r and \\, which ssdb_load -e turns back, or bin, byte exact,
+    "SSDBEXP1" followed by the same fields of every record, each a 32
+    bit little endian length and the bytes, which ssdb_load reads as is
+-c  connections, each scanning from a thread of its own, default 4
+-p  items per scan request, default 1000
+-b  size of a write buffer in KB, default 1024
+-m  write buffers per file, default two per connection, the memory
+    used is bounded by them, scans wait while every buffer is full
+-D  write with O_DIRECT, past the page cache
+
+The kv keyspace is cut into ranges between its first and last key,
+which the connections scan in turn. Hashes and zsets are listed with
+hlist and zlist, and every one is scanned by one connection. Buffers
+are written whole, so a file holds complete records, in no particular
+order but for the records of a hash or zset, which stay together unless
+a buffer fills in between.
+
+Linux only.
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SSDB_impl.h"
+
+const static int DIRECT_ALIGN = 4096;
+// kv ranges per connection, more than one so fast connections take more
+const static int RANGES_PER_CONN = 8;
+
+enum{
+	TYPE_KV,
+	TYPE_HASH,
+	TYPE_ZSET,
+	TYPE_NUM
+};
+
+static const char *type_names[] = {"kv", "hash", "zset"};
+
+struct Config{
+	std::string ip;
+	int port;
+	bool types[TYPE_NUM];
+	bool binary;
+	int connections;
+	int page;
+	int block_size;
+	int blocks;
+	bool direct;
+	std::string prefix;
+};
+
+static Config conf;
+static std::atomic<int64_t> records[TYPE_NUM];
+static std::atomic<int64_t> errors(0);
+
+static char* alloc_aligned(int size){
+	void *p = NULL;
+	if(posix_memalign(&p, DIRECT_ALIGN, size) != 0){
+		return NULL;
+	}
+	return (char *)p;
+}
+
+struct Block{
+	char *data;
+	int size;
+	int cap;
+	// a block of its own for a record larger than the buffers, freed once written
+	bool oversize;
+};
+
+/*
+A file written by a thread of its own. Scanners fill blocks taken from a
+fixed pool and hand them back full, the writer returns them to the pool
+once written, so a scanner waits for a block when the disk falls behind.
+*/
+class Output{
+	private:
+		int fd;
+		bool direct;
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::deque<Block *> full;
+		std::vector<Block *> free_;
+		std::vector<Block *> pool;
+		bool closing;
+		std::thread thread;
+		// O_DIRECT writes whole aligned pages from here
+		char *stage;
+		int stage_size;
+		int stage_cap;
+		std::atomic<int64_t> bytes_;
+		bool failed;
+
+		void run();
+		int write_all(const char *p, int size);
+		int write_direct(const char *p, int size);
+		int finish_direct();
+	public:
+		Output();
+		~Output();
+		int open(const std::string &path);
+		Block* get();
+		void put(Block *block);
+		// write out every block handed back and close the file
+		int close();
+		int64_t bytes() const{
+			return bytes_.load();
+		}
+};
+
+Output::Output() : bytes_(0){
+	fd = -1;
+	direct = false;
+	closing = false;
+	stage = NULL;
+	stage_size = 0;
+	stage_cap = 0;
+	failed = false;
+}
+
+Output::~Output(){
+	for(int i=0; i<(int)pool.size(); i++){
+		free(pool[i]->data);
+		delete pool[i];
+	}
+	free(stage);
+}
+
+int Output::open(const std::string &path){
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+	direct = conf.direct;
+	if(direct){
+		fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+		if(fd == -1 && errno == EINVAL){
+			fprintf(stderr, "warning: %s does not support O_DIRECT, writing through the page cache\n", path.c_str());
+			direct = false;
+		}
+	}
+	if(!direct){
+		fd = ::open(path.c_str(), flags, 0644);
+	}
+	if(fd == -1){
+		return -1;
+	}
+	for(int i=0; i<conf.blocks; i++){
+		Block *block = new Block();
+		block->data = alloc_aligned(conf.block_size);
+		block->size = 0;
+		block->cap = conf.block_size;
+		block->oversize = false;
+		pool.push_back(block);
+		free_.push_back(block);
+	}
+	if(direct){
+		stage_cap = conf.block_size * 2;
+		stage = alloc_aligned(stage_cap);
+	}
+	if(conf.binary){
+		if(direct){
+			memcpy(stage, "SSDBEXP1", 8);
+			stage_size = 8;
+		}else if(this->write_all("SSDBEXP1", 8) == -1){
+			return -1;
+		}
+	}
+	thread = std::thread(&Output::run, this);
+	return 0;
+}
+
+Block* Output::get(){
+	std::unique_lock<std::mutex> lock(mutex);
+	while(free_.empty()){
+		cond.wait(lock);
+	}
+	Block *block = free_.back();
+	free_.pop_back();
+	block->size = 0;
+	return block;
+}
+
+void Output::put(Block *block){
+	std::unique_lock<std::mutex> lock(mutex);
+	full.push_back(block);
+	cond.notify_all();
+}
+
+int Output::write_all(const char *p, int size){
+	while(size > 0){
+		int len = ::write(fd, p, size);
+		if(len == -1){
+			if(errno == EINTR){
+				continue;
+			}
+			return -1;
+		}
+		p += len;
+		size -= len;
+		bytes_ += len;
+	}
+	return 0;
+}
+
+// copy into the stage, writing it out every time it fills
+int Output::write_direct(const char *p, int size){
+	while(size > 0){
+		int len = stage_cap - stage_size < size? stage_cap - stage_size : size;
+		memcpy(stage + stage_size, p, len);
+		stage_size += len;
+		p += len;
+		size -= len;
+		if(stage_size == stage_cap){
+			if(this->write_all(stage, stage_cap) == -1){
+				return -1;
+			}
+			stage_size = 0;
+		}
+	}
+	return 0;
+}
+
+// the whole pages of the stage with O_DIRECT, the tail without
+int Output::finish_direct(){
+	int aligned = stage_size / DIRECT_ALIGN * DIRECT_ALIGN;
+	if(aligned > 0 && this->write_all(stage, aligned) == -1){
+		return -1;
+	}
+	if(stage_size > aligned){
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+		if(this->write_all(stage + aligned, stage_size - aligned) == -1){
+			return -1;
+		}
+	}
+	stage_size = 0;
+	return 0;
+}
+
+void Output::run(){
+	std::unique_lock<std::mutex> lock(mutex);
+	while(1){
+		while(full.empty() && !closing){
+			cond.wait(lock);
+		}
+		if(full.empty()){
+			break;
+		}
+		Block *block = full.front();
+		full.pop_front();
+		lock.unlock();
+		if(!failed){
+			int ret = direct? this->write_direct(block->data, block->size)
+				: this->write_all(block->data, block->size);
+			if(ret == -1){
+				fprintf(stderr, "error: write failed, %s\n", strerror(errno));
+				failed = true;
+				errors ++;
+			}
+		}
+		lock.lock();
+		if(block->oversize){
+			free(block->data);
+			delete block;
+		}else{
+			free_.push_back(block);
+			cond.notify_all();
+		}
+	}
+}
+
+int Output::close(){
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		closing = true;
+		cond.notify_all();
+	}
+	thread.join();
+	if(direct && !failed && this->finish_direct() == -1){
+		fprintf(stderr, "error: write failed, %s\n", strerror(errno));
+		failed = true;
+		errors ++;
+	}
+	if(::close(fd) == -1 || failed){
+		return -1;
+	}
+	return 0;
+}
+
+/*
+Encodes the records of one scanner into blocks of an Output.
+*/
+class Writer{
+	private:
+		Output *out;
+		Block *block;
+
+		static int escaped_size(const Bytes &s);
+		static char* put_escaped(char *p, const Bytes &s);
+		Block* room(int size);
+	public:
+		Writer(Output *out){
+			this->out = out;
+			this->block = NULL;
+		}
+		void record(const Bytes *fields, int num);
+		// hand the current block to the output
+		void flush();
+};
+
+int Writer::escaped_size(const Bytes &s){
+	int size = s.size();
+	for(int i=0; i<s.size(); i++){
+		char c = s.data()[i];
+		if(c == '\t' || c == '\n' || c == '\r' || c == '\\'){
+			size ++;
+		}
+	}
+	return size;
+}
+
+char* Writer::put_escaped(char *p, const Bytes &s){
+	for(int i=0; i<s.size(); i++){
+		char c = s.data()[i];
+		switch(c){
+			case '\t':
+				*p++ = '\\';
+				*p++ = 't';
+				break;
+			case '\n':
+				*p++ = '\\';
+				*p++ = 'n';
+				break;
+			case '\r':
+				*p++ = '\\';
+				*p++ = 'r';
+				break;
+			case '\\':
+				*p++ = '\\';
+				*p++ = '\\';
+				break;
+			default:
+				*p++ = c;
+		}
+	}
+	return p;
+}
+
+// a block with size bytes free
+Block* Writer::room(int size){
+	if(block && block->cap - block->size >= size){
+		return block;
+	}
+	this->flush();
+	if(size > conf.block_size){
+		block = new Block();
+		block->data = (char *)malloc(size);
+		block->size = 0;
+		block->cap = size;
+		block->oversize = true;
+	}else{
+		block = out->get();
+	}
+	return block;
+}
+
+void Writer::record(const Bytes *fields, int num){
+	int size = 0;
+	for(int i=0; i<num; i++){
+		size += conf.binary? 4 + fields[i].size() : escaped_size(fields[i]) + 1;
+	}
+	Block *b = this->room(size);
+	char *p = b->data + b->size;
+	for(int i=0; i<num; i++){
+		if(conf.binary){
+			uint32_t len = (uint32_t)fields[i].size();
+			p[0] = (char)len;
+			p[1] = (char)(len >> 8);
+			p[2] = (char)(len >> 16);
+			p[3] = (char)(len >> 24);
+			memcpy(p + 4, fields[i].data(), fields[i].size());
+			p += 4 + fields[i].size();
+		}else{
+			p = put_escaped(p, fields[i]);
+			*p++ = (i == num - 1)? '\n' : '\t';
+		}
+	}
+	b->size += size;
+}
+
+void Writer::flush(){
+	if(block){
+		out->put(block);
+		block = NULL;
+	}
+}
+
+struct Task{
+	int type;
+	// the name of a hash or zset, the first key after a kv range
+	std::string name;
+	// the last key of a kv range, empty for the end of the keyspace
+	std::string end;
+};
+
+// tasks listed by the producer, bounded so listing waits for the scans
+class TaskQueue{
+	private:
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::deque<Task> tasks;
+		bool done;
+		bool aborted;
+		const static int MAX_TASKS = 1024;
+	public:
+		TaskQueue(){
+			done = false;
+			aborted = false;
+		}
+		bool push(const Task &task){
+			std::unique_lock<std::mutex> lock(mutex);
+			while((int)tasks.size() >= MAX_TASKS && !aborted){
+				cond.wait(lock);
+			}
+			if(aborted){
+				return false;
+			}
+			tasks.push_back(task);
+			cond.notify_all();
+			return true;
+		}
+		bool pop(Task *task){
+			std::unique_lock<std::mutex> lock(mutex);
+			while(tasks.empty() && !done && !aborted){
+				cond.wait(lock);
+			}
+			if(tasks.empty() || aborted){
+				return false;
+			}
+			*task = tasks.front();
+			tasks.pop_front();
+			cond.notify_all();
+			return true;
+		}
+		// no more tasks will be pushed
+		void finish(){
+			std::unique_lock<std::mutex> lock(mutex);
+			done = true;
+			cond.notify_all();
+		}
+		// stop everything, after an error
+		void abort(){
+			std::unique_lock<std::mutex> lock(mutex);
+			aborted = true;
+			cond.notify_all();
+		}
+};
+
+static Output outputs[TYPE_NUM];
+static TaskQueue queue;
+
+/*
+Records of a scan reply, its items in pairs, with the name of the hash
+or zset prepended for those.
+*/
+class PairHandler : public ssdb::ReplyHandler{
+	private:
+		Writer *writer;
+		std::string name;
+		int index;
+	public:
+		int pairs;
+		// the last pair, where the next page starts
+		std::string key;
+		std::string val;
+
+		PairHandler(Writer *writer, const std::string &name){
+			this->writer = writer;
+			this->name = name;
+			this->index = 0;
+			this->pairs = 0;
+		}
+		void reset(){
+			index = 0;
+			pairs = 0;
+		}
+		virtual int item(const char *data, int size){
+			if(index++ % 2 == 0){
+				key.assign(data, size);
+				return 0;
+			}
+			if(name.empty()){
+				Bytes fields[] = {Bytes(key), Bytes(data, size)};
+				writer->record(fields, 2);
+			}else{
+				Bytes fields[] = {Bytes(name), Bytes(key), Bytes(data, size)};
+				writer->record(fields, 3);
+			}
+			val.assign(data, size);
+			pairs ++;
+			return 0;
+		}
+};
+
+class Scanner{
+	private:
+		ssdb::Client *client;
+		Writer *writers[TYPE_NUM];
+
+		bool scan_kv(const Task &task);
+		bool scan_hash(const Task &task);
+		bool scan_zset(const Task &task);
+		bool page(const std::vector<std::string> &req, PairHandler *handler);
+	public:
+		Scanner(ssdb::Client *client);
+		~Scanner();
+		void run();
+};
+
+Scanner::Scanner(ssdb::Client *client){
+	this->client = client;
+	for(int i=0; i<TYPE_NUM; i++){
+		writers[i] = new Writer(&outputs[i]);
+	}
+}
+
+Scanner::~Scanner(){
+	for(int i=0; i<TYPE_NUM; i++){
+		delete writers[i];
+	}
+	delete client;
+}
+
+bool Scanner::page(const std::vector<std::string> &req, PairHandler *handler){
+	handler->reset();
+	ssdb::Status s = client->request_stream(req, handler);
+	if(!s.ok()){
+		fprintf(stderr, "error: %s %s, %s\n", req[0].c_str(), req[1].c_str(), s.code().c_str());
+		return false;
+	}
+	return true;
+}
+
+bool Scanner::scan_kv(const Task &task){
+	PairHandler handler(writers[TYPE_KV], "");
+	std::vector<std::string> req;
+	req.push_back("scan");
+	req.push_back(task.name);
+	req.push_back(task.end);
+	req.push_back(str(conf.page));
+	while(1){
+		if(!this->page(req, &handler)){
+			return false;
+		}
+		records[TYPE_KV] += handler.pairs;
+		if(handler.pairs < conf.page){
+			return true;
+		}
+		req[1] = handler.key;
+	}
+}
+
+bool Scanner::scan_hash(const Task &task){
+	PairHandler handler(writers[TYPE_HASH], task.name);
+	std::vector<std::string> req;
+	req.push_back("hscan");
+	req.push_back(task.name);
+	req.push_back("");
+	req.push_back("");
+	req.push_back(str(conf.page));
+	while(1){
+		if(!this->page(req, &handler)){
+			return false;
+		}
+		records[TYPE_HASH] += handler.pairs;
+		if(handler.pairs < conf.page){
+			return true;
+		}
+		req[2] = handler.key;
+	}
+}
+
+bool Scanner::scan_zset(const Task &task){
+	PairHandler handler(writers[TYPE_ZSET], task.name);
+	std::vector<std::string> req;
+	req.push_back("zscan");
+	req.push_back(task.name);
+	req.push_back("");
+	req.push_back("");
+	req.push_back("");
+	req.push_back(str(conf.page));
+	while(1){
+		if(!this->page(req, &handler)){
+			return false;
+		}
+		records[TYPE_ZSET] += handler.pairs;
+		if(handler.pairs < conf.page){
+			return true;
+		}
+		// members after the last one, by score then key
+		req[2] = handler.key;
+		req[3] = handler.val;
+	}
+}
+
+void Scanner::run(){
+	Task task;
+	while(queue.pop(&task)){
+		bool ok;
+		if(task.type == TYPE_KV){
+			ok = this->scan_kv(task);
+		}else if(task.type == TYPE_HASH){
+			ok = this->scan_hash(task);
+		}else{
+			ok = this->scan_zset(task);
+		}
+		if(!ok){
+			errors ++;
+			queue.abort();
+			break;
+		}
+	}
+	for(int i=0; i<TYPE_NUM; i++){
+		writers[i]->flush();
+	}
+}
+
+// the 8 bytes of key after its first from bytes, as a big endian number
+static uint64_t key_bits(const std::string &key, size_t from){
+	uint64_t v = 0;
+	for(size_t i=from; i<from+8; i++){
+		v = (v << 8) | (i < key.size()? (uint8_t)key[i] : 0);
+	}
+	return v;
+}
+
+/*
+Boundaries cutting the keys from first to last into about parts ranges,
+evenly spaced in the 8 bytes following the prefix they share.
+*/
+static std::vector<std::string> split_keys(const std::string &first, const std::string &last, int parts){
+	std::vector<std::string> bounds;
+	size_t common = 0;
+	while(common < first.size() && common < last.size() && first[common] == last[common]){
+		common ++;
+	}
+	uint64_t lo = key_bits(first, common);
+	uint64_t hi = key_bits(last, common);
+	uint64_t step = (hi - lo) / parts;
+	if(hi <= lo || step == 0){
+		return bounds;
+	}
+	for(int i=1; i<parts; i++){
+		uint64_t v = lo + step * i;
+		std::string bound = first.substr(0, common);
+		for(int j=7; j>=0; j--){
+			bound.push_back((char)(v >> (j * 8)));
+		}
+		if(bound > first && bound < last && (bounds.empty() || bound > bounds.back())){
+			bounds.push_back(bound);
+		}
+	}
+	return bounds;
+}
+
+// the first key of the keyspace by cmd, scan, or the last by rscan
+static bool end_key(ssdb::Client *client, const char *cmd, std::string *key){
+	std::vector<std::string> ret;
+	ssdb::Status s;
+	if(strcmp(cmd, "scan") == 0){
+		s = client->scan("", "", 1, &ret);
+	}else{
+		s = client->rscan("", "", 1, &ret);
+	}
+	if(!s.ok()){
+		return false;
+	}
+	key->assign(ret.empty()? "" : ret[0]);
+	return true;
+}
+
+// list every name of cmd, hlist or zlist, into tasks
+static bool list_names(ssdb::Client *client, const char *cmd, int type){
+	std::vector<std::string> req;
+	req.push_back(cmd);
+	req.push_back("");
+	req.push_back("");
+	req.push_back(str(conf.page));
+	while(1){
+		const std::vector<std::string> *resp = client->request(req);
+		if(resp == NULL || resp->empty() || resp->at(0) != "ok"){
+			fprintf(stderr, "error: %s failed, %s\n", cmd, resp && !resp->empty()? resp->at(0).c_str() : "no response");
+			return false;
+		}
+		int num = (int)resp->size() - 1;
+		Task task;
+		task.type = type;
+		for(int i=1; i<=num; i++){
+			task.name = resp->at(i);
+			if(!queue.push(task)){
+				return false;
+			}
+		}
+		if(num < conf.page){
+			return true;
+		}
+		req[1] = task.name;
+	}
+}
+
+static void produce(ssdb::Client *client){
+	bool ok = true;
+	if(conf.types[TYPE_KV]){
+		std::string first, last;
+		ok = end_key(client, "scan", &first) && end_key(client, "rscan", &last);
+		if(ok){
+			std::vector<std::string> bounds = split_keys(first, last, conf.connections * RANGES_PER_CONN);
+			Task task;
+			task.type = TYPE_KV;
+			for(int i=0; ok && i<=(int)bounds.size(); i++){
+				task.name = i == 0? "" : bounds[i - 1];
+				task.end = i == (int)bounds.size()? "" : bounds[i];
+				ok = queue.push(task);
+			}
+		}else{
+			fprintf(stderr, "error: unable to find the first and last keys\n");
+		}
+	}
+	if(ok && conf.types[TYPE_HASH]){
+		ok = list_names(client, "hlist", TYPE_HASH);
+	}
+	if(ok && conf.types[TYPE_ZSET]){
+		ok = list_names(client, "zlist", TYPE_ZSET);
+	}
+	if(!ok){
+		errors ++;
+		queue.abort();
+	}
+	queue.finish();
+}
+
+static bool parse_addr(const char *s, std::string *ip, int *port){
+	const char *p = strrchr(s, ':');
+	if(p == NULL || p == s){
+		return false;
+	}
+	ip->assign(s, p - s);
+	*port = atoi(p + 1);
+	return *port > 0;
+}
+
+static bool parse_types(const char *s){
+	for(int i=0; i<TYPE_NUM; i++){
+		conf.types[i] = false;
+	}
+	std::string list(s);
+	size_t pos = 0;
+	while(pos <= list.size()){
+		size_t end = list.find(',', pos);
+		if(end == std::string::npos){
+			end = list.size();
+		}
+		std::string name = list.substr(pos, end - pos);
+		int type = -1;
+		for(int i=0; i<TYPE_NUM; i++){
+			if(name == type_names[i]){
+				type = i;
+			}
+		}
+		if(type == -1){
+			fprintf(stderr, "error: unknown type '%s'\n", name.c_str());
+			return false;
+		}
+		conf.types[type] = true;
+		pos = end + 1;
+	}
+	return true;
+}
+
+static void usage(const char *prog){
+	fprintf(stderr, "usage: %s [-s ip:port] [-t types] [-f tsv|bin] [-c connections]\n"
+		"\t[-p page] [-b KB] [-m buffers] [-D] prefix\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv){
+	conf.ip = "127.0.0.1";
+	conf.port = 8888;
+	for(int i=0; i<TYPE_NUM; i++){
+		conf.types[i] = true;
+		records[i] = 0;
+	}
+	conf.binary = false;
+	conf.connections = 4;
+	conf.page = 1000;
+	conf.block_size = 1024 * 1024;
+	conf.blocks = 0;
+	conf.direct = false;
+
+	int opt;
+	while((opt = getopt(argc, argv, "s:t:f:c:p:b:m:D")) != -1){
+		switch(opt){
+			case 's':
+				if(!parse_addr(optarg, &conf.ip, &conf.port)){
+					usage(argv[0]);
+				}
+				break;
+			case 't':
+				if(!parse_types(optarg)){
+					usage(argv[0]);
+				}
+				break;
+			case 'f':
+				if(strcmp(optarg, "tsv") == 0){
+					conf.binary = false;
+				}else if(strcmp(optarg, "bin") == 0){
+					conf.binary = true;
+				}else{
+					usage(argv[0]);
+				}
+				break;
+			case 'c':
+				conf.connections = atoi(optarg);
+				break;
+			case 'p':
+				conf.page = atoi(optarg);
+				break;
+			case 'b':
+				conf.block_size = atoi(optarg) * 1024;
+				break;
+			case 'm':
+				conf.blocks = atoi(optarg);
+				break;
+			case 'D':
+				conf.direct = true;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if(optind != argc - 1 || conf.connections < 1 || conf.page < 1 || conf.block_size < DIRECT_ALIGN){
+		usage(argv[0]);
+	}
+	conf.prefix = argv[optind];
+	// whole pages, for O_DIRECT
+	conf.block_size = conf.block_size / DIRECT_ALIGN * DIRECT_ALIGN;
+	if(conf.blocks < 1){
+		conf.blocks = conf.connections * 2;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	ssdb::Client *lister = ssdb::Client::connect(conf.ip, conf.port);
+	std::vector<Scanner *> scanners;
+	for(int i=0; lister && i<conf.connections; i++){
+		ssdb::Client *client = ssdb::Client::connect(conf.ip, conf.port);
+		if(client == NULL){
+			break;
+		}
+		scanners.push_back(new Scanner(client));
+	}
+	if(lister == NULL || (int)scanners.size() < conf.connections){
+		fprintf(stderr, "error: unable to connect to %s:%d, %s\n",
+			conf.ip.c_str(), conf.port, strerror(errno));
+		return 1;
+	}
+	for(int i=0; i<TYPE_NUM; i++){
+		if(!conf.types[i]){
+			continue;
+		}
+		std::string path = conf.prefix + "." + type_names[i] + (conf.binary? ".bin" : ".tsv");
+		if(outputs[i].open(path) == -1){
+			fprintf(stderr, "error: unable to write %s, %s\n", path.c_str(), strerror(errno));
+			return 1;
+		}
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	std::atomic<int> running(conf.connections);
+	std::thread producer(produce, lister);
+	std::vector<std::thread> threads;
+	for(int i=0; i<conf.connections; i++){
+		threads.push_back(std::thread([&running](Scanner *scanner){
+			scanner->run();
+			running --;
+		}, scanners[i]));
+	}
+	// progress, once a second
+	while(running.load() > 0){
+		for(int i=0; i<10 && running.load() > 0; i++){
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+		double seconds = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count() / 1e3;
+		int64_t total = records[TYPE_KV] + records[TYPE_HASH] + records[TYPE_ZSET];
+		int64_t bytes = outputs[TYPE_KV].bytes() + outputs[TYPE_HASH].bytes() + outputs[TYPE_ZSET].bytes();
+		fprintf(stderr, "\r%" PRId64 " records, %.0f records/s, %.1f MB written   ",
+			total, seconds > 0? total / seconds : 0, bytes / 1024.0 / 1024);
+	}
+	producer.join();
+	for(int i=0; i<conf.connections; i++){
+		threads[i].join();
+		delete scanners[i];
+	}
+	delete lister;
+	for(int i=0; i<TYPE_NUM; i++){
+		if(conf.types[i] && outputs[i].close() == -1){
+			errors ++;
+		}
+	}
+	double seconds = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count() / 1e3;
+
+	fprintf(stderr, "\n");
+	int64_t total = 0;
+	for(int i=0; i<TYPE_NUM; i++){
+		if(conf.types[i]){
+			printf("%-5s %12" PRId64 " records, %10.1f MB\n", type_names[i], records[i].load(),
+				outputs[i].bytes() / 1024.0 / 1024);
+			total += records[i];
+		}
+	}
+	printf("%" PRId64 " records in %.2f seconds, %.0f records/s, %" PRId64 " errors\n",
+		total, seconds, seconds > 0? total / seconds : 0, errors.load());
+	return errors.load()? 1 : 0;
+}
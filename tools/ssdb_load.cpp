@@ -0,0 +1,561 @@
+/*
+Bulk loads TSV or CSV dumps into SSDB, with multi_set, multi_hset or
+multi_zset batches pipelined over several connections.
+
+	g++ -O2 -std=c++11 -I../include ssdb_load.cpp ../include/link.cpp \
+		../include/ssdb_bytes.cpp ../include/buffer_pool.cpp ../include/buffer_policy.cpp \
+		-lpthread -o ssdb_load
+	./ssdb_load [-s ip:port] [-t kv|hash|zset] [-F sep] [-H] [-e] [-b records]
+		[-c connections] [-P depth] file
+
+-s  the SSDB server, default 127.0.0.1:8888
+-t  what a line holds, default kv
+        kv    key, value
+        hash  name, key, value
+        zset  name, key, score
+-F  the field separator, default tab, with , fields may be double quoted
+-H  the first line is a header, skip it
+-e  fields are escaped as ssdb_export writes them, turn \t, \n, \r and
+    \\ back into the bytes
+-b  records per request, default 1000
+-c  connections, each parsing and sending from a thread of its own,
+    default 4
+-P  requests in flight per connection, default 4
+
+The file is mapped into memory and cut into chunks at line ends, which
+the connections take in turn, so it is parsed in parallel and nothing is
+copied on the way to the socket but the request. The last field of a
+line is the rest of the line, a TSV value may hold tabs. Lines are cut
+before quotes are parsed, so a quoted CSV field can't hold a newline.
+Records of a hash or zset are batched while they belong to the same
+name, so the dump should be grouped by name, as exports are. Lines with
+too few fields are skipped and counted.
+
+A binary export of ssdb_export, a file starting with "SSDBEXP1", is
+loaded byte exact, -t still telling what its records hold. It is walked
+once to cut the chunks at record starts, and refused if truncated.
+
+Linux only, it needs mmap.
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include "link.h"
+
+const static int64_t CHUNK_SIZE = 4 * 1024 * 1024;
+static const char EXPORT_MAGIC[] = "SSDBEXP1";
+
+enum{
+	TYPE_KV,
+	TYPE_HASH,
+	TYPE_ZSET
+};
+
+struct Config{
+	std::string ip;
+	int port;
+	int type;
+	char sep;
+	bool header;
+	bool unescape;
+	// the input is a binary export
+	bool binary;
+	int batch;
+	int connections;
+	int depth;
+};
+
+static Config conf;
+static const char *input = NULL;
+static int64_t input_size = 0;
+// offsets the chunks of the input start at, and its end
+static std::vector<int64_t> chunks;
+
+static std::atomic<int64_t> next_chunk(0);
+static std::atomic<int64_t> bytes_done(0);
+static std::atomic<int64_t> records(0);
+static std::atomic<int64_t> bad_lines(0);
+static std::atomic<int64_t> errors(0);
+static std::atomic<int> running(0);
+
+// where the lines of the chunk starting at offset begin
+static const char* line_start(int64_t offset){
+	if(offset <= 0){
+		return input;
+	}
+	if(offset >= input_size){
+		return input + input_size;
+	}
+	const char *p = (const char *)memchr(input + offset - 1, '\n', input_size - offset + 1);
+	return p? p + 1 : input + input_size;
+}
+
+class Loader{
+	private:
+		Link *link;
+		std::vector<Bytes> req;
+		// fields unquoted out of place, until the request is sent
+		std::deque<std::string> unquoted;
+		int count;
+		int inflight;
+		bool failed;
+
+		int parse_field(const char **p, const char *end, bool last, Bytes *field);
+		int split(const char *p, const char *end, Bytes *fields, int num);
+		void unescape(Bytes *field);
+		void load_binary(const char *p, const char *end);
+		void add(const Bytes *fields, int strings);
+		void send_batch(int keep);
+		void wait_one();
+	public:
+		Loader(Link *link);
+		~Loader();
+		void load(const char *p, const char *end);
+		// send what is batched and wait for every response
+		void finish();
+		void run();
+};
+
+Loader::Loader(Link *link){
+	this->link = link;
+	count = 0;
+	inflight = 0;
+	failed = false;
+}
+
+Loader::~Loader(){
+	delete link;
+}
+
+// a field at *p, moving *p past its separator
+int Loader::parse_field(const char **p, const char *end, bool last, Bytes *field){
+	const char *s = *p;
+	if(conf.sep == ',' && s < end && *s == '"'){
+		// "" stands for a quote inside a quoted field
+		std::string *out = NULL;
+		const char *begin = ++s;
+		while(1){
+			const char *q = (const char *)memchr(s, '"', end - s);
+			if(q == NULL){
+				return -1;
+			}
+			if(q + 1 < end && q[1] == '"'){
+				if(out == NULL){
+					unquoted.push_back(std::string());
+					out = &unquoted.back();
+				}
+				out->append(s, q + 1 - s);
+				s = q + 2;
+				continue;
+			}
+			if(out){
+				out->append(s, q - s);
+				*field = Bytes(*out);
+			}else{
+				*field = Bytes(begin, (int)(q - begin));
+			}
+			s = q + 1;
+			break;
+		}
+		if(s < end && *s != conf.sep){
+			return -1;
+		}
+		*p = s < end? s + 1 : end;
+		return 0;
+	}
+	if(last){
+		*field = Bytes(s, (int)(end - s));
+		*p = end;
+		return 0;
+	}
+	const char *q = (const char *)memchr(s, conf.sep, end - s);
+	if(q == NULL){
+		return -1;
+	}
+	*field = Bytes(s, (int)(q - s));
+	*p = q + 1;
+	return 0;
+}
+
+int Loader::split(const char *p, const char *end, Bytes *fields, int num){
+	for(int i=0; i<num; i++){
+		if(this->parse_field(&p, end, i == num - 1, &fields[i]) == -1){
+			return -1;
+		}
+		if(conf.unescape){
+			this->unescape(&fields[i]);
+		}
+	}
+	return 0;
+}
+
+// undo the escapes of ssdb_export, out of place if there are any
+void Loader::unescape(Bytes *field){
+	const char *s = field->data();
+	int size = field->size();
+	if(memchr(s, '\\', size) == NULL){
+		return;
+	}
+	unquoted.push_back(std::string());
+	std::string *out = &unquoted.back();
+	out->reserve(size);
+	for(int i=0; i<size; i++){
+		if(s[i] != '\\' || i == size - 1){
+			out->push_back(s[i]);
+			continue;
+		}
+		char c = s[++i];
+		switch(c){
+			case 't':
+				out->push_back('\t');
+				break;
+			case 'n':
+				out->push_back('\n');
+				break;
+			case 'r':
+				out->push_back('\r');
+				break;
+			case '\\':
+				out->push_back('\\');
+				break;
+			default:
+				out->push_back('\\');
+				out->push_back(c);
+		}
+	}
+	*field = Bytes(*out);
+}
+
+// strings, the number of unquoted strings the fields of this record point into
+void Loader::add(const Bytes *fields, int strings){
+	if(conf.type == TYPE_KV){
+		if(req.empty()){
+			req.push_back(Bytes("multi_set"));
+		}
+		req.push_back(fields[0]);
+		req.push_back(fields[1]);
+	}else{
+		// a batch holds the records of one name
+		if(!req.empty() && req[1] != fields[0]){
+			this->send_batch(strings);
+		}
+		if(req.empty()){
+			req.push_back(Bytes(conf.type == TYPE_HASH? "multi_hset" : "multi_zset"));
+			req.push_back(fields[0]);
+		}
+		req.push_back(fields[1]);
+		req.push_back(fields[2]);
+	}
+	if(++count >= conf.batch){
+		this->send_batch(0);
+	}
+}
+
+// keep, the number of unquoted strings at the back that are not in the batch
+void Loader::send_batch(int keep){
+	if(req.empty() || failed){
+		return;
+	}
+	link->send(req);
+	if(link->flush() == -1){
+		fprintf(stderr, "error: send to %s:%d failed, %s\n", conf.ip.c_str(), conf.port, strerror(errno));
+		failed = true;
+		return;
+	}
+	records += count;
+	req.clear();
+	// erasing at the front leaves the strings kept where they are
+	unquoted.erase(unquoted.begin(), unquoted.end() - keep);
+	count = 0;
+	inflight ++;
+	if(inflight >= conf.depth){
+		this->wait_one();
+	}
+}
+
+void Loader::wait_one(){
+	const std::vector<Bytes> *resp = link->response();
+	inflight --;
+	if(resp == NULL || resp->empty()){
+		fprintf(stderr, "error: no response from %s:%d\n", conf.ip.c_str(), conf.port);
+		failed = true;
+		return;
+	}
+	if(resp->at(0) != "ok"){
+		// report the first failure
+		if(errors++ == 0){
+			std::string msg = resp->at(0).String();
+			if(resp->size() > 1){
+				msg += " " + resp->at(1).String();
+			}
+			fprintf(stderr, "error: %s\n", msg.c_str());
+		}
+	}
+}
+
+void Loader::load(const char *p, const char *end){
+	if(conf.binary){
+		this->load_binary(p, end);
+		return;
+	}
+	int num = conf.type == TYPE_KV? 2 : 3;
+	Bytes fields[3];
+	while(p < end && !failed){
+		const char *eol = (const char *)memchr(p, '\n', end - p);
+		const char *next = eol? eol + 1 : end;
+		if(eol == NULL){
+			eol = end;
+		}
+		if(eol > p && eol[-1] == '\r'){
+			eol --;
+		}
+		if(eol > p){
+			int strings = (int)unquoted.size();
+			if(this->split(p, eol, fields, num) == 0){
+				this->add(fields, (int)unquoted.size() - strings);
+			}else{
+				bad_lines ++;
+			}
+		}
+		p = next;
+	}
+}
+
+// records of a binary export, the chunk was checked when it was cut
+void Loader::load_binary(const char *p, const char *end){
+	int num = conf.type == TYPE_KV? 2 : 3;
+	Bytes fields[3];
+	while(p < end && !failed){
+		for(int i=0; i<num; i++){
+			uint32_t len = (uint8_t)p[0] | (uint8_t)p[1] << 8 | (uint8_t)p[2] << 16 | (uint32_t)(uint8_t)p[3] << 24;
+			fields[i] = Bytes(p + 4, (int)len);
+			p += 4 + len;
+		}
+		this->add(fields, 0);
+	}
+}
+
+void Loader::finish(){
+	this->send_batch(0);
+	while(inflight > 0 && !failed){
+		this->wait_one();
+	}
+}
+
+void Loader::run(){
+	int64_t chunk;
+	while(!failed && (chunk = next_chunk++) < (int64_t)chunks.size() - 1){
+		this->load(input + chunks[chunk], input + chunks[chunk + 1]);
+		bytes_done += chunks[chunk + 1] - chunks[chunk];
+	}
+	this->finish();
+	if(failed){
+		errors ++;
+	}
+	running --;
+}
+
+// chunks of a text input, at the line ends after every CHUNK_SIZE
+static void text_chunks(){
+	int64_t offset = conf.header? line_start(1) - input : 0;
+	chunks.push_back(offset);
+	while(offset < input_size){
+		int64_t next = line_start(offset + CHUNK_SIZE) - input;
+		chunks.push_back(next);
+		offset = next;
+	}
+}
+
+// chunks of a binary export, at the record starts after every CHUNK_SIZE,
+// -1 if a record runs past the end of the file
+static int binary_chunks(){
+	int num = conf.type == TYPE_KV? 2 : 3;
+	int64_t offset = 8;
+	int64_t next = offset + CHUNK_SIZE;
+	chunks.push_back(offset);
+	while(offset < input_size){
+		if(offset >= next){
+			chunks.push_back(offset);
+			next = offset + CHUNK_SIZE;
+		}
+		for(int i=0; i<num; i++){
+			if(input_size - offset < 4){
+				return -1;
+			}
+			const char *p = input + offset;
+			uint32_t len = (uint8_t)p[0] | (uint8_t)p[1] << 8 | (uint8_t)p[2] << 16 | (uint32_t)(uint8_t)p[3] << 24;
+			offset += 4;
+			if(len > input_size - offset){
+				return -1;
+			}
+			offset += len;
+		}
+	}
+	chunks.push_back(input_size);
+	return 0;
+}
+
+static bool parse_addr(const char *s, std::string *ip, int *port){
+	const char *p = strrchr(s, ':');
+	if(p == NULL || p == s){
+		return false;
+	}
+	ip->assign(s, p - s);
+	*port = atoi(p + 1);
+	return *port > 0;
+}
+
+static void usage(const char *prog){
+	fprintf(stderr, "usage: %s [-s ip:port] [-t kv|hash|zset] [-F sep] [-H] [-e] [-b records]\n"
+		"\t[-c connections] [-P depth] file\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv){
+	conf.ip = "127.0.0.1";
+	conf.port = 8888;
+	conf.type = TYPE_KV;
+	conf.sep = '\t';
+	conf.header = false;
+	conf.unescape = false;
+	conf.binary = false;
+	conf.batch = 1000;
+	conf.connections = 4;
+	conf.depth = 4;
+
+	int opt;
+	while((opt = getopt(argc, argv, "s:t:F:Heb:c:P:")) != -1){
+		switch(opt){
+			case 's':
+				if(!parse_addr(optarg, &conf.ip, &conf.port)){
+					usage(argv[0]);
+				}
+				break;
+			case 't':
+				if(strcmp(optarg, "kv") == 0){
+					conf.type = TYPE_KV;
+				}else if(strcmp(optarg, "hash") == 0){
+					conf.type = TYPE_HASH;
+				}else if(strcmp(optarg, "zset") == 0){
+					conf.type = TYPE_ZSET;
+				}else{
+					usage(argv[0]);
+				}
+				break;
+			case 'F':
+				if(strcmp(optarg, "\\t") == 0){
+					conf.sep = '\t';
+				}else if(strlen(optarg) == 1){
+					conf.sep = optarg[0];
+				}else{
+					usage(argv[0]);
+				}
+				break;
+			case 'H':
+				conf.header = true;
+				break;
+			case 'e':
+				conf.unescape = true;
+				break;
+			case 'b':
+				conf.batch = atoi(optarg);
+				break;
+			case 'c':
+				conf.connections = atoi(optarg);
+				break;
+			case 'P':
+				conf.depth = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if(optind != argc - 1 || conf.batch < 1 || conf.connections < 1 || conf.depth < 1){
+		usage(argv[0]);
+	}
+
+	const char *path = argv[optind];
+	int fd = ::open(path, O_RDONLY);
+	struct stat st;
+	if(fd == -1 || fstat(fd, &st) == -1){
+		fprintf(stderr, "error: unable to open %s, %s\n", path, strerror(errno));
+		return 1;
+	}
+	input_size = st.st_size;
+	if(input_size > 0){
+		void *addr = mmap(NULL, input_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(addr == MAP_FAILED){
+			fprintf(stderr, "error: unable to map %s, %s\n", path, strerror(errno));
+			return 1;
+		}
+		madvise(addr, input_size, MADV_SEQUENTIAL);
+		input = (const char *)addr;
+	}
+	::close(fd);
+	conf.binary = input_size >= 8 && memcmp(input, EXPORT_MAGIC, 8) == 0;
+	if(!conf.binary){
+		text_chunks();
+	}else if(binary_chunks() == -1){
+		fprintf(stderr, "error: %s is truncated, or not a %s export\n", path,
+			conf.type == TYPE_KV? "kv" : conf.type == TYPE_HASH? "hash" : "zset");
+		return 1;
+	}
+	// the header, or the magic, counts as done
+	bytes_done = chunks.empty()? input_size : chunks[0];
+
+	signal(SIGPIPE, SIG_IGN);
+	std::vector<Loader *> loaders;
+	for(int i=0; i<conf.connections; i++){
+		Link *link = Link::connect(conf.ip.c_str(), conf.port);
+		if(link == NULL){
+			fprintf(stderr, "error: unable to connect to %s:%d, %s\n",
+				conf.ip.c_str(), conf.port, strerror(errno));
+			return 1;
+		}
+		loaders.push_back(new Loader(link));
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	std::vector<std::thread> threads;
+	running = conf.connections;
+	for(int i=0; i<conf.connections; i++){
+		threads.push_back(std::thread(&Loader::run, loaders[i]));
+	}
+	// progress, once a second
+	while(running.load() > 0){
+		for(int i=0; i<10 && running.load() > 0; i++){
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+		double seconds = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count() / 1e3;
+		fprintf(stderr, "\r%5.1f%%  %" PRId64 " records, %.0f records/s, %.1f MB/s   ",
+			input_size? bytes_done.load() * 100.0 / input_size : 100.0, records.load(),
+			seconds > 0? records.load() / seconds : 0,
+			seconds > 0? bytes_done.load() / seconds / 1024 / 1024 : 0);
+	}
+	for(int i=0; i<(int)threads.size(); i++){
+		threads[i].join();
+		delete loaders[i];
+	}
+	double seconds = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count() / 1e3;
+	if(input){
+		munmap((void *)input, input_size);
+	}
+
+	fprintf(stderr, "\n");
+	printf("%" PRId64 " records in %.2f seconds, %.0f records/s, %" PRId64 " bad lines, %" PRId64 " errors\n",
+		records.load(), seconds, seconds > 0? records.load() / seconds : 0, bad_lines.load(), errors.load());
+	return errors.load() || bad_lines.load()? 1 : 0;
+}
@@ -0,0 +1,268 @@
+/*
+Plays a capture recorded by LinkCapture back against a server, so client
+changes can be measured on the shape of real traffic.
+
+	g++ -O2 -std=c++11 -I../include ssdb_replay.cpp ../include/link.cpp \
+		../include/ssdb_bytes.cpp ../include/buffer_pool.cpp ../include/buffer_policy.cpp \
+		-lpthread -o ssdb_replay
+	./ssdb_replay [-s ip:port] [-x speed] [-S] capture_file
+
+-s  the server to replay against, default 127.0.0.1:8888
+-x  1 keeps the original timing, 2 replays twice as fast, 0.5 at half
+    speed, 0 as fast as the server answers, default 1
+-S  the capture was taken on a server, the packets its links received
+    are the requests
+
+Every captured link is replayed on a connection of its own. A request is
+sent when it was sent in the capture, scaled by -x, and the connection
+waits for a response where the captured link received one, so requests
+that were pipelined are pipelined again. Responses whose status differs
+from the captured one are counted.
+
+To capture the traffic of a process, before it connects:
+
+	LinkCapture *capture = LinkCapture::open("traffic.cap");
+	Link::capture_all(capture);
+*/
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "link.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Event{
+	// microseconds since the capture was started
+	int64_t time;
+	bool request;
+	// the request, or the status of the response
+	std::vector<std::string> fields;
+};
+
+struct Session{
+	int link_id;
+	std::vector<Event> events;
+	int64_t requests;
+	int64_t errors;
+	int64_t mismatches;
+	// microseconds from sending a request to its response
+	std::vector<int64_t> latencies;
+	Session(){
+		requests = 0;
+		errors = 0;
+		mismatches = 0;
+	}
+};
+
+struct Config{
+	std::string ip;
+	int port;
+	double speed;
+	bool server_side;
+};
+
+static Config conf;
+
+static int64_t elapsed_us(Clock::time_point start){
+	return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+static int load(const char *path, std::vector<Session *> *sessions){
+	CaptureReader reader;
+	if(reader.open(path) == -1){
+		fprintf(stderr, "error: %s is not a capture\n", path);
+		return -1;
+	}
+	std::map<int, Session *> links;
+	CaptureReader::Frame frame;
+	int ret;
+	while((ret = reader.next(&frame)) == 1){
+		if(frame.fields.empty()){
+			continue;
+		}
+		Session *session = links[frame.link_id];
+		if(session == NULL){
+			session = new Session();
+			session->link_id = frame.link_id;
+			links[frame.link_id] = session;
+			sessions->push_back(session);
+		}
+		session->events.push_back(Event());
+		Event &event = session->events.back();
+		event.time = frame.time;
+		event.request = (frame.dir == LinkCapture::SEND) != conf.server_side;
+		if(event.request){
+			event.fields.swap(frame.fields);
+		}else{
+			event.fields.push_back(frame.fields[0]);
+		}
+	}
+	if(ret == -1){
+		fprintf(stderr, "warning: %s is truncated, replaying the frames before\n", path);
+	}
+	return 0;
+}
+
+static void replay(Session *session, Clock::time_point start){
+	Link *link = Link::connect(conf.ip.c_str(), conf.port);
+	if(link == NULL){
+		session->errors ++;
+		return;
+	}
+	link->nodelay(true);
+	// send times of the requests not answered yet
+	std::deque<int64_t> sent;
+	for(int i=0; i<(int)session->events.size(); i++){
+		const Event &event = session->events[i];
+		if(event.request){
+			if(conf.speed > 0){
+				int64_t at = (int64_t)(event.time / conf.speed);
+				std::this_thread::sleep_until(start + std::chrono::microseconds(at));
+			}
+			link->send(event.fields);
+			if(link->flush() == -1){
+				session->errors ++;
+				break;
+			}
+			sent.push_back(elapsed_us(start));
+			session->requests ++;
+			continue;
+		}
+		// the captured link received a response here, unless it got one
+		// to a request sent before the capture was started
+		if(sent.empty()){
+			continue;
+		}
+		const std::vector<Bytes> *resp = link->response();
+		if(resp == NULL || resp->empty()){
+			session->errors ++;
+			break;
+		}
+		session->latencies.push_back(elapsed_us(start) - sent.front());
+		sent.pop_front();
+		if(resp->at(0) != Bytes(event.fields[0])){
+			session->mismatches ++;
+		}
+	}
+	// responses the capture ended before
+	while(!sent.empty() && !link->error()){
+		const std::vector<Bytes> *resp = link->response();
+		if(resp == NULL || resp->empty()){
+			session->errors ++;
+			break;
+		}
+		session->latencies.push_back(elapsed_us(start) - sent.front());
+		sent.pop_front();
+	}
+	delete link;
+}
+
+static bool parse_addr(const char *s, std::string *ip, int *port){
+	const char *p = strrchr(s, ':');
+	if(p == NULL || p == s){
+		return false;
+	}
+	ip->assign(s, p - s);
+	*port = atoi(p + 1);
+	return *port > 0;
+}
+
+static void usage(const char *prog){
+	fprintf(stderr, "usage: %s [-s ip:port] [-x speed] [-S] capture_file\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv){
+	conf.ip = "127.0.0.1";
+	conf.port = 8888;
+	conf.speed = 1;
+	conf.server_side = false;
+
+	int opt;
+	while((opt = getopt(argc, argv, "s:x:S")) != -1){
+		switch(opt){
+			case 's':
+				if(!parse_addr(optarg, &conf.ip, &conf.port)){
+					usage(argv[0]);
+				}
+				break;
+			case 'x':
+				conf.speed = atof(optarg);
+				break;
+			case 'S':
+				conf.server_side = true;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if(optind != argc - 1 || conf.speed < 0){
+		usage(argv[0]);
+	}
+
+	std::vector<Session *> sessions;
+	if(load(argv[optind], &sessions) == -1){
+		return 1;
+	}
+	// the capture starts with its first frame
+	int64_t first = INT64_MAX;
+	int64_t last = 0;
+	for(int i=0; i<(int)sessions.size(); i++){
+		std::vector<Event> &events = sessions[i]->events;
+		first = std::min(first, events.front().time);
+		last = std::max(last, events.back().time);
+	}
+	for(int i=0; i<(int)sessions.size(); i++){
+		std::vector<Event> &events = sessions[i]->events;
+		for(int j=0; j<(int)events.size(); j++){
+			events[j].time -= first;
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	Clock::time_point start = Clock::now();
+	std::vector<std::thread> threads;
+	for(int i=0; i<(int)sessions.size(); i++){
+		threads.push_back(std::thread(replay, sessions[i], start));
+	}
+	for(int i=0; i<(int)threads.size(); i++){
+		threads[i].join();
+	}
+	double seconds = elapsed_us(start) / 1e6;
+
+	int64_t requests = 0;
+	int64_t errors = 0;
+	int64_t mismatches = 0;
+	std::vector<int64_t> latencies;
+	for(int i=0; i<(int)sessions.size(); i++){
+		Session *session = sessions[i];
+		requests += session->requests;
+		errors += session->errors;
+		mismatches += session->mismatches;
+		latencies.insert(latencies.end(), session->latencies.begin(), session->latencies.end());
+		delete session;
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	printf("%d links, %" PRId64 " requests in %.2f seconds, captured in %.2f\n",
+		(int)sessions.size(), requests, seconds, sessions.empty()? 0 : (last - first) / 1e6);
+	printf("%.0f requests per second, %" PRId64 " errors, %" PRId64 " status mismatches\n",
+		seconds > 0? requests / seconds : 0, errors, mismatches);
+	if(!latencies.empty()){
+		int n = (int)latencies.size();
+		printf("latency us: p50 %" PRId64 ", p90 %" PRId64 ", p99 %" PRId64 ", p99.9 %" PRId64 ", max %" PRId64 "\n",
+			latencies[n * 50 / 100], latencies[n * 90 / 100], latencies[n * 99 / 100],
+			latencies[(int)(n * 999LL / 1000)], latencies[n - 1]);
+	}
+	return errors? 1 : 0;
+}